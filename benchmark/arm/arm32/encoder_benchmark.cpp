@@ -0,0 +1,156 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+// Measures how long the assembler takes to encode instructions with constant immediates,
+// how long link() takes to fix up references whose values are only known at link time,
+// and how long rejecting an out of range immediate takes with and without exceptions.
+// Usage: encoder-benchmark [blocks [repetitions]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+
+namespace
+{
+
+using namespace lzasm::arm::arm32;
+
+// Each block has one instruction or directive of each immediate type the assembler range checks.
+constexpr size_t instructions_per_block = 12;
+
+template <typename TImmediate>
+void emit_block(basic_divided_thumb_assembler<uint32_t>& a, TImmediate imm)
+{
+    a.add(r0, r1, imm(3));
+    a.add(r2, imm(200));
+    a.sub(sp, imm(0x40));
+    a.mov(r3, imm(0x7f));
+    a.cmp(r4, imm(12));
+    a.lsl(r5, r6, imm(7));
+    a.lsr(r5, r6, imm(32));
+    a.ldr(r0, r1, imm(0x24));
+    a.ldrh(r0, r1, imm(0x10));
+    a.ldrb(r0, r1, imm(0x1f));
+    a.str(r0, sp, imm(0x100));
+    a.hword(imm(0x1234));
+}
+
+template <typename F>
+double measure(int repetitions, F f)
+{
+    std::vector<double> milliseconds;
+    for (int r = 0; r < repetitions; ++r)
+    {
+        milliseconds.push_back(f());
+    }
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+    return milliseconds[milliseconds.size() / 2];
+}
+
+void report(const char* name, size_t count, double median)
+{
+    std::cout << name << ": " << count << " instructions, median " << median << " ms, "
+              << median * 1e6 / static_cast<double>(count) << " ns per instruction\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t blocks = argc > 1 ? std::stoul(argv[1]) : 50000;
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 11;
+    auto count = blocks * instructions_per_block;
+
+    // Constant immediates are encoded by the assembler.
+    auto encode = measure(
+        repetitions,
+        [&]
+        {
+            basic_divided_thumb_assembler<uint32_t> a;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < blocks; ++i)
+            {
+                emit_block(a, [](immediate_t value) { return value; });
+            }
+            auto stop = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::milli>(stop - start).count();
+        });
+    report("encode constant immediates", count, encode);
+
+    // Immediates that are constants defined by equ() after their use are encoded by link().
+    auto fix = measure(
+        repetitions,
+        [&]
+        {
+            basic_divided_thumb_assembler<uint32_t> a;
+            for (size_t i = 0; i < blocks; ++i)
+            {
+                emit_block(a, [](immediate_t value) { return symbol<uint32_t>(static_cast<uint32_t>(value)); });
+            }
+            for (auto value : { 3, 200, 0x40, 0x7f, 12, 7, 32, 0x24, 0x10, 0x1f, 0x100, 0x1234 })
+            {
+                a.equ(symbol<uint32_t>(static_cast<uint32_t>(value)), value);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            auto program = a.link(0);
+            auto stop = std::chrono::steady_clock::now();
+            if (program.empty())
+            {
+                std::exit(EXIT_FAILURE);
+            }
+            return std::chrono::duration<double, std::milli>(stop - start).count();
+        });
+    report("fix up link time immediates", count, fix);
+
+    // Out of range immediates, as a search for the shortest code would produce them.
+    auto reject_throwing = measure(
+        repetitions,
+        [&]
+        {
+            basic_divided_thumb_assembler<uint32_t> a;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i)
+            {
+                try
+                {
+                    a.lsr(r0, r1, static_cast<immediate_t>(33 + i % 8));
+                }
+                catch (const std::runtime_error&)
+                {
+                }
+            }
+            auto stop = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::milli>(stop - start).count();
+        });
+    report("reject immediates, throwing_error_policy", count, reject_throwing);
+
+    auto reject_error_code = measure(
+        repetitions,
+        [&]
+        {
+            basic_divided_thumb_assembler<uint32_t, error_code_policy> a;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; ++i)
+            {
+                a.lsr(r0, r1, static_cast<immediate_t>(33 + i % 8));
+                if (a.errors().has_error())
+                {
+                    a.errors().clear();
+                }
+            }
+            auto stop = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::milli>(stop - start).count();
+        });
+    report("reject immediates, error_code_policy", count, reject_error_code);
+
+    return EXIT_SUCCESS;
+}
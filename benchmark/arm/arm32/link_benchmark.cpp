@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+// Measures how long link() takes to apply the fixups of a large program.
+// Usage: link-benchmark [blocks [repetitions]]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+
+namespace
+{
+
+using namespace lzasm::arm::arm32;
+
+// Each block has one reference of each kind: bl, b, beq, word and an abs8 expression.
+constexpr size_t references_per_block = 5;
+
+template <typename TSymbolName, typename F>
+void assemble(basic_divided_thumb_assembler<TSymbolName>& a, size_t blocks, F make_symbol)
+{
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        auto far_target = (i * 7919) % blocks;
+        a.label(make_symbol(i));
+        a.bl(make_symbol(far_target));
+        a.b(make_symbol(i + 1));
+        a.beq(make_symbol(i));
+        a.word(make_symbol(i));
+        a.mov(r0, make_symbol(i + 1) - make_symbol(i));
+    }
+    a.label(make_symbol(blocks));
+}
+
+template <typename TSymbolName, typename F>
+void run(const char* name, size_t blocks, int repetitions, F make_symbol)
+{
+    std::vector<double> milliseconds;
+    for (int r = 0; r < repetitions; ++r)
+    {
+        basic_divided_thumb_assembler<TSymbolName> a;
+        assemble(a, blocks, make_symbol);
+
+        auto start = std::chrono::steady_clock::now();
+        auto program = a.link(0x08000000);
+        auto stop = std::chrono::steady_clock::now();
+
+        if (program.empty())
+        {
+            std::exit(EXIT_FAILURE);
+        }
+        milliseconds.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    }
+
+    std::sort(milliseconds.begin(), milliseconds.end());
+    auto median = milliseconds[milliseconds.size() / 2];
+    auto references = blocks * references_per_block;
+    std::cout << name << ": " << references << " references, median " << median << " ms, best " << milliseconds.front() << " ms, "
+              << median * 1e6 / static_cast<double>(references) << " ns per reference\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t blocks = argc > 1 ? std::stoul(argv[1]) : 60000;
+    int repetitions = argc > 2 ? std::stoi(argv[2]) : 11;
+
+    run<uint32_t>("uint32_t symbols", blocks, repetitions, [](size_t i) { return symbol<uint32_t>(static_cast<uint32_t>(i)); });
+    run<std::string>("std::string symbols", blocks, repetitions, [](size_t i) { return symbol<std::string>("label" + std::to_string(i)); });
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_BLOCK_TRANSFER_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_BLOCK_TRANSFER_HPP_INCLUDED
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/constant_synthesis.hpp"
+#include "lzasm/arm/arm32/detail/cost.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+class block_options final
+{
+public:
+    // Destination and source address modulo 4. These must be known when the code is generated.
+    address_t dst_offset = 0;
+    address_t src_offset = 0;
+
+    // Number of bursts per loop iteration.
+    // 0 lets the optimization goal decide between straight-line code and loops with different unroll factors.
+    unsigned unroll = 0;
+
+    // Append bx lr, so that the code can be called as a function.
+    bool function = false;
+};
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+enum class block_transfer_kind
+{
+    copy,       // ldr/ldmia from src, str/stmia to dst
+    fill,       // str/stmia of a value register and copies of it
+    zero        // Like fill, but the value register is cleared first
+};
+
+// Describes the code generated for a block transfer:
+// * head: bytes and halfwords transferred one by one until dst is word aligned.
+//   Both pointers are incremented after each transfer.
+// * body: elements transferred in bursts of up to burst_registers elements.
+//   For words these are ldmia/stmia bursts. If src and dst are not equally aligned,
+//   bytes or halfwords are transferred with ldrb/strb or ldrh/strh and pointer increments.
+//   Optionally the body starts with a loop of loop_iterations iterations of unroll bursts each.
+//   The loop uses one of the registers as counter, so all bursts are one register shorter.
+// * tail: remaining halfword and byte, transferred without pointer increments.
+class block_transfer_plan final
+{
+public:
+    block_transfer_kind kind;
+    std::vector<address_t> head;
+    address_t element_size;
+    unsigned burst_registers;
+    unsigned loop_iterations;
+    unsigned unroll;
+    unsigned remaining_elements;
+    std::vector<address_t> tail;
+    bool function;
+
+    // Registers holding data. If there is a loop, one register serves as loop counter.
+    constexpr unsigned data_registers() const
+    {
+        return loop_iterations ? burst_registers - 1 : burst_registers;
+    }
+
+    // Number of data registers the bursts actually use.
+    constexpr unsigned used_registers() const
+    {
+        return loop_iterations ? data_registers() : std::max(std::min(remaining_elements, data_registers()), 1u);
+    }
+
+    cost estimate() const
+    {
+        auto total = setup_cost();
+
+        for (auto i = head.size(); i > 0; --i)
+        {
+            total = total + element_cost() + alu_instruction_cost * (is_copy() ? 2 : 1);
+        }
+
+        if (loop_iterations)
+        {
+            auto iteration = burst_cost(data_registers()) * unroll + alu_instruction_cost + taken_branch_cost;
+            total = total + counter_setup_cost();
+            total = total + cost(iteration.size, iteration.cycles * loop_iterations - (taken_branch_cost.cycles - alu_instruction_cost.cycles));
+        }
+
+        total = total + burst_cost(data_registers()) * (remaining_elements / data_registers());
+        if (remaining_elements % data_registers())
+        {
+            total = total + burst_cost(remaining_elements % data_registers());
+        }
+
+        total = total + element_cost() * static_cast<unsigned>(tail.size());
+
+        if (function)
+        {
+            total = total + return_cost;
+        }
+
+        return total;
+    }
+
+private:
+    constexpr bool is_copy() const { return kind == block_transfer_kind::copy; }
+
+    // ldr*: 1S + 1N + 1I, str*: 2N
+    constexpr cost element_cost() const
+    {
+        return is_copy() ? cost(4, 5) : cost(2, 2);
+    }
+
+    constexpr cost burst_cost(unsigned n) const
+    {
+        if (element_size == 4)
+        {
+            // ldmia: nS + 1N + 1I, stmia: (n-1)S + 2N
+            return is_copy() ? cost(4, 2 * n + 3) : cost(2, n + 1);
+        }
+
+        // Loads, stores and two pointer increments.
+        return cost(4 * n + 4, 5 * n + 2);
+    }
+
+    cost setup_cost() const
+    {
+        // Fills copy the value register into the other registers. Zero fills clear the value register first.
+        auto copies = is_copy() ? 0 : used_registers() - 1;
+        if (kind == block_transfer_kind::zero)
+        {
+            ++copies;
+        }
+        return alu_instruction_cost * copies;
+    }
+
+    cost counter_setup_cost() const
+    {
+        if (auto synthesis = synthesize_constant(loop_iterations))
+        {
+            return alu_instruction_cost * static_cast<unsigned>(synthesis->count);
+        }
+        return literal_load_cost;
+    }
+
+    // b: 2S + 1N
+    static constexpr cost taken_branch_cost = cost(2, 3);
+
+    // bx lr: 2S + 1N
+    static constexpr cost return_cost = cost(2, 3);
+};
+
+// Plans a block transfer. registers is the number of registers available for bursts,
+// including the value register of fills. unroll == 0 means no loop.
+// Returns nothing if a loop with the requested unroll factor cannot be generated.
+inline std::optional<block_transfer_plan> plan_block_transfer(
+    block_transfer_kind kind, address_t size, const block_options& options, unsigned registers, unsigned unroll)
+{
+    block_transfer_plan plan{ kind, {}, 4, registers, 0, unroll, 0, {}, options.function };
+
+    auto offset = options.dst_offset;
+    if (kind == block_transfer_kind::copy)
+    {
+        auto difference = (options.dst_offset - options.src_offset) & 3;
+        plan.element_size = difference == 0 ? 4 : ((difference == 2) ? 2 : 1);
+    }
+
+    // Align dst to the element size.
+    for (address_t element = 1; element < plan.element_size; element *= 2)
+    {
+        if ((offset & element) && (size >= element))
+        {
+            plan.head.push_back(element);
+            offset += element;
+            size -= element;
+        }
+    }
+
+    auto elements = size / plan.element_size;
+    size %= plan.element_size;
+
+    if (unroll)
+    {
+        if ((registers < 2) || (elements / ((registers - 1) * unroll) == 0))
+        {
+            return std::nullopt;
+        }
+        auto elements_per_iteration = (registers - 1) * unroll;
+        plan.loop_iterations = elements / elements_per_iteration;
+        elements %= elements_per_iteration;
+    }
+    plan.remaining_elements = elements;
+
+    for (address_t element = 2; element > 0; element /= 2)
+    {
+        if (size >= element)
+        {
+            plan.tail.push_back(element);
+            size -= element;
+        }
+    }
+
+    return plan;
+}
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_CODE_FOLDING_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_CODE_FOLDING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/reference.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// What the identical code folding pass of the last link() did.
+// Saved bytes include changes of alignment padding.
+class folding_report final
+{
+public:
+    size_t folded_routines = 0;
+    address_t saved_bytes = 0;
+};
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+// A fixup within a routine, relative to the start of the routine.
+class folding_fixup final
+{
+public:
+    address_t offset;
+    reference_type type;
+
+    // Internal targets are offsets into the routine, others are the values the fixup resolves to.
+    bool is_internal;
+    immediate_t target;
+
+    bool operator==(const folding_fixup&) const = default;
+};
+
+// What makes a routine identical to another one. Fixup fields are zero in bytes,
+// the offsets of literal loads are zeroed too, since they differ between copies.
+class folding_key final
+{
+public:
+    bytevector bytes;
+    std::vector<address_t> instructions;
+    std::vector<folding_fixup> fixups;
+
+    bool operator==(const folding_key&) const = default;
+
+    // FNV-1a hash of the bytes, used to find candidates before comparing keys.
+    uint64_t hash() const
+    {
+        uint64_t h = 14695981039346656037u;
+        for (auto b : bytes)
+        {
+            h = (h ^ b) * 1099511628211u;
+        }
+        return h;
+    }
+};
+
+}
+
+#endif
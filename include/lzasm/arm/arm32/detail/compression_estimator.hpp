@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_COMPRESSION_ESTIMATOR_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_COMPRESSION_ESTIMATOR_HPP_INCLUDED
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Number of bytes before the estimated bytes that matches may refer to.
+inline constexpr address_t compression_window_size = 4096;
+
+// Estimates how many bits an LZ compressor with an adaptive entropy coder, such as Shrinkler,
+// needs for bytes [start, end), when everything before start has already been compressed.
+// The bytes are parsed greedily into matches and literals. A literal costs what an order-0 model
+// of the window predicts, a match costs Elias gamma codes of its length and offset. Like in Shrinkler,
+// a match that repeats the offset of the previous match does not pay for the offset again.
+// The estimate is only good for comparing alternatives, not for predicting the compressed size.
+inline double estimate_compressed_bits(const bytevector& bytes, address_t start, address_t end)
+{
+    auto gamma_bits = [](address_t n) { return 2.0 * std::bit_width(n) - 1; };
+
+    std::array<unsigned, 256> counts{};
+    auto window_start = start > compression_window_size ? start - compression_window_size : 0;
+    for (auto i = window_start; i < start; ++i)
+    {
+        ++counts[bytes[i]];
+    }
+    double total = start - window_start;
+    auto literal_bits = [&](address_t i) { return 1 - std::log2((counts[bytes[i]] + 1) / (total + 256)); };
+
+    double bits = 0;
+    address_t previous_offset = 0;
+    auto i = start;
+    while (i < end)
+    {
+        // Longest match, the nearest one if there are several.
+        address_t length = 0;
+        address_t offset = 0;
+        for (auto j = i > compression_window_size ? i - compression_window_size : 0; j < i; ++j)
+        {
+            address_t n = 0;
+            while ((i + n < end) && (bytes[j + n] == bytes[i + n]))
+            {
+                ++n;
+            }
+            if ((n > 0) && (n >= length))
+            {
+                length = n;
+                offset = i - j;
+            }
+        }
+
+        double literals = 0;
+        for (address_t n = 0; n < length; ++n)
+        {
+            literals += literal_bits(i + n);
+        }
+
+        auto match_bits = [&] { return 1 + gamma_bits(length - 1) + (offset == previous_offset ? 1 : 1 + gamma_bits(offset)); };
+        if ((length >= 2) && (match_bits() < literals))
+        {
+            bits += match_bits();
+            previous_offset = offset;
+        }
+        else
+        {
+            bits += literal_bits(i);
+            length = 1;
+        }
+
+        for (address_t n = 0; n < length; ++n)
+        {
+            ++counts[bytes[i + n]];
+        }
+        total += length;
+        i += length;
+    }
+
+    return bits;
+}
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_CONSTANT_SYNTHESIS_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_CONSTANT_SYNTHESIS_HPP_INCLUDED
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+enum class synthesis_operation
+{
+    mov,        // mov rd, #imm
+    lsl,        // lsl rd, rd, #imm
+    mvn,        // mvn rd, rd
+    add,        // add rd, #imm
+    sub         // sub rd, #imm
+};
+
+class synthesis_step final
+{
+public:
+    constexpr synthesis_step() = default;
+
+    constexpr synthesis_step(synthesis_operation operation, uint32_t imm)
+        : operation(operation), imm(imm) {}
+
+    constexpr uint32_t apply(uint32_t value) const
+    {
+        switch (operation)
+        {
+            case synthesis_operation::mov:
+                return imm;
+            case synthesis_operation::lsl:
+                return value << imm;
+            case synthesis_operation::mvn:
+                return ~value;
+            case synthesis_operation::add:
+                return value + imm;
+            case synthesis_operation::sub:
+                return value - imm;
+        }
+
+        return value;
+    }
+
+    constexpr uint_fast16_t opcode(uint32_t rd) const
+    {
+        switch (operation)
+        {
+            case synthesis_operation::mov:
+                return (0b00100 << 11) | (rd << 8) | imm;
+            case synthesis_operation::lsl:
+                return (imm << 6) | (rd << 3) | rd;
+            case synthesis_operation::mvn:
+                return (0b0100001111 << 6) | (rd << 3) | rd;
+            case synthesis_operation::add:
+                return (0b00110 << 11) | (rd << 8) | imm;
+            case synthesis_operation::sub:
+                return (0b00111 << 11) | (rd << 8) | imm;
+        }
+
+        return 0;
+    }
+
+    synthesis_operation operation = synthesis_operation::mov;
+    uint32_t imm = 0;
+};
+
+// Describes how to build a constant in a low register without a literal pool.
+// The sequence always starts with a mov, so it does not depend on the previous value of the register.
+// Note that all of these sequences set the flags.
+class constant_synthesis final
+{
+public:
+    static constexpr size_t max_instructions = 3;
+
+    constexpr constant_synthesis(std::initializer_list<synthesis_step> list)
+    {
+        for (const auto& step : list)
+        {
+            steps[count++] = step;
+        }
+    }
+
+    constexpr address_t size() const { return static_cast<address_t>(count * 2); }
+
+    constexpr uint32_t value() const
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            value = steps[i].apply(value);
+        }
+        return value;
+    }
+
+    constexpr const synthesis_step* begin() const { return steps.data(); }
+    constexpr const synthesis_step* end() const { return steps.data() + count; }
+
+    std::array<synthesis_step, max_instructions> steps{};
+    size_t count = 0;
+};
+
+// Returns the shortest mov based sequence that builds value, if there is one
+// with at most max_instructions instructions.
+constexpr std::optional<constant_synthesis> synthesize_constant(uint32_t value, size_t max_instructions = constant_synthesis::max_instructions)
+{
+    using enum synthesis_operation;
+
+    if (value <= 0xff)
+    {
+        return constant_synthesis{ { mov, value } };
+    }
+
+    if (max_instructions < 2)
+    {
+        return std::nullopt;
+    }
+
+    auto shift = static_cast<uint32_t>(std::countr_zero(value));
+    if ((value >> shift) <= 0xff)
+    {
+        return constant_synthesis{ { mov, value >> shift }, { lsl, shift } };
+    }
+
+    if (~value <= 0xff)
+    {
+        return constant_synthesis{ { mov, ~value }, { mvn, 0 } };
+    }
+
+    if (value <= 0xff * 2)
+    {
+        return constant_synthesis{ { mov, 0xff }, { add, value - 0xff } };
+    }
+
+    if (max_instructions < 3)
+    {
+        return std::nullopt;
+    }
+
+    if (value <= 0xff * 3)
+    {
+        return constant_synthesis{ { mov, 0xff }, { add, 0xff }, { add, value - 0xff * 2 } };
+    }
+
+    auto inverted_shift = static_cast<uint32_t>(std::countr_zero(~value));
+    if ((~value >> inverted_shift) <= 0xff)
+    {
+        return constant_synthesis{ { mov, ~value >> inverted_shift }, { lsl, inverted_shift }, { mvn, 0 } };
+    }
+
+    if (~value <= 0xff * 2)
+    {
+        return constant_synthesis{ { mov, 0xff }, { mvn, 0 }, { sub, ~value - 0xff } };
+    }
+
+    for (uint32_t s = 1; s < 32; ++s)
+    {
+        // (a << s) + b
+        auto a = value >> s;
+        auto b = value - (a << s);
+        if ((a <= 0xff) && (b <= 0xff))
+        {
+            return constant_synthesis{ { mov, a }, { lsl, s }, { add, b } };
+        }
+
+        // (a << s) - b
+        a = (value >> s) + 1;
+        b = (a << s) - value;
+        if ((a <= 0xff) && (b <= 0xff))
+        {
+            return constant_synthesis{ { mov, a }, { lsl, s }, { sub, b } };
+        }
+
+        // ~a << s
+        a = ~(value >> s) & 0xff;
+        if ((~a << s) == value)
+        {
+            return constant_synthesis{ { mov, a }, { mvn, 0 }, { lsl, s } };
+        }
+    }
+
+    return std::nullopt;
+}
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_COST_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_COST_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/optimization_goal.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Size and execution time of an instruction sequence.
+// Cycle counts are those of the ARM7TDMI executing from zero wait state memory.
+class cost final
+{
+public:
+    constexpr cost(address_t size, unsigned cycles)
+        : size(size), cycles(cycles) {}
+
+    constexpr cost operator + (const cost& other) const
+    {
+        return cost(size + other.size, cycles + other.cycles);
+    }
+
+    constexpr cost operator * (unsigned n) const
+    {
+        return cost(size * n, cycles * n);
+    }
+
+    address_t size;
+    unsigned cycles;
+};
+
+// Data processing instructions: 1S.
+inline constexpr cost alu_instruction_cost(2, 1);
+
+// ldr rd, =value: 1S + 1N + 1I, plus a four byte pool entry.
+inline constexpr cost literal_load_cost(6, 3);
+
+// mul: 1S + mI. The multiplier is the value of rd before the instruction executes.
+// m is 1 if its bits [31:8] are all zero or all one, 2 for bits [31:16], 3 for bits [31:24] and 4 otherwise.
+constexpr cost multiply_cost(uint32_t multiplier)
+{
+    unsigned m = 1;
+    for (auto bits = 8; bits < 32; bits += 8)
+    {
+        auto upper = multiplier >> bits;
+        if ((upper == 0) || (upper == (0xffffffff >> bits)))
+        {
+            break;
+        }
+        ++m;
+    }
+
+    return cost(2, 1 + m);
+}
+
+// mul with a multiplier that is not known at assembly time.
+inline constexpr cost worst_case_multiply_cost(2, 5);
+
+constexpr bool is_cheaper(const cost& a, const cost& b, optimization_goal goal)
+{
+    return goal == optimization_goal::speed
+        ? (a.cycles < b.cycles) || ((a.cycles == b.cycles) && (a.size < b.size))
+        : (a.size < b.size) || ((a.size == b.size) && (a.cycles < b.cycles));
+}
+
+// Collects alternative expansions of a pseudo instruction and emits the cheapest one.
+// If several expansions have the same cost, the first one wins.
+class cheapest_expansion final
+{
+public:
+    explicit cheapest_expansion(optimization_goal goal) : goal(goal) {}
+
+    void consider(const cost& c, std::function<void()> emitter)
+    {
+        if (!best || is_cheaper(c, candidates[*best].first, goal))
+        {
+            best = candidates.size();
+        }
+        candidates.emplace_back(c, std::move(emitter));
+    }
+
+    bool empty() const { return !best.has_value(); }
+
+    void emit() const
+    {
+        candidates[*best].second();
+    }
+
+    // Access to all alternatives, for choosing by criteria other than cost.
+    size_t size() const { return candidates.size(); }
+
+    const cost& get_cost(size_t index) const { return candidates[index].first; }
+
+    void emit(size_t index) const
+    {
+        candidates[index].second();
+    }
+
+private:
+    optimization_goal goal;
+    std::vector<std::pair<cost, std::function<void()>>> candidates;
+    std::optional<size_t> best;
+};
+
+}
+
+#endif
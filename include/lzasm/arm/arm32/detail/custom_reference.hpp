@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_CUSTOM_REFERENCE_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_CUSTOM_REFERENCE_HPP_INCLUDED
+
+#include <functional>
+#include <span>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/reference.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// A reference type defined by the program using the assembler, for data formats
+// that link() must patch. See register_reference_type() and fixup().
+class custom_reference_type final
+{
+public:
+    // Range of values, checked by link() before patch is called.
+    immediate_t min = 0;
+    immediate_t max = 0;
+
+    // Alignment, as number of least significant bits that are required to be zero.
+    immediate_t alignment = 0;
+
+    // Number of bytes fixup() emits and patch receives.
+    address_t size = 0;
+
+    // If set, the value is relative to the address of the fixup.
+    bool is_pc_relative = false;
+
+    // Writes a value into the bytes of a fixup. The bytes are zero, unless the program
+    // wrote into them, e.g. because fixups of packed formats overlap.
+    std::function<void(std::span<unsigned char> bytes, immediate_t value)> patch;
+};
+
+// Returned by register_reference_type(), passed to fixup().
+using custom_reference_id = detail::reference_type;
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+inline bool is_custom(reference_type type)
+{
+    return to_underlying(type) >= to_underlying(reference_type::first_custom);
+}
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_DEAD_STRIPPING_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_DEAD_STRIPPING_HPP_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// What the dead code stripping pass of the last link() removed.
+// Saved bytes include changes of alignment padding.
+class stripping_report final
+{
+public:
+    size_t removed_symbols = 0;
+    address_t saved_bytes = 0;
+};
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Marks the nodes reachable from the roots. successors[n] lists the nodes n refers to.
+inline std::vector<bool> find_reachable(const std::vector<std::vector<size_t>>& successors, const std::vector<size_t>& roots)
+{
+    std::vector<bool> reachable(successors.size(), false);
+    std::vector<size_t> pending(roots);
+    while (!pending.empty())
+    {
+        auto n = pending.back();
+        pending.pop_back();
+        if (reachable[n])
+        {
+            continue;
+        }
+
+        reachable[n] = true;
+        pending.insert(pending.end(), successors[n].begin(), successors[n].end());
+    }
+    return reachable;
+}
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_DIVISION_MAGIC_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_DIVISION_MAGIC_HPP_INCLUDED
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Unsigned division by a constant using a reciprocal multiplication:
+//     t = (x * multiplier) >> 32
+//     q = t >> shift                          if !add
+//     q = (((x - t) >> 1) + t) >> shift       if add
+class unsigned_division_magic final
+{
+public:
+    uint32_t multiplier;
+    uint32_t shift;
+    bool add;
+};
+
+// Signed division by a constant using a reciprocal multiplication:
+//     t = (x * multiplier) >> 32              (signed multiplication)
+//     t = t + x                               if add_dividend
+//     t = t - x                               if subtract_dividend
+//     t = t >> shift                          (arithmetic shift)
+//     q = t + (t >>> 31)
+class signed_division_magic final
+{
+public:
+    int32_t multiplier;
+    uint32_t shift;
+    bool add_dividend;
+    bool subtract_dividend;
+};
+
+// d must not be zero or a power of two.
+constexpr unsigned_division_magic get_unsigned_division_magic(uint32_t d)
+{
+    // Granlund and Montgomery: m = ceil(2^(32+s) / d) works if m * d - 2^(32+s) <= 2^s.
+    auto l = static_cast<uint32_t>(std::bit_width(d - 1));
+    for (uint32_t s = 0; s <= std::min(l, 31u); ++s)
+    {
+        auto p = uint64_t(1) << (32 + s);
+        auto m = (p + d - 1) / d;
+        if ((m <= 0xffffffff) && (m * d - p <= (uint64_t(1) << s)))
+        {
+            return unsigned_division_magic{ static_cast<uint32_t>(m), s, false };
+        }
+    }
+
+    // No 32 bit multiplier exists, so use a 33 bit multiplier whose most significant bit is implicit.
+    auto m = ((uint64_t(1) << 32) * ((uint64_t(1) << l) - d)) / d + 1;
+    return unsigned_division_magic{ static_cast<uint32_t>(m), l - 1, true };
+}
+
+// |d| must be at least 2 and must not be a power of two.
+// See Henry S. Warren, Hacker's Delight, section 10-6.
+constexpr signed_division_magic get_signed_division_magic(int32_t d)
+{
+    constexpr uint32_t two31 = 0x80000000;
+
+    uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+    uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+    uint32_t anc = t - 1 - t % ad;
+    uint32_t p = 31;
+    uint32_t q1 = two31 / anc;
+    uint32_t r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad;
+    uint32_t r2 = two31 - q2 * ad;
+    uint32_t delta = 0;
+
+    do
+    {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc)
+        {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad)
+        {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while ((q1 < delta) || ((q1 == delta) && (r1 == 0)));
+
+    auto m = static_cast<int32_t>(d < 0 ? 0u - (q2 + 1) : q2 + 1);
+    return signed_division_magic{ m, p - 32, (d > 0) && (m < 0), (d < 0) && (m > 0) };
+}
+
+}
+
+#endif
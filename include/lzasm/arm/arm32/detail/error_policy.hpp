@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_ERROR_POLICY_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_ERROR_POLICY_HPP_INCLUDED
+
+#include <concepts>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// An error reported through an error policy.
+class diagnostic final
+{
+public:
+    // Location counter of the instruction when assembling, absolute address of the fixup when linking.
+    // Errors of link() that have no location, such as an alignment that is out of range, are reported at the origin.
+    address_t address = 0;
+    std::string message;
+};
+
+// An error policy decides what happens when the assembler finds an error.
+// Policies that do not throw let the assembler continue as if the erroneous operand were zero.
+// A pseudo instruction whose operands are invalid then emits nothing.
+template <typename T>
+concept error_policy = requires (T& policy, address_t address, const char* message)
+{
+    { T::is_throwing } -> std::convertible_to<bool>;
+    policy.report(address, message);
+};
+
+// Throws std::runtime_error. This is the default policy.
+class throwing_error_policy final
+{
+public:
+    static constexpr bool is_throwing = true;
+
+    void report(address_t, const char* message)
+    {
+        detail::report_error(message);
+    }
+};
+
+// Keeps the first error until clear() is called, e.g. to reject a candidate instruction sequence cheaply.
+// The message buffer is reused, so once it is large enough, reporting an error does not allocate memory.
+class error_code_policy final
+{
+public:
+    static constexpr bool is_throwing = false;
+
+    void report(address_t address, const char* message)
+    {
+        if (!m_has_error)
+        {
+            m_has_error = true;
+            m_error.address = address;
+            m_error.message.assign(message);
+        }
+    }
+
+    bool has_error() const { return m_has_error; }
+
+    // Only valid if has_error() returns true.
+    const diagnostic& error() const { return m_error; }
+
+    void clear() { m_has_error = false; }
+
+private:
+    bool m_has_error = false;
+    diagnostic m_error;
+};
+
+// Collects every error, e.g. to report all problems of a program after a single link().
+class collecting_error_policy final
+{
+public:
+    static constexpr bool is_throwing = false;
+
+    void report(address_t address, const char* message)
+    {
+        m_diagnostics.push_back(diagnostic{ address, message });
+    }
+
+    bool has_error() const { return !m_diagnostics.empty(); }
+
+    const std::vector<diagnostic>& diagnostics() const { return m_diagnostics; }
+
+    void clear() { m_diagnostics.clear(); }
+
+private:
+    std::vector<diagnostic> m_diagnostics;
+};
+
+}
+
+#endif
@@ -5,13 +5,80 @@
 #ifndef LZASM_ARM_ARM32_DETAIL_IMMEDIATE_HPP_INCLUDED
 #define LZASM_ARM_ARM32_DETAIL_IMMEDIATE_HPP_INCLUDED
 
+#include <concepts>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
 #include <variant>
 #include "lzasm/arm/arm32/detail/basic_types.hpp"
 #include "lzasm/arm/arm32/detail/symbol.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
 
 namespace lzasm::arm::arm32::detail
 {
 
+enum class expression_operator
+{
+    add,
+    subtract,
+    multiply,
+    divide,
+    shift_left,
+    shift_right,
+    bitwise_and,
+    bitwise_or
+};
+
+// Applies an operator. Arithmetic wraps around like on the target CPU, shifts are arithmetic.
+inline immediate_t apply_operator(expression_operator op, immediate_t l, immediate_t r)
+{
+    auto ul = static_cast<address_t>(l);
+    auto ur = static_cast<address_t>(r);
+    switch (op)
+    {
+        case expression_operator::add:
+            return static_cast<immediate_t>(ul + ur);
+        case expression_operator::subtract:
+            return static_cast<immediate_t>(ul - ur);
+        case expression_operator::multiply:
+            return static_cast<immediate_t>(ul * ur);
+        case expression_operator::divide:
+            if (r == 0)
+            {
+                report_error("Division by zero");
+            }
+            return ((l == std::numeric_limits<immediate_t>::min()) && (r == -1)) ? l : l / r;
+        case expression_operator::shift_left:
+            return static_cast<immediate_t>((r < 0) || (r > 31) ? 0 : ul << r);
+        case expression_operator::shift_right:
+            return (r < 0) || (r > 31) ? (l < 0 ? -1 : 0) : l >> r;
+        case expression_operator::bitwise_and:
+            return l & r;
+        case expression_operator::bitwise_or:
+            return l | r;
+    }
+    report_error("Internal error: invalid expression operator");
+    return 0;
+}
+
+template <typename TSymbolName>
+class expression;
+
+// An immediate whose value is a template argument, see imm. Instructions check it at compile time.
+template <immediate_t v>
+class constant_immediate final
+{
+public:
+    static constexpr immediate_t value = v;
+};
+
+template <typename T>
+struct is_constant_immediate : std::false_type {};
+
+template <immediate_t v>
+struct is_constant_immediate<constant_immediate<v>> : std::true_type {};
+
 template <typename TSymbolName>
 class immediate_base
 {
@@ -19,24 +86,97 @@ public:
     // Implicit conversion from constant value
     constexpr immediate_base(immediate_t value) : m_value(std::in_place_index<value_index>, value) {}
 
+    // Implicit conversion from constant value known at compile time
+    template <immediate_t v>
+    constexpr immediate_base(constant_immediate<v>) : m_value(std::in_place_index<value_index>, v) {}
+
     // Implicit conversion from symbolic value
     constexpr immediate_base(symbol<TSymbolName> symbol) : m_value(std::in_place_index<symbol_index>, std::move(symbol)) {}
 
+    // Expression of symbols, see the operators below.
+    immediate_base(std::shared_ptr<const expression<TSymbolName>> e) : m_value(std::in_place_index<expression_index>, std::move(e)) {}
+
+    // Whether the value is known before link(). Only constants are, symbols and expressions are not.
+    constexpr bool is_constant() const { return m_value.index() == value_index; }
+
     constexpr bool is_symbol_reference() const { return m_value.index() == symbol_index; }
 
+    constexpr bool is_expression() const { return m_value.index() == expression_index; }
+
     constexpr immediate_t value() const { return std::get<value_index>(m_value); }
 
     constexpr const symbol<TSymbolName>& sym() const { return std::get<symbol_index>(m_value); }
 
-    constexpr bool operator == (const immediate_base& rhs) const
+    const expression<TSymbolName>& expr() const { return *std::get<expression_index>(m_value); }
+
+    // Evaluates the immediate. get_symbol_value returns the value of a symbol.
+    template <typename F>
+    immediate_t evaluate(F get_symbol_value) const
+    {
+        switch (m_value.index())
+        {
+            case value_index:
+                return value();
+            case symbol_index:
+                return get_symbol_value(sym());
+            default:
+                return apply_operator(expr().op, expr().lhs.evaluate(get_symbol_value), expr().rhs.evaluate(get_symbol_value));
+        }
+    }
+
+    // Like evaluate(), but get_symbol_value returns nothing for undefined symbols. Returns nothing
+    // instead of throwing if a symbol is undefined or the expression divides by zero.
+    template <typename F>
+    std::optional<immediate_t> try_evaluate(F get_symbol_value) const
+    {
+        switch (m_value.index())
+        {
+            case value_index:
+                return value();
+            case symbol_index:
+                return get_symbol_value(sym());
+            default:
+            {
+                auto lhs = expr().lhs.try_evaluate(get_symbol_value);
+                auto rhs = expr().rhs.try_evaluate(get_symbol_value);
+                if (!lhs || !rhs || ((expr().op == expression_operator::divide) && (*rhs == 0)))
+                {
+                    return std::nullopt;
+                }
+                return apply_operator(expr().op, *lhs, *rhs);
+            }
+        }
+    }
+
+    // Calls f for every symbol the immediate refers to.
+    template <typename F>
+    void for_each_symbol(F f) const
+    {
+        if (is_symbol_reference())
+        {
+            f(sym());
+        }
+        else if (is_expression())
+        {
+            expr().lhs.for_each_symbol(f);
+            expr().rhs.for_each_symbol(f);
+        }
+    }
+
+    bool operator == (const immediate_base& rhs) const
     {
+        if (is_expression() && rhs.is_expression())
+        {
+            return (expr().op == rhs.expr().op) && (expr().lhs == rhs.expr().lhs) && (expr().rhs == rhs.expr().rhs);
+        }
         return m_value == rhs.m_value;
     }
 
 private:
     static constexpr int value_index = 0;
     static constexpr int symbol_index = 1;
-    const std::variant<immediate_t, symbol<TSymbolName>> m_value;
+    static constexpr int expression_index = 2;
+    const std::variant<immediate_t, symbol<TSymbolName>, std::shared_ptr<const expression<TSymbolName>>> m_value;
 };
 
 // General implementation of immediate.
@@ -62,6 +202,108 @@ public:
     immediate(std::string symbol_name) : immediate_base(symbol<std::string>(symbol_name)) {}
 };
 
+// A node of an expression tree. Its value is computed by link().
+template <typename TSymbolName>
+class expression final
+{
+public:
+    expression_operator op;
+    immediate<TSymbolName> lhs;
+    immediate<TSymbolName> rhs;
+};
+
+// Expressions whose operands are constants are folded right away.
+template <typename TSymbolName>
+immediate<TSymbolName> make_expression(expression_operator op, immediate<TSymbolName> lhs, immediate<TSymbolName> rhs)
+{
+    if (lhs.is_constant() && rhs.is_constant())
+    {
+        return apply_operator(op, lhs.value(), rhs.value());
+    }
+    return std::make_shared<const expression<TSymbolName>>(expression<TSymbolName>{ op, std::move(lhs), std::move(rhs) });
+}
+
+template <typename T>
+struct expression_operand_traits {};
+
+template <typename TSymbolName>
+struct expression_operand_traits<immediate<TSymbolName>> { using symbol_name = TSymbolName; };
+
+template <typename TSymbolName>
+struct expression_operand_traits<symbol<TSymbolName>> { using symbol_name = TSymbolName; };
+
+// Operands of expression operators: at least one is a symbol or immediate, the other may be an integer.
+template <typename L, typename R>
+concept expression_operands =
+    (requires { typename expression_operand_traits<L>::symbol_name; } && (std::integral<R> || requires { typename expression_operand_traits<R>::symbol_name; })) ||
+    (std::integral<L> && requires { typename expression_operand_traits<R>::symbol_name; });
+
+template <typename L, typename R>
+using expression_symbol_name_t = typename std::conditional_t<std::integral<L>, expression_operand_traits<R>, expression_operand_traits<L>>::symbol_name;
+
+template <typename L, typename R>
+immediate<expression_symbol_name_t<L, R>> make_expression_from_operands(expression_operator op, const L& l, const R& r)
+{
+    using immediate_type = immediate<expression_symbol_name_t<L, R>>;
+    auto to_immediate = [](const auto& operand)
+    {
+        if constexpr (std::integral<std::remove_cvref_t<decltype(operand)>>)
+        {
+            return immediate_type(static_cast<immediate_t>(operand));
+        }
+        else
+        {
+            return immediate_type(operand);
+        }
+    };
+    return make_expression(op, to_immediate(l), to_immediate(r));
+}
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator + (const L& l, const R& r) { return make_expression_from_operands(expression_operator::add, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator - (const L& l, const R& r) { return make_expression_from_operands(expression_operator::subtract, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator * (const L& l, const R& r) { return make_expression_from_operands(expression_operator::multiply, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator / (const L& l, const R& r) { return make_expression_from_operands(expression_operator::divide, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator << (const L& l, const R& r) { return make_expression_from_operands(expression_operator::shift_left, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator >> (const L& l, const R& r) { return make_expression_from_operands(expression_operator::shift_right, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator & (const L& l, const R& r) { return make_expression_from_operands(expression_operator::bitwise_and, l, r); }
+
+template <typename L, typename R> requires expression_operands<L, R>
+auto operator | (const L& l, const R& r) { return make_expression_from_operands(expression_operator::bitwise_or, l, r); }
+
+}
+
+namespace lzasm::arm::arm32
+{
+
+// Immediate that instructions check against the range and alignment of their operand at compile time.
+// An out of range value does not compile, and a value that fits is not checked again at runtime.
+// For example a.lsr(r0, r1, imm<23>).
+template <immediate_t value>
+inline constexpr detail::constant_immediate<value> imm{};
+
+// Symbols live in this namespace, so argument dependent lookup finds the operators for them here.
+using detail::operator +;
+using detail::operator -;
+using detail::operator *;
+using detail::operator /;
+using detail::operator <<;
+using detail::operator >>;
+using detail::operator &;
+using detail::operator |;
+
 }
 
 #endif
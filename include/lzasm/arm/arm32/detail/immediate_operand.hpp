@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_IMMEDIATE_OPERAND_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_IMMEDIATE_OPERAND_HPP_INCLUDED
+
+#include <concepts>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/immediate.hpp"
+#include "lzasm/arm/arm32/detail/reference.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Whether a value passes the range and alignment checks of an operand of the given type.
+template <reference_type type>
+consteval bool is_valid_operand(immediate_t value)
+{
+    constexpr const auto& d = reference_type_descriptors::get<type>();
+    return (value >= d.min) && (value <= d.max) && ((value & (get_byte_alignment(d.alignment) - 1)) == 0);
+}
+
+// Immediate operand of an instruction whose value must fit into the given reference type.
+// It converts from everything immediate converts from. Values of constant_immediate
+// are checked at compile time instead of when the instruction is assembled.
+template <typename TSymbolName, reference_type type>
+class immediate_operand final
+{
+public:
+    template <typename T> requires std::convertible_to<const T&, immediate<TSymbolName>> && (!is_constant_immediate<T>::value)
+    immediate_operand(const T& value) : m_value(value), m_is_checked(false) {}
+
+    // An out of range or misaligned value leaves no viable conversion, so the call does not compile.
+    template <immediate_t v> requires (is_valid_operand<type>(v))
+    immediate_operand(constant_immediate<v>) : m_value(v), m_is_checked(true) {}
+
+    const immediate<TSymbolName>& value() const { return m_value; }
+
+    // Whether the value is a constant that was checked at compile time.
+    bool is_checked() const { return m_is_checked; }
+
+private:
+    const immediate<TSymbolName> m_value;
+    const bool m_is_checked;
+};
+
+}
+
+#endif
@@ -0,0 +1,341 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_LAYOUT_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_LAYOUT_HPP_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// What padding bytes are filled with.
+enum class padding_fill
+{
+    zero,
+    nop         // mov r8, r8
+};
+
+// Alignment directive, recorded so that padding can be recomputed when the layout changes.
+class alignment_record final
+{
+public:
+    alignment_record(address_t location, address_t alignment, address_t padding, address_t distance = 0, padding_fill fill = padding_fill::zero)
+        : location(location), alignment(alignment), padding(padding), distance(distance), fill(fill) {}
+
+    // Location of the padding, that is, the location counter before align() emitted any bytes.
+    address_t location;
+    address_t alignment;
+
+    // Number of padding bytes currently in the object.
+    address_t padding;
+
+    // Distance from the end of the padding to the address that is aligned.
+    // This is zero, except for code alignment padding that was moved in front of unreachable code.
+    address_t distance;
+
+    padding_fill fill;
+};
+
+// Appends padding bytes. Nops are halfword aligned, an odd byte is filled with zero.
+inline void append_padding(bytevector& bytes, address_t size, padding_fill fill)
+{
+    if (fill == padding_fill::zero)
+    {
+        bytes.insert(bytes.end(), size, 0);
+        return;
+    }
+
+    if (size % 2)
+    {
+        bytes.push_back(0);
+    }
+    for (address_t i = 0; i < size / 2; ++i)
+    {
+        bytes.push_back(0xc0);
+        bytes.push_back(0x46);
+    }
+}
+
+// Replaces size bytes at address by replacement.
+// A size of zero inserts bytes, an empty replacement deletes bytes.
+class edit final
+{
+public:
+    edit(address_t address, address_t size, bytevector replacement)
+        : address(address), size(size), replacement(std::move(replacement)) {}
+
+    address_t address;
+    address_t size;
+    bytevector replacement;
+};
+
+// Computes a new layout of an object from a set of edits.
+// Padding of alignment directives is recomputed for the new layout.
+// The layout only maps addresses, it does not touch any data, so it can be used
+// to evaluate a candidate set of edits before applying them.
+class layout final
+{
+public:
+    // Edits must be sorted by address and must not overlap each other.
+    // removed_alignments contains indices into alignments, sorted in ascending order.
+    layout(address_t size, const std::vector<alignment_record>& alignments, const std::vector<edit>& edits, const std::vector<size_t>& removed_alignments = {})
+        : old_size(size), new_alignment_indices(alignments.size(), removed)
+    {
+        build(alignments, edits, removed_alignments);
+    }
+
+    address_t size() const { return new_size; }
+
+    // Maps the address of a byte. Returns nothing if the byte was removed or replaced by an edit.
+    std::optional<address_t> map_location(address_t address) const
+    {
+        auto p = std::upper_bound(
+            pieces.begin(), pieces.end(), address,
+            [](address_t a, const piece& p) { return a < p.old_end; });
+        if ((p == pieces.end()) || (p->kind != piece_kind::copy))
+        {
+            return std::nullopt;
+        }
+
+        return p->new_begin + (address - p->old_begin);
+    }
+
+    // Maps a symbol. Symbols are zero-width, so a symbol at the same address as an alignment
+    // directive or an edit needs to know whether it was defined before or after the alignment directive.
+    // alignment_count is the number of alignment directives that had been recorded when the symbol was defined.
+    // A symbol at the start of an edit is mapped to the start of the replacement.
+    address_t map_symbol(address_t address, size_t alignment_count) const
+    {
+        if ((alignment_count > 0) && (alignment_ends[alignment_count - 1].first == address) && (new_alignment_indices[alignment_count - 1] != removed))
+        {
+            return alignment_ends[alignment_count - 1].second;
+        }
+
+        auto p = std::partition_point(
+            pieces.begin(), pieces.end(),
+            [&](const piece& p) { return (p.old_end <= address) && (p.old_begin < address); });
+        if (p == pieces.end())
+        {
+            return new_size;
+        }
+
+        if (p->kind == piece_kind::copy)
+        {
+            return p->new_begin + (address - p->old_begin);
+        }
+
+        return p->new_begin;
+    }
+
+    // Maps the number of alignment directives recorded before a symbol definition.
+    size_t map_alignment_count(size_t alignment_count) const
+    {
+        return alignment_count == 0 ? 0 : new_alignment_counts[alignment_count - 1];
+    }
+
+    // New index of an alignment directive, or nothing if it was removed.
+    std::optional<size_t> map_alignment_index(size_t index) const
+    {
+        auto i = new_alignment_indices[index];
+        return i == removed ? std::nullopt : std::optional<size_t>(i);
+    }
+
+    // Address of the replacement bytes of an edit in the new layout.
+    address_t replacement_address(size_t edit_index) const
+    {
+        return replacement_addresses[edit_index];
+    }
+
+    // Builds the data of the new layout.
+    bytevector apply(const bytevector& data, const std::vector<edit>& edits) const
+    {
+        bytevector result;
+        result.reserve(new_size);
+        for (const auto& p : pieces)
+        {
+            switch (p.kind)
+            {
+                case piece_kind::copy:
+                    result.insert(result.end(), data.begin() + p.old_begin, data.begin() + p.old_end);
+                    break;
+                case piece_kind::padding:
+                    append_padding(result, p.new_end - p.new_begin, fills[p.index]);
+                    break;
+                case piece_kind::replacement:
+                    result.insert(result.end(), edits[p.index].replacement.begin(), edits[p.index].replacement.end());
+                    break;
+            }
+        }
+
+        assert(result.size() == new_size);
+        return result;
+    }
+
+    // Returns the alignment directives of the new layout.
+    std::vector<alignment_record> map_alignments(const std::vector<alignment_record>& alignments) const
+    {
+        std::vector<alignment_record> result;
+        for (size_t i = 0; i < alignments.size(); ++i)
+        {
+            if (new_alignment_indices[i] != removed)
+            {
+                const auto& a = alignments[i];
+                result.emplace_back(alignment_locations[i], a.alignment, alignment_paddings[i], alignment_distances[i], a.fill);
+            }
+        }
+        return result;
+    }
+
+private:
+    enum class piece_kind
+    {
+        copy,
+        padding,
+        replacement
+    };
+
+    struct piece
+    {
+        piece_kind kind;
+        address_t old_begin;
+        address_t old_end;
+        address_t new_begin;
+        address_t new_end;
+        size_t index;
+    };
+
+    void build(const std::vector<alignment_record>& alignments, const std::vector<edit>& edits, const std::vector<size_t>& removed_alignments)
+    {
+        constexpr auto none = std::numeric_limits<address_t>::max();
+        alignment_ends.resize(alignments.size(), std::make_pair(none, 0));
+        alignment_locations.resize(alignments.size(), 0);
+        alignment_paddings.resize(alignments.size(), 0);
+        alignment_distances.resize(alignments.size(), 0);
+        fills.resize(alignments.size(), padding_fill::zero);
+        new_alignment_counts.resize(alignments.size(), 0);
+        replacement_addresses.resize(edits.size(), 0);
+
+        address_t old_lc = 0;
+        address_t new_lc = 0;
+        size_t ai = 0;
+        size_t ei = 0;
+        size_t ri = 0;
+        size_t surviving_alignments = 0;
+
+        auto is_removed = [&](size_t index)
+        {
+            while ((ri < removed_alignments.size()) && (removed_alignments[ri] < index))
+            {
+                ++ri;
+            }
+            return (ri < removed_alignments.size()) && (removed_alignments[ri] == index);
+        };
+
+        auto copy_to = [&](address_t old_end)
+        {
+            assert(old_end >= old_lc);
+            if (old_end > old_lc)
+            {
+                auto length = old_end - old_lc;
+                pieces.push_back({ piece_kind::copy, old_lc, old_end, new_lc, new_lc + length, 0 });
+                old_lc = old_end;
+                new_lc += length;
+            }
+        };
+
+        while ((ai < alignments.size()) || (ei < edits.size()))
+        {
+            auto next_alignment = ai < alignments.size() ? alignments[ai].location : none;
+            auto next_edit = ei < edits.size() ? edits[ei].address : none;
+
+            // An alignment directive at the same address as an edit is processed first.
+            if (next_alignment <= next_edit)
+            {
+                copy_to(next_alignment);
+
+                const auto& a = alignments[ai];
+                auto byte_alignment = get_byte_alignment(a.alignment);
+                auto old_padding = a.padding;
+                auto new_padding = old_padding;
+                fills[ai] = a.fill;
+
+                if (is_removed(ai))
+                {
+                    new_padding = 0;
+                }
+                else
+                {
+                    // Edits between the padding and the aligned address change their distance.
+                    auto distance = a.distance;
+                    auto aligned_address = old_lc + old_padding + a.distance;
+                    for (auto i = ei; (i < edits.size()) && (edits[i].address < aligned_address); ++i)
+                    {
+                        distance = distance + static_cast<address_t>(edits[i].replacement.size()) - edits[i].size;
+                    }
+
+                    new_padding = (byte_alignment - (new_lc + distance) % byte_alignment) % byte_alignment;
+                    alignment_locations[ai] = new_lc;
+                    alignment_paddings[ai] = new_padding;
+                    alignment_distances[ai] = distance;
+                    new_alignment_indices[ai] = surviving_alignments++;
+                }
+
+                pieces.push_back({ piece_kind::padding, old_lc, old_lc + old_padding, new_lc, new_lc + new_padding, ai });
+                old_lc += old_padding;
+                new_lc += new_padding;
+                alignment_ends[ai] = std::make_pair(a.location, new_lc);
+                new_alignment_counts[ai] = surviving_alignments;
+                ++ai;
+            }
+            else
+            {
+                copy_to(next_edit);
+
+                const auto& e = edits[ei];
+                auto length = static_cast<address_t>(e.replacement.size());
+                pieces.push_back({ piece_kind::replacement, old_lc, old_lc + e.size, new_lc, new_lc + length, ei });
+                replacement_addresses[ei] = new_lc;
+                old_lc += e.size;
+                new_lc += length;
+                ++ei;
+
+                // Alignment directives within the replaced range disappear.
+                while ((ai < alignments.size()) && (alignments[ai].location < old_lc))
+                {
+                    new_alignment_counts[ai] = surviving_alignments;
+                    ++ai;
+                }
+            }
+        }
+
+        copy_to(old_size);
+        new_size = new_lc;
+    }
+
+    static constexpr size_t removed = std::numeric_limits<size_t>::max();
+    address_t old_size;
+    address_t new_size = 0;
+    std::vector<piece> pieces;
+    std::vector<std::pair<address_t, address_t>> alignment_ends;
+    std::vector<address_t> alignment_locations;
+    std::vector<address_t> alignment_paddings;
+    std::vector<address_t> alignment_distances;
+    std::vector<padding_fill> fills;
+    std::vector<size_t> new_alignment_indices;
+    std::vector<size_t> new_alignment_counts;
+    std::vector<address_t> replacement_addresses;
+};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_LINK_OPTIONS_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_LINK_OPTIONS_HPP_INCLUDED
+
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// Controls whether link() may replace "ldr rd, =value" by a cheaper instruction sequence.
+enum class literal_relaxation
+{
+    // Never replace literal loads.
+    none,
+
+    // Only use replacements that do not modify the flags, that is, adr.
+    flag_preserving,
+
+    // Also use mov, mov/lsl and mov/mvn where the flags they set are not read afterwards.
+    all
+};
+
+class link_options final
+{
+public:
+    literal_relaxation relax_literals = literal_relaxation::none;
+
+    // Remove code and data that cannot be reached from the entry points. See USAGE.md.
+    bool strip_unreachable = false;
+
+    // Fold identical routines into one copy. See USAGE.md.
+    bool fold_identical_code = false;
+
+    // Remove redundant instructions, such as branches to the next instruction. See USAGE.md.
+    bool peephole = false;
+
+    // Reorder instructions to hide load-use interlocks. See USAGE.md.
+    bool schedule_loads = false;
+
+    // Alignment of hot loops that are the target of a backward branch, see align().
+    // The default of zero leaves them where they are.
+    address_t hot_loop_alignment = 0;
+};
+
+}
+
+#endif
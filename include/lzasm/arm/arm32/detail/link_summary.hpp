@@ -0,0 +1,40 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_LINK_SUMMARY_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_LINK_SUMMARY_HPP_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/error_policy.hpp"
+#include "lzasm/arm/arm32/detail/symbol.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// An error that link() would report for a fixup, at the absolute address of the instruction or data.
+using link_error = diagnostic;
+
+// Result of a dry run link: the layout link() would produce, and the errors it would report.
+template <typename TSymbolName>
+class basic_link_summary final
+{
+public:
+    // Size of the program in bytes.
+    address_t size = 0;
+
+    // Absolute addresses of the labels.
+    std::map<symbol<TSymbolName>, address_t> symbols;
+
+    // Errors of references come first, in program order, then those of switch tables and pseudo instructions.
+    std::vector<link_error> errors;
+};
+
+using link_summary = basic_link_summary<std::string>;
+
+}
+
+#endif
@@ -25,6 +25,34 @@ public:
     address_t address;
 };
 
+// A literal that has been placed into a literal pool.
+template <typename TSymbolName>
+class pool_entry final
+{
+public:
+    pool_entry(const immediate<TSymbolName>& value, address_t address, size_t alignment_index)
+        : value(value), address(address), alignment_index(alignment_index) {}
+
+    const immediate<TSymbolName> value;
+    const address_t address;
+
+    // Index of the alignment directive emitted by the pool directive that created this entry.
+    const size_t alignment_index;
+};
+
+// An "ldr rd, =value" instruction whose literal has been placed into a literal pool.
+class literal_load final
+{
+public:
+    literal_load(address_t fixup_location, size_t entry)
+        : fixup_location(fixup_location), entry(entry) {}
+
+    const address_t fixup_location;
+
+    // Index of the pool entry.
+    const size_t entry;
+};
+
 }
 
 #endif
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_MERGEABLE_DATA_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_MERGEABLE_DATA_HPP_INCLUDED
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/reference.hpp"
+#include "lzasm/arm/arm32/detail/symbol.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// A labeled block of read-only data that link() emits after the code,
+// unless the block is the end of another block.
+template <typename TSymbolName>
+class mergeable_block final
+{
+public:
+    symbol<TSymbolName> name;
+    address_t alignment;
+    bytevector bytes;
+
+    // Fixup locations are relative to the start of the block.
+    std::vector<reference<TSymbolName>> references;
+
+    // Returns the offset at which other ends with this block. Both the bytes and the
+    // references must match, and the offset must keep the alignment of this block.
+    // get_size returns the number of bytes a reference type patches.
+    template <typename F>
+    std::optional<address_t> find_in(const mergeable_block& other, F get_size) const
+    {
+        if ((bytes.size() > other.bytes.size()) || (alignment > other.alignment))
+        {
+            return std::nullopt;
+        }
+
+        address_t offset = other.bytes.size() - bytes.size();
+        if ((offset % get_byte_alignment(alignment)) || !std::equal(bytes.begin(), bytes.end(), other.bytes.begin() + offset))
+        {
+            return std::nullopt;
+        }
+
+        size_t matches = 0;
+        for (const auto& ref : other.references)
+        {
+            if (ref.fixup_location >= offset)
+            {
+                auto same = [&](const auto& r) { return (r.type == ref.type) && (r.fixup_location + offset == ref.fixup_location) && (r.value == ref.value); };
+                if (std::none_of(references.begin(), references.end(), same))
+                {
+                    return std::nullopt;
+                }
+                ++matches;
+            }
+            else if (ref.fixup_location + get_size(ref.type) > offset)
+            {
+                // The fixup overlaps the start of this block.
+                return std::nullopt;
+            }
+        }
+
+        if (matches != references.size())
+        {
+            return std::nullopt;
+        }
+
+        return offset;
+    }
+};
+
+}
+
+#endif
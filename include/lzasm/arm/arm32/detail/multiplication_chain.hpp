@@ -0,0 +1,174 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_MULTIPLICATION_CHAIN_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_MULTIPLICATION_CHAIN_HPP_INCLUDED
+
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Registers used by a multiplication chain.
+enum class chain_operand
+{
+    rd,         // Destination, accumulates the product
+    x,          // Holds the multiplicand throughout the chain
+    t           // Scratch register for intermediate values
+};
+
+enum class chain_operation
+{
+    mov,        // mov dst, a
+    mov_zero,   // mov dst, #0
+    lsl,        // lsl dst, a, #shift
+    add,        // add dst, a, b
+    sub,        // sub dst, a, b
+    neg         // neg dst, a
+};
+
+class chain_step final
+{
+public:
+    chain_operation operation;
+    chain_operand dst;
+    chain_operand a;
+    chain_operand b;
+    uint32_t shift;
+};
+
+using multiplication_chain = std::vector<chain_step>;
+
+// Searches for the shortest sequence of lsl/add/sub/neg instructions that multiplies by a constant.
+// This is a variant of Bernstein's algorithm: odd factors are reduced by adding or subtracting the
+// multiplicand, or by factoring out 2^s+1 or 2^s-1. Even factors are reduced by a shift.
+// All arithmetic is modulo 2^32, so the constant is treated as a signed 32 bit value.
+class multiplication_chain_search final
+{
+public:
+    // x_available: the multiplicand can be read from a register other than rd throughout the chain.
+    // t_available: there is a scratch register for intermediate values. It must not be the one holding x.
+    // rd_holds_x: rd contains the multiplicand before the chain starts.
+    multiplication_chain_search(bool x_available, bool t_available, bool rd_holds_x)
+        : x_available(x_available), t_available(t_available), rd_holds_x(rd_holds_x) {}
+
+    std::optional<multiplication_chain> find(uint32_t k)
+    {
+        return search(static_cast<int32_t>(k));
+    }
+
+private:
+    std::optional<multiplication_chain> search(int64_t k)
+    {
+        if (auto i = memo.find(k); i != memo.end())
+        {
+            return i->second;
+        }
+
+        auto result = search_uncached(k);
+        memo[k] = result;
+        return result;
+    }
+
+    std::optional<multiplication_chain> search_uncached(int64_t k)
+    {
+        using enum chain_operation;
+        using enum chain_operand;
+
+        // Operand holding the multiplicand when the chain starts.
+        auto initial_x = x_available ? x : rd;
+        auto has_initial_x = x_available || rd_holds_x;
+
+        if (k == 0)
+        {
+            return multiplication_chain{ { mov_zero, rd, rd, rd, 0 } };
+        }
+
+        if (!has_initial_x)
+        {
+            return std::nullopt;
+        }
+
+        if (k == 1)
+        {
+            return rd_holds_x ? multiplication_chain() : multiplication_chain{ { mov, rd, x, x, 0 } };
+        }
+
+        if (k == -1)
+        {
+            return multiplication_chain{ { neg, rd, initial_x, initial_x, 0 } };
+        }
+
+        std::optional<multiplication_chain> best;
+        auto consider = [&](int64_t m, std::initializer_list<chain_step> tail)
+        {
+            if (auto chain = search(m); chain && (!best || (chain->size() + tail.size() < best->size())))
+            {
+                chain->insert(chain->end(), tail);
+                best = std::move(chain);
+            }
+        };
+
+        if ((k & 1) == 0)
+        {
+            auto s = static_cast<uint32_t>(std::countr_zero(static_cast<uint64_t>(k)));
+            auto m = k >> s;
+
+            // x << 31 is the same for every odd multiple of 2^31.
+            if ((m == 1) || (s == 31))
+            {
+                return multiplication_chain{ { lsl, rd, initial_x, initial_x, s } };
+            }
+
+            consider(m, { { lsl, rd, rd, rd, s } });
+            return best;
+        }
+
+        if (x_available)
+        {
+            consider(k - 1, { { add, rd, rd, x, 0 } });
+            consider(k + 1, { { sub, rd, rd, x, 0 } });
+            consider(1 - k, { { sub, rd, x, rd, 0 } });
+        }
+
+        if (t_available)
+        {
+            for (uint32_t s = 1; s < 32; ++s)
+            {
+                auto power = int64_t(1) << s;
+                if ((s > 1) && (k % (power - 1) == 0))
+                {
+                    consider(k / (power - 1), { { lsl, t, rd, rd, s }, { sub, rd, t, rd, 0 } });
+                    consider(-k / (power - 1), { { lsl, t, rd, rd, s }, { sub, rd, rd, t, 0 } });
+                }
+
+                if (k % (power + 1) == 0)
+                {
+                    consider(k / (power + 1), { { lsl, t, rd, rd, s }, { add, rd, t, rd, 0 } });
+                }
+            }
+        }
+
+        if (k < 0)
+        {
+            consider(-k, { { neg, rd, rd, rd, 0 } });
+        }
+
+        return best;
+    }
+
+    bool x_available;
+    bool t_available;
+    bool rd_holds_x;
+    std::map<int64_t, std::optional<multiplication_chain>> memo;
+};
+
+}
+
+#endif
@@ -7,12 +7,30 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <map>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <vector>
 #include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/code_folding.hpp"
+#include "lzasm/arm/arm32/detail/compression_estimator.hpp"
+#include "lzasm/arm/arm32/detail/constant_synthesis.hpp"
+#include "lzasm/arm/arm32/detail/custom_reference.hpp"
+#include "lzasm/arm/arm32/detail/dead_stripping.hpp"
+#include "lzasm/arm/arm32/detail/error_policy.hpp"
 #include "lzasm/arm/arm32/detail/immediate.hpp"
+#include "lzasm/arm/arm32/detail/layout.hpp"
+#include "lzasm/arm/arm32/detail/link_options.hpp"
+#include "lzasm/arm/arm32/detail/link_summary.hpp"
 #include "lzasm/arm/arm32/detail/literal.hpp"
+#include "lzasm/arm/arm32/detail/mergeable_data.hpp"
+#include "lzasm/arm/arm32/detail/optimization_goal.hpp"
+#include "lzasm/arm/arm32/detail/peephole.hpp"
 #include "lzasm/arm/arm32/detail/reference.hpp"
+#include "lzasm/arm/arm32/detail/scheduler.hpp"
 #include "lzasm/arm/arm32/detail/symbol.hpp"
 #include "lzasm/arm/arm32/detail/utilities.hpp"
 
@@ -20,28 +38,116 @@ namespace lzasm::arm::arm32::detail
 {
 
 // Object for little endian ARM CPUs
-template <typename TSymbolName>
+template <typename TSymbolName, error_policy TErrorPolicy = throwing_error_policy>
 class object final
 {
 public:
+    object() = default;
+
     void add_reference(reference_type type, const immediate<TSymbolName>& value)
     {
-        references.emplace_back(type, current_lc(), value);
+        references.emplace_back(type, current_lc(), resolve_constants(value));
     }
 
     void add_reference_to_literal(const immediate<TSymbolName>& imm)
     {
-        auto literal_name = get_name_of_new_or_existing_literal(imm);
+        auto literal_name = get_name_of_new_or_existing_literal(resolve_constants(imm));
         literal_references.emplace_back(current_lc(), literal_name);
     }
 
+    // Local labels are anonymous labels for pseudo instructions that need internal branch targets.
+    // Like symbols, they are moved along with the code when the layout changes.
+    local_label_t create_local_label()
+    {
+        local_labels.emplace_back(std::nullopt);
+        return local_labels.size() - 1;
+    }
+
+    void define_local_label(local_label_t label)
+    {
+        local_labels[label] = symbol_definition{ current_lc(), alignments.size() };
+    }
+
+    void add_local_reference(reference_type type, local_label_t label)
+    {
+        local_references.emplace_back(type, current_lc(), label);
+    }
+
+    // Marks the conditional branch emitted next as one that link() lengthens if its target is out of range.
+    void add_lengthenable_branch()
+    {
+        lengthenable_branches.push_back(current_lc());
+    }
+
+    // A symbol that is already defined keeps its first definition.
     void add_symbol(const symbol<TSymbolName>& symbol)
     {
-        auto insertion_result = symbols.insert(std::make_pair(symbol, current_lc()));
-        if (!insertion_result.second)
+        if (constants.contains(symbol) || symbols.contains(symbol))
+        {
+            report(current_lc(), "Symbol is already defined");
+            return;
+        }
+
+        symbols.emplace(symbol, symbol_definition{ current_lc(), alignments.size() });
+    }
+
+    reference_type add_custom_reference_type(custom_reference_type type)
+    {
+        if ((type.size == 0) || (type.min > type.max) || (type.alignment < 0) || (type.alignment > max_alignment) || !type.patch)
+        {
+            report_error("Invalid custom reference type");
+        }
+
+        custom_reference_types.push_back(std::move(type));
+        return static_cast<reference_type>(to_underlying(reference_type::first_custom) + custom_reference_types.size() - 1);
+    }
+
+    const custom_reference_type& get_custom_reference_type(reference_type type) const
+    {
+        auto index = static_cast<size_t>(to_underlying(type) - to_underlying(reference_type::first_custom));
+        if (!is_custom(type) || (index >= custom_reference_types.size()))
+        {
+            report_error("Invalid custom reference type");
+        }
+
+        return custom_reference_types[index];
+    }
+
+    // Defines a symbol whose value is a number rather than an address. Only constants
+    // defined as redefinable may be defined again, which changes their value from then on.
+    void add_constant(const symbol<TSymbolName>& symbol, const immediate<TSymbolName>& value, bool is_redefinable)
+    {
+        auto existing = constants.find(symbol);
+        if (symbols.contains(symbol) || ((existing != constants.end()) && !(existing->second.is_redefinable && is_redefinable)))
         {
-            report_error("Symbol is already defined");
+            report(current_lc(), "Symbol is already defined");
+            return;
+        }
+
+        auto resolved = resolve_constants(value);
+        if (!resolved.is_constant())
+        {
+            report(current_lc(), "Value of constant is not known");
+            return;
+        }
+
+        constants.insert_or_assign(symbol, constant_definition{ resolved.value(), is_redefinable });
+    }
+
+    // Replaces the constants an immediate refers to by their values.
+    // Constants defined later are left alone, link() resolves them.
+    immediate<TSymbolName> resolve_constants(const immediate<TSymbolName>& imm) const
+    {
+        if (imm.is_symbol_reference())
+        {
+            auto constant = constants.find(imm.sym());
+            return constant != constants.end() ? immediate<TSymbolName>(constant->second.value) : imm;
         }
+        if (imm.is_expression())
+        {
+            return make_expression(imm.expr().op, resolve_constants(imm.expr().lhs), resolve_constants(imm.expr().rhs));
+        }
+        return imm;
     }
 
     void align(address_t alignment)
@@ -49,19 +155,264 @@ public:
         check_alignment_is_in_range(alignment);
 
         auto byte_alignment = get_byte_alignment(alignment);
-        while (current_lc() % byte_alignment != 0)
+        auto padding = (byte_alignment - current_lc() % byte_alignment) % byte_alignment;
+        auto fill = padding_fill::zero;
+        if ((goal == optimization_goal::compressed_size) && (padding >= 2) &&
+            (estimate_padding_bits(padding, padding_fill::nop) < estimate_padding_bits(padding, padding_fill::zero)))
+        {
+            fill = padding_fill::nop;
+        }
+        alignments.emplace_back(current_lc(), alignment, padding, 0, fill);
+        if (layout_only_source)
+        {
+            layout_only_size += padding;
+        }
+        else
+        {
+            append_padding(data, padding, fill);
+        }
+    }
+
+    // Like align(), but pads with nops. If the code before the location counter can only be
+    // entered by a branch, because it follows an unconditional branch, the padding is put in
+    // front of that code instead, where it is never executed.
+    void align_code(address_t alignment)
+    {
+        check_alignment_is_in_range(alignment);
+        insert_code_alignment(current_lc(), alignment);
+    }
+
+    // Hot loops are aligned by link() if they are the target of a backward branch.
+    void add_hot_loop(const symbol<TSymbolName>& symbol)
+    {
+        add_symbol(symbol);
+        hot_loops.push_back(symbol);
+    }
+
+    // Records a jump table starting at the location counter. The caller emits the dispatch code in front of it.
+    void add_switch_table(reference_type type, std::vector<immediate<TSymbolName>> targets)
+    {
+        std::vector<immediate<TSymbolName>> resolved_targets;
+        for (const auto& target : targets)
+        {
+            resolved_targets.push_back(resolve_constants(target));
+        }
+        switch_tables.emplace_back(type, current_lc(), std::move(resolved_targets));
+    }
+
+    // Emits a placeholder for the prologue of a function. end_function() replaces it.
+    void begin_function()
+    {
+        if (function)
+        {
+            report_error("Function is already open");
+        }
+        function = function_record{ current_lc(), {}, 0 };
+        emit_instruction16(bx_lr_opcode);
+    }
+
+    // Emits a placeholder for a return sequence of the open function.
+    void add_function_return()
+    {
+        if (!function)
+        {
+            report_error("No function is open");
+        }
+        function->returns.push_back(current_lc());
+        emit_instruction16(bx_lr_opcode);
+    }
+
+    // Records registers written by code that end_function() cannot decode, such as ARM state code.
+    void add_register_writes(uint_fast16_t mask)
+    {
+        if (function)
+        {
+            function->written |= mask;
+        }
+    }
+
+    // Replaces the placeholders of the open function by the smallest frame that preserves
+    // the registers r4-r7 the function body writes, and lr if the body contains calls.
+    void end_function()
+    {
+        if (!function)
+        {
+            report_error("No function is open");
+        }
+        auto f = std::move(*function);
+        function.reset();
+
+        auto written = f.written;
+        auto first = std::upper_bound(instructions.begin(), instructions.end(), f.start);
+        for (auto i = first; i != instructions.end(); ++i)
+        {
+            if (std::find(f.returns.begin(), f.returns.end(), *i) == f.returns.end())
+            {
+                auto opcode = peek16(*i);
+                written |= decode_thumb_instruction(opcode).defs;
+                if ((opcode >> 11) == 0b11110)
+                {
+                    // bl overwrites lr
+                    written |= lr_mask;
+                }
+            }
+        }
+
+        auto saved = static_cast<uint_fast16_t>(written & 0xf0);
+        auto needs_lr = (written & lr_mask) != 0;
+        if (!saved && !needs_lr)
+        {
+            // Leaf function that needs no frame: the returns stay bx lr.
+            relayout({ edit(f.start, 2, {}) });
+            return;
+        }
+
+        if (needs_lr || (goal != optimization_goal::speed))
+        {
+            // Returning with pop {pc} saves the bx lr, at the cost of saving lr.
+            poke16(f.start, 0xb500 | saved);
+            for (auto address : f.returns)
+            {
+                poke16(address, 0xbd00 | saved);
+            }
+            return;
+        }
+
+        // A leaf function optimized for speed does not save lr, and returns with pop followed by bx lr.
+        poke16(f.start, 0xb400 | saved);
+        std::vector<edit> edits;
+        for (auto address : f.returns)
+        {
+            edits.emplace_back(address, 2, bytevector{ static_cast<unsigned char>(saved), 0xbc, 0x70, 0x47 });
+        }
+        layout l(current_lc(), alignments, edits, {});
+        apply_layout(l, edits);
+        for (size_t i = 0; i < edits.size(); ++i)
+        {
+            for (auto address : { l.replacement_address(i), l.replacement_address(i) + 2 })
+            {
+                instructions.insert(std::lower_bound(instructions.begin(), instructions.end(), address), address);
+            }
+        }
+    }
+
+    // Starts recording a block of read-only data. end_mergeable_data() removes it from the
+    // object again, link() emits it after the code unless the block is the end of another block.
+    void begin_mergeable_data()
+    {
+        if (mergeable_start)
+        {
+            report_error("Mergeable data is already open");
+        }
+        mergeable_start = mergeable_data_start{ get_checkpoint(), symbols.size(), alignments.size() };
+    }
+
+    void end_mergeable_data(const symbol<TSymbolName>& symbol, address_t alignment)
+    {
+        check_alignment_is_in_range(alignment);
+        auto start = *mergeable_start;
+        mergeable_start.reset();
+
+        const auto& c = start.state;
+        if ((instructions.size() != c.instructions) || (literal_references.size() != c.literal_references) ||
+            (local_references.size() != c.local_references) || (symbols.size() != start.symbols) ||
+            (alignments.size() != start.alignments))
+        {
+            report_error("Mergeable data must only contain data");
+        }
+        if (symbols.contains(symbol) || std::any_of(mergeable_blocks.begin(), mergeable_blocks.end(), [&](const auto& b) { return b.name == symbol; }))
+        {
+            // The block is dropped.
+            report(c.lc, "Symbol is already defined");
+            rollback(c);
+            return;
+        }
+
+        mergeable_block<TSymbolName> block{ symbol, alignment, bytevector(data.begin() + c.lc, data.end()), {} };
+        for (auto i = c.references; i < references.size(); ++i)
+        {
+            block.references.emplace_back(references[i].type, references[i].fixup_location - c.lc, references[i].value);
+        }
+        rollback(c);
+        mergeable_blocks.push_back(std::move(block));
+    }
+
+    // Makes a symbol a root for dead code stripping, see link_options::strip_unreachable.
+    void add_entry_point(const symbol<TSymbolName>& symbol)
+    {
+        entry_points.push_back(symbol);
+    }
+
+    void set_optimization_goal(optimization_goal g)
+    {
+        goal = g;
+    }
+
+    // Everything pseudo instructions append to the object, so that alternative expansions can be
+    // emitted on trial and removed again.
+    class checkpoint final
+    {
+    public:
+        address_t lc;
+        size_t instructions;
+        size_t references;
+        size_t literals;
+        size_t literal_references;
+        size_t local_labels;
+        size_t local_references;
+    };
+
+    checkpoint get_checkpoint() const
+    {
+        return checkpoint{
+            current_lc(), instructions.size(), references.size(), literals.size(),
+            literal_references.size(), local_labels.size(), local_references.size() };
+    }
+
+    void rollback(const checkpoint& c)
+    {
+        truncate(data, c.lc);
+        truncate(instructions, c.instructions);
+        truncate(references, c.references);
+        truncate(literals, c.literals);
+        truncate(literal_references, c.literal_references);
+        truncate(local_labels, c.local_labels);
+        truncate(local_references, c.local_references);
+    }
+
+    // Estimated number of bits the bytes from start to the location counter compress to.
+    double estimate_compressed_bits(address_t start) const
+    {
+        return detail::estimate_compressed_bits(data, start, current_lc());
+    }
+
+    // Like estimate_compressed_bits(), for everything emitted since the checkpoint.
+    // This includes the pool entries of new literals, which are assumed to follow directly.
+    double estimate_compressed_bits(const checkpoint& c)
+    {
+        auto end = current_lc();
+        for (auto i = c.literals; i < literals.size(); ++i)
         {
-            emit8(0);
+            emit32(get_pool_value(i));
         }
+        auto bits = estimate_compressed_bits(c.lc);
+        truncate(data, end);
+        return bits;
     }
 
     address_t current_lc() const
     {
-        return static_cast<address_t>(data.size());
+        return layout_only_source ? layout_only_size : static_cast<address_t>(data.size());
     }
 
     void emit8(uint_fast8_t u8)
     {
+        if (layout_only_source)
+        {
+            ++layout_only_size;
+            return;
+        }
+
         data.push_back(u8 & 0xff);
     }
 
@@ -77,29 +428,66 @@ public:
         emit16((u32 >> 16) & 0xffff);
     }
 
-    uint_fast8_t peek8(address_t address)
+    // Thumb instructions are emitted separately from data, so that link() knows where instructions start.
+    void emit_instruction16(uint_fast16_t u16)
+    {
+        instructions.push_back(current_lc());
+        emit16(u16);
+    }
+
+    void emit_instruction32(uint_fast32_t u32)
+    {
+        instructions.push_back(current_lc());
+        emit32(u32);
+    }
+
+    // Whether the last thing emitted is a Thumb instruction after which execution never continues with the next one.
+    bool ends_with_unconditional_transfer() const
+    {
+        return !instructions.empty() && (instructions.back() + 2 == current_lc()) && is_unconditional_transfer(peek16(instructions.back()));
+    }
+
+    // A layout-only copy reads the bytes of the object it was copied from, and writes nothing.
+    uint_fast8_t peek8(address_t address) const
     {
-        return data[address];
+        const auto& bytes = layout_only_source ? *layout_only_source : data;
+        return bytes[address];
     }
 
-    uint_fast16_t peek16(address_t address)
+    uint_fast16_t peek16(address_t address) const
     {
-        return data[address + 0] + (data[address + 1] << 8);
+        const auto& bytes = layout_only_source ? *layout_only_source : data;
+        return bytes[address + 0] + (bytes[address + 1] << 8);
     }
 
     void poke8(address_t address, uint_fast8_t u8)
     {
+        if (layout_only_source)
+        {
+            return;
+        }
+
         data[address] = u8;
     }
 
     void poke16(address_t address, uint_fast16_t u16)
     {
+        if (layout_only_source)
+        {
+            return;
+        }
+
         data[address + 0] = u16 & 255;
         data[address + 1] = (u16 >> 8) & 255;
     }
 
     void poke32(address_t address, uint_fast32_t u32)
     {
+        if (layout_only_source)
+        {
+            return;
+        }
+
         data[address + 0] = u32 & 255;
         data[address + 1] = (u32 >> 8) & 255;
         data[address + 2] = (u32 >> 16) & 255;
@@ -114,15 +502,20 @@ public:
         }
 
         align(2);
+        auto alignment_index = alignments.size() - 1;
 
         // Dump the literals into the pool, and record their addresses.
-        for (auto& literal : literals)
+        std::vector<size_t> entries(literals.size());
+        for (auto i : get_literal_pool_order())
         {
+            auto& literal = literals[i];
             literal.address = current_lc();
+            entries[i] = pool_entries.size();
+            pool_entries.emplace_back(literal.value, literal.address, alignment_index);
 
-            if (literal.value.is_symbol_reference())
+            if (!literal.value.is_constant())
             {
-                // The literal is a symbol, e.g. ldr r0,=somesymbol
+                // The literal is a symbol or an expression, e.g. ldr r0,=somesymbol
                 // Add a reference, so that it gets resolved.
                 add_reference(reference_type::abs32, literal.value);
                 emit32(dummy_value);
@@ -142,257 +535,2309 @@ public:
         for (const auto& reference : literal_references)
         {
             fix_reference_to_literal(reference);
+            literal_loads.emplace_back(reference.fixup_location, entries[reference.name]);
         }
 
         literals.clear();
         literal_references.clear();
     }
 
-    void link(address_t origin)
+    // Returns whether the program was linked. Only a policy that does not throw can make link() fail.
+    // Such policies are given every error of the passes and of the fixups.
+    bool link(address_t origin, const link_options& options = link_options(), const symbol_resolver<TSymbolName>& resolver = nullptr)
     {
-        check_origin(origin);
-        emit_literal_pool();
-        for (const auto& ref : references)
+        auto reported = error_count;
+        if (!lay_out(origin, options, resolver))
         {
-            fix_address(ref, origin);
+            return false;
         }
-    }
-
-    bytevector to_bytevector() const { return data; }
-
-private:
-    auto get_name_of_new_or_existing_literal(const immediate<TSymbolName>& imm)
-    {
-        auto iter = std::find_if(literals.begin(), literals.end(), [&](const auto& literal) { return literal.value == imm; });
-        if (iter == literals.end())
+        if constexpr (!TErrorPolicy::is_throwing)
         {
-            literals.emplace_back(imm);
-            iter = literals.end() - 1;
+            // The fixups are written in batches, so they are checked in program order beforehand.
+            check_fixups(origin);
+            if (error_count != reported)
+            {
+                return false;
+            }
         }
 
-        // The index of the literal in the literals buffer is the literal's name by
-        // which it can be referenced. The literal itself does not store its name.
-        return iter - literals.begin();
-    }
-
-    void fix_address(const reference<TSymbolName>& ref, address_t origin)
-    {
-        switch (ref.type)
+        fix_references(origin);
+        for (const auto& table : switch_tables)
+        {
+            fix_switch_table(table, origin);
+        }
+        for (const auto& ref : local_references)
         {
-            case reference_type::abs5_asr_lsr:
-                return fix_abs5_asr_lsr(ref, origin);
-            case reference_type::abs3:
-            case reference_type::abs5:
-            case reference_type::abs6:
-            case reference_type::abs7:
-            case reference_type::abs8_add_sub:
-            case reference_type::abs8_unsigned:
-            case reference_type::abs9_add_sub_sp:
-            case reference_type::abs10:
-            case reference_type::abs16:
-                return fix_abs_generic(ref, origin);
-            case reference_type::abs8_byte:
-                return fix_abs8_byte(ref, origin);
-            case reference_type::abs32:
-                return fix_abs32(ref, origin);
-            case reference_type::adr:
-                return fix_adr(ref, origin);
-            case reference_type::arm_branch:
-                return fix_arm_branch(ref, origin);
-            case reference_type::bl:
-                return fix_bl(ref, origin);
-            case reference_type::conditional_branch:
-                return fix_conditional_branch(ref, origin);
-            case reference_type::unconditional_branch:
-                return fix_unconditional_branch(ref, origin);
-            default:
-                return report_error("Internal error: invalid reference type");
+            fix_local_reference(ref, origin);
         }
+        return true;
     }
 
-    void fix_abs5_asr_lsr(const reference<TSymbolName>& ref, address_t origin)
+    // Computes the layout link() produces with default options, and checks the fixups instead of writing them.
+    // The passes change the object, so they run on a layout-only copy, which leaves this object as it was.
+    // The copy collects all errors in the summary rather than reporting them through the error policy.
+    basic_link_summary<TSymbolName> dry_run_link(address_t origin, const symbol_resolver<TSymbolName>& resolver = nullptr) const
     {
-        if (get_value(ref.value, origin) == 0)
+        basic_link_summary<TSymbolName> summary;
+        object copy(*this, data);
+        copy.dry_run_errors = &summary.errors;
+        if (copy.lay_out(origin, link_options(), resolver))
         {
-            // If the shift count is 0, map ASR/LSR to LSL.
-            // Do so by clearing the most significant five bits of the opcode.
-            auto opcode = peek16(ref.fixup_location);
-            opcode &= 0b0000011111111111;
-            poke16(ref.fixup_location, opcode);
+            copy.check_fixups(origin);
         }
 
-        return fix_abs_generic(ref, origin);
+        summary.size = copy.current_lc();
+        for (const auto& [name, definition] : copy.symbols)
+        {
+            summary.symbols.emplace(name, origin + definition.address);
+        }
+        return summary;
     }
 
-    void fix_abs_generic(const reference<TSymbolName>& ref, address_t origin)
-    {
-        const auto& d = reference_type_descriptors::get(ref.type);
-
-        auto immediate_bits = get_absolute_immediate_bits(ref, origin);
-
-        auto opcode = peek16(ref.fixup_location);
+    bytevector to_bytevector() const { return data; }
 
-        // The assembler should have left the bits for the immediate value all zero.
-        assert((opcode & (d.bit_mask << d.bit_pos)) == 0);
+    const stripping_report& get_stripping_report() const { return stripping; }
 
-        opcode |= immediate_bits << d.bit_pos;
-        poke16(ref.fixup_location, opcode);
-    }
+    const folding_report& get_folding_report() const { return folding; }
 
-    void fix_abs8_byte(const reference<TSymbolName>& ref, address_t origin)
-    {
-        // Note:
-        // * The byte directive cannot be handled using fix_abs_generic, because fix_abs_generic uses peek16 and poke16.
-        //   This will read/write past the end of the program if a byte directive is at the very end of the program,
-        //   that's why fix_abs8_byte exists. It uses poke8 and thus never reads/writes past the end of the program.
-        // * fix_abs8_byte could be used to process other reference types where the bit width is <= 8 and where
-        //   the immediate does not span more than one byte.
-        //   To do so it would have to be changed to use peek8 *and* poke8, though.
-        auto immediate_bits = get_absolute_immediate_bits(ref, origin);
-        poke8(ref.fixup_location, immediate_bits & 255);
-    }
+    const peephole_report& get_peephole_report() const { return peephole; }
 
-    void fix_abs32(const reference<TSymbolName>& ref, address_t origin)
-    {
-        auto immediate_bits = get_absolute_immediate_bits(ref, origin);
-        poke32(ref.fixup_location, immediate_bits);
-    }
+    const scheduling_report& get_scheduling_report() const { return scheduling; }
 
-    void fix_adr(const reference<TSymbolName>& ref, address_t origin)
-    {
-        auto immediate_bits = get_relative_immediate_bits(ref, origin);
-        poke8(ref.fixup_location, immediate_bits & 255);
-    }
+    TErrorPolicy& get_error_policy() { return errors; }
 
-    void fix_arm_branch(const reference<TSymbolName>& ref, address_t origin)
+    // Reports an error through the error policy. Policies that do not throw return, and the
+    // caller continues as if the erroneous operand were zero, or skips what it cannot do.
+    void report(address_t address, const char* message)
     {
-        auto immediate_bits = get_relative_immediate_bits(ref, origin);
-        poke32(ref.fixup_location, 0xea000000 | (immediate_bits & 0x00ffffff));
+        ++error_count;
+        if (dry_run_errors)
+        {
+            dry_run_errors->push_back(link_error{ address, message });
+        }
+        else
+        {
+            errors.report(address, message);
+        }
     }
 
-    void fix_bl(const reference<TSymbolName>& ref, address_t origin)
+    // Applies edits to the object and recomputes the padding of all alignment directives.
+    // Symbols, references and literals are moved along with the code.
+    // References and literal loads within replaced ranges are removed.
+    void relayout(const std::vector<edit>& edits, const std::vector<size_t>& removed_alignments = {})
     {
-        auto immediate_bits = get_relative_immediate_bits(ref, origin);
-
-        // bl is encoded as an instruction pair, where each pair contains 11 bits of the address.
-        // The address itself is 23 bits wide, but the LSB is implicitly zero, so only 22 bits are encoded.
-        auto upper_address_bits = (immediate_bits >> 11) & 2047;
-        auto lower_address_bits = immediate_bits & 2047;
-        poke16(ref.fixup_location + 0, 0xf000 | upper_address_bits);
-        poke16(ref.fixup_location + 2, 0xf800 | lower_address_bits);
+        apply_layout(layout(current_lc(), alignments, edits, removed_alignments), edits);
     }
 
-    void fix_conditional_branch(const reference<TSymbolName>& ref, address_t origin)
+private:
+    class symbol_definition final
     {
-        auto immediate_bits = get_relative_immediate_bits(ref, origin);
-        poke8(ref.fixup_location, immediate_bits & 255);
-    }
+    public:
+        address_t address;
 
-    void fix_unconditional_branch(const reference<TSymbolName>& ref, address_t origin)
-    {
-        auto immediate_bits = get_relative_immediate_bits(ref, origin);
-        poke16(ref.fixup_location, (0b11100 << 11) | (immediate_bits & 2047));
-    }
+        // Number of alignment directives before the symbol definition.
+        size_t alignment_count;
+    };
 
-    void fix_reference_to_literal(const reference_to_literal& ref)
+    class constant_definition final
     {
-        const auto& d = reference_type_descriptors::get(reference_type::literal);
-
-        auto target = literals[ref.name].address;
-        auto relative_address = get_relative_address(target, ref.fixup_location, 0, d);
-        auto immediate_bits = get_immediate_bits(relative_address, d);
-
-        poke8(ref.fixup_location, immediate_bits & 255);
-    }
+    public:
+        immediate_t value;
+        bool is_redefinable;
+    };
 
-    immediate_t get_absolute_immediate_bits(const reference<TSymbolName>& ref, address_t origin)
+    // The function opened by begin_function(), whose frame end_function() fills in.
+    class function_record final
     {
-        auto immediate_value = get_value(ref.value, origin);
+    public:
+        // Address of the prologue placeholder.
+        address_t start;
 
-        // During linking we only support symbol references.
-        // The only type of symbols are labels, which are memory locations and thus
-        // cannot be negative. Therefore, unlike the assembler, we do not perform
-        // special handling of negative values for add/sub instructions and require
-        // that the resolved immediate value is >= 0.
-        assert(ref.value.is_symbol_reference());
-        assert(immediate_value >= 0);
+        // Addresses of the return placeholders.
+        std::vector<address_t> returns;
 
-        const auto& d = reference_type_descriptors::get(ref.type);
-        return get_immediate_bits(immediate_value, d);
-    }
+        // Registers written by code that is not a Thumb instruction.
+        uint_fast16_t written;
+    };
 
-    auto get_relative_immediate_bits(const reference<TSymbolName>& ref, address_t origin)
+    class foldable_routine final
     {
-        const auto& d = reference_type_descriptors::get(ref.type);
-        auto target = get_value(ref.value, origin);
-        auto relative_address = get_relative_address(target, ref.fixup_location, origin, d);
-        return get_immediate_bits(relative_address, d);
-    }
+    public:
+        address_t start;
+        address_t end;
+        folding_key key;
+    };
 
-    template <typename T>
-    auto get_relative_address(T target, address_t fixup_location, address_t origin, const reference_type_descriptor& d)
+    class mergeable_data_start final
     {
-        auto source = origin + fixup_location + d.pc_offset();
-
-        if (d.require_pc_bit1_cleared())
-        {
-            source = clear_bit1(source);
-        }
-
-        return target - source;
-    }
+    public:
+        checkpoint state;
+        size_t symbols;
+        size_t alignments;
+    };
 
-    immediate_t get_immediate_bits(immediate_t imm, const reference_type_descriptor& d)
+    // A candidate replacement for a literal load.
+    class literal_replacement final
     {
-        imm = check_immediate_range(imm, d.min, d.max);
-        imm = check_immediate_is_aligned(imm, d.alignment);
-        return discard_implicitly_zero_bits(imm, d);
-    }
+    public:
+        bool is_adr;
+        address_t size;
+    };
 
-    immediate_t discard_implicitly_zero_bits(immediate_t imm, const reference_type_descriptor& d)
+    // A copy without the bytes, which only tracks their count. Of the passes of the default link options,
+    // only the binding of pc-relative constants reads opcodes, and it runs before the layout changes,
+    // so it reads them from source, the bytes of the original. The other passes only need the size of what
+    // they emit or replace. Unlike link(), the copy does not order literal pools for compressed size, so
+    // loads at the limit of their range may be checked differently.
+    object(const object& other, const bytevector& source)
+        : symbols(other.symbols)
+        , constants(other.constants)
+        , externals(other.externals)
+        , custom_reference_types(other.custom_reference_types)
+        , references(other.references)
+        , literals(other.literals)
+        , literal_references(other.literal_references)
+        , local_labels(other.local_labels)
+        , local_references(other.local_references)
+        , alignments(other.alignments)
+        , pool_entries(other.pool_entries)
+        , literal_loads(other.literal_loads)
+        , instructions(other.instructions)
+        , switch_tables(other.switch_tables)
+        , lengthenable_branches(other.lengthenable_branches)
+        , function(other.function)
+        , mergeable_blocks(other.mergeable_blocks)
+        , mergeable_start(other.mergeable_start)
+        , layout_only_source(&source)
+        , layout_only_size(other.current_lc())
     {
-        // The bitwise and is needed to special handle asr/lsr. It maps shift count 32 to 0.
-        return (imm >> d.alignment) & d.bit_mask;
     }
 
-    immediate_t get_value(const immediate<TSymbolName>& imm, address_t origin)
+    // Checks the fixups like link() would write them, and reports their errors in the order of basic_link_summary.
+    void check_fixups(address_t origin)
     {
-        if (imm.is_symbol_reference())
+        for (const auto& ref : references)
         {
-            auto symbol_table_entry = symbols.find(imm.sym());
-            if (symbol_table_entry == symbols.end())
-            {
-                report_error("Undefined symbol");
-            }
-
-            return symbol_table_entry->second + origin;
+            check_address(ref, origin);
         }
-
-        return imm.value();
-    }
-
-    void check_origin(address_t origin)
-    {
-        if (max_address - current_lc() < origin)
+        for (const auto& table : switch_tables)
         {
-            report_error("Origin too large");
+            get_switch_table_bits(table, origin);
+        }
+        for (const auto& ref : local_references)
+        {
+            check_address(to_reference(ref, origin), origin);
         }
     }
 
-    static void check_alignment_is_in_range(address_t alignment)
+    // Everything link() does before the fixups. Returns false if the program cannot be laid out.
+    // Errors that do not prevent the layout, such as a literal pool out of range, are only reported.
+    bool lay_out(address_t origin, const link_options& options, const symbol_resolver<TSymbolName>& resolver)
     {
-        if (alignment > max_alignment)
+        if (function)
+        {
+            report(origin, "Function is not ended");
+            return false;
+        }
+        if (mergeable_start)
+        {
+            report(origin, "Mergeable data is not ended");
+            return false;
+        }
+        if (max_address - current_lc() < origin)
+        {
+            report(origin, "Origin too large");
+            return false;
+        }
+
+        error_origin = origin;
+        emit_literal_pool();
+        emit_mergeable_data();
+        resolve_external_symbols(resolver);
+        bind_pc_relative_constants(origin);
+        stripping = stripping_report();
+        folding = folding_report();
+        peephole = peephole_report();
+        scheduling = scheduling_report();
+        if (options.strip_unreachable)
+        {
+            strip_unreachable(origin);
+        }
+        if (options.fold_identical_code)
+        {
+            fold_identical_code(origin);
+        }
+        if (options.hot_loop_alignment)
+        {
+            align_hot_loops(options.hot_loop_alignment, origin);
+        }
+        if (options.peephole)
+        {
+            remove_redundant_instructions(origin);
+        }
+        if (options.schedule_loads)
+        {
+            schedule_loads(origin);
+        }
+        lengthen_branches(origin);
+        relax_literal_loads(origin, options.relax_literals);
+        shrink_switch_tables(origin);
+        error_origin = 0;
+        return true;
+    }
+
+    // ldr rd, [pc, #imm] and add rd, pc, #imm encode a constant distance, and pc-relative references
+    // may refer to constant addresses. Those that point into the object are turned into references to
+    // local labels, so that the passes of lay_out() move their targets along with the code.
+    void bind_pc_relative_constants(address_t origin)
+    {
+        std::vector<address_t> fixup_locations;
+        for (const auto& ref : references)
+        {
+            fixup_locations.push_back(ref.fixup_location);
+        }
+        for (const auto& ref : local_references)
+        {
+            fixup_locations.push_back(ref.fixup_location);
+        }
+        for (const auto& ref : literal_references)
+        {
+            fixup_locations.push_back(ref.fixup_location);
+        }
+        for (const auto& load : literal_loads)
+        {
+            fixup_locations.push_back(load.fixup_location);
+        }
+        std::sort(fixup_locations.begin(), fixup_locations.end());
+
+        // The label of a target directly following alignment padding is defined after the alignment directive.
+        auto bind = [&](reference_type type, address_t fixup_location, address_t target)
+        {
+            size_t alignment_count = 0;
+            while ((alignment_count < alignments.size()) && (alignments[alignment_count].location + alignments[alignment_count].padding <= target))
+            {
+                ++alignment_count;
+            }
+            local_labels.emplace_back(symbol_definition{ target, alignment_count });
+            local_references.emplace_back(type, fixup_location, local_labels.size() - 1);
+        };
+
+        for (auto address : instructions)
+        {
+            auto opcode = peek16(address);
+            auto is_ldr = (opcode >> 11) == 0b01001;
+            auto is_add = (opcode >> 11) == 0b10100;
+            if ((is_ldr || is_add) && !std::binary_search(fixup_locations.begin(), fixup_locations.end(), address))
+            {
+                auto target = clear_bit1(address + 4) + (opcode & 255) * 4;
+                if (target <= current_lc())
+                {
+                    bind(is_ldr ? reference_type::literal : reference_type::adr, address, target);
+                }
+            }
+        }
+
+        std::vector<reference<TSymbolName>> new_references;
+        for (const auto& ref : references)
+        {
+            auto is_constant = is_pc_relative(ref.type);
+            ref.value.for_each_symbol([&](const symbol<TSymbolName>& s) { is_constant = is_constant && constants.contains(s); });
+            if (auto value = try_get_value(ref.value, origin); is_constant && value)
+            {
+                auto target = static_cast<address_t>(*value) - origin;
+                if (target <= current_lc())
+                {
+                    bind(ref.type, ref.fixup_location, target);
+                    continue;
+                }
+            }
+            new_references.emplace_back(ref.type, ref.fixup_location, ref.value);
+        }
+        references.swap(new_references);
+    }
+
+    void apply_layout(const layout& l, const std::vector<edit>& edits)
+    {
+        if (layout_only_source)
+        {
+            layout_only_size = l.size();
+        }
+        else
+        {
+            data = l.apply(data, edits);
+        }
+
+        for (auto& entry : symbols)
+        {
+            auto& definition = entry.second;
+            definition = symbol_definition{ l.map_symbol(definition.address, definition.alignment_count), l.map_alignment_count(definition.alignment_count) };
+        }
+
+        std::vector<reference<TSymbolName>> new_references;
+        for (const auto& ref : references)
+        {
+            if (auto fixup_location = l.map_location(ref.fixup_location))
+            {
+                new_references.emplace_back(ref.type, *fixup_location, ref.value);
+            }
+        }
+        references.swap(new_references);
+
+        for (auto& label : local_labels)
+        {
+            if (label)
+            {
+                label = symbol_definition{ l.map_symbol(label->address, label->alignment_count), l.map_alignment_count(label->alignment_count) };
+            }
+        }
+
+        std::vector<local_reference> new_local_references;
+        for (const auto& ref : local_references)
+        {
+            if (auto fixup_location = l.map_location(ref.fixup_location))
+            {
+                new_local_references.emplace_back(ref.type, *fixup_location, ref.label);
+            }
+        }
+        local_references.swap(new_local_references);
+
+        std::vector<reference_to_literal> new_literal_references;
+        for (const auto& ref : literal_references)
+        {
+            if (auto fixup_location = l.map_location(ref.fixup_location))
+            {
+                new_literal_references.emplace_back(*fixup_location, ref.name);
+            }
+        }
+        literal_references.swap(new_literal_references);
+
+        constexpr auto removed = std::numeric_limits<size_t>::max();
+        std::vector<size_t> new_entry_indices(pool_entries.size(), removed);
+        std::vector<pool_entry<TSymbolName>> new_pool_entries;
+        for (size_t i = 0; i < pool_entries.size(); ++i)
+        {
+            const auto& entry = pool_entries[i];
+            auto address = l.map_location(entry.address);
+            auto alignment_index = l.map_alignment_index(entry.alignment_index);
+            if (address && alignment_index)
+            {
+                new_entry_indices[i] = new_pool_entries.size();
+                new_pool_entries.emplace_back(entry.value, *address, *alignment_index);
+            }
+        }
+        pool_entries.swap(new_pool_entries);
+
+        std::vector<literal_load> new_literal_loads;
+        for (const auto& load : literal_loads)
+        {
+            if (auto fixup_location = l.map_location(load.fixup_location))
+            {
+                assert(new_entry_indices[load.entry] != removed);
+                new_literal_loads.emplace_back(*fixup_location, new_entry_indices[load.entry]);
+            }
+        }
+        literal_loads.swap(new_literal_loads);
+
+        std::vector<switch_table<TSymbolName>> new_switch_tables;
+        for (const auto& table : switch_tables)
+        {
+            if (auto address = l.map_location(table.table))
+            {
+                new_switch_tables.emplace_back(table.type, *address, table.targets);
+            }
+        }
+        switch_tables.swap(new_switch_tables);
+
+        std::vector<address_t> new_instructions;
+        for (auto address : instructions)
+        {
+            if (auto new_address = l.map_location(address))
+            {
+                new_instructions.push_back(*new_address);
+            }
+        }
+        instructions.swap(new_instructions);
+
+        std::vector<address_t> new_lengthenable_branches;
+        for (auto address : lengthenable_branches)
+        {
+            if (auto new_address = l.map_location(address))
+            {
+                new_lengthenable_branches.push_back(*new_address);
+            }
+        }
+        lengthenable_branches.swap(new_lengthenable_branches);
+
+        alignments = l.map_alignments(alignments);
+
+        // The distance between literal loads and their pool entries may have changed.
+        for (const auto& load : literal_loads)
+        {
+            fix_literal_load(load);
+        }
+    }
+
+    void insert_code_alignment(address_t address, address_t alignment)
+    {
+        // Search backwards for an unconditional branch, but not beyond the previous alignment
+        // directive, whose padding would change when code in between moves.
+        auto index = static_cast<size_t>(std::distance(
+            alignments.begin(),
+            std::upper_bound(
+                alignments.begin(), alignments.end(), address,
+                [](address_t a, const alignment_record& r) { return a < r.location; })));
+        address_t limit = 0;
+        if (index > 0)
+        {
+            const auto& previous = alignments[index - 1];
+            limit = previous.location + previous.padding + previous.distance;
+        }
+
+        auto location = address;
+        auto i = std::lower_bound(instructions.begin(), instructions.end(), address);
+        while ((i != instructions.begin()) && (*(i - 1) >= limit))
+        {
+            --i;
+            if (is_unconditional_transfer(peek16(*i)))
+            {
+                location = *i + 2;
+                break;
+            }
+        }
+
+        // Everything defined at or after the location now comes after the new alignment directive.
+        auto shift = [&](symbol_definition& definition)
+        {
+            if ((definition.address > location) || ((definition.address == location) && (definition.alignment_count >= index)))
+            {
+                ++definition.alignment_count;
+            }
+        };
+        for (auto& entry : symbols)
+        {
+            shift(entry.second);
+        }
+        for (auto& label : local_labels)
+        {
+            if (label)
+            {
+                shift(*label);
+            }
+        }
+        std::vector<pool_entry<TSymbolName>> new_pool_entries;
+        for (const auto& entry : pool_entries)
+        {
+            new_pool_entries.emplace_back(entry.value, entry.address, entry.alignment_index + (entry.alignment_index >= index));
+        }
+        pool_entries.swap(new_pool_entries);
+
+        // The directive starts without padding, the layout then computes the padding needed.
+        alignments.emplace(alignments.begin() + index, location, alignment, 0, address - location, padding_fill::nop);
+        relayout({});
+    }
+
+    void align_hot_loops(address_t alignment, address_t origin)
+    {
+        if (alignment > max_alignment)
+        {
+            report(origin, "Alignment out of range");
+            return;
+        }
+
+        for (const auto& loop : hot_loops)
+        {
+            auto address = symbols.at(loop).address;
+            auto is_backward_branch_target = std::any_of(
+                references.begin(), references.end(),
+                [&](const reference<TSymbolName>& ref)
+                {
+                    return ((ref.type == reference_type::conditional_branch) || (ref.type == reference_type::unconditional_branch)) &&
+                        (ref.fixup_location >= address) && ref.value.is_symbol_reference() && (ref.value.sym() == loop);
+                });
+            if (is_backward_branch_target)
+            {
+                insert_code_alignment(address, alignment);
+            }
+        }
+    }
+
+    // Replaces conditional branches marked by add_lengthenable_branch() whose target is out of range by
+    //     b<!cond> skip
+    //     b target
+    // skip:
+    // Lengthening branches moves code, which may push more branches out of range, so this is repeated.
+    // Since every branch is lengthened at most once, this terminates.
+    void lengthen_branches(address_t origin)
+    {
+        const auto& conditional_branch = reference_type_descriptors::get<reference_type::conditional_branch>();
+        std::sort(lengthenable_branches.begin(), lengthenable_branches.end());
+        while (true)
+        {
+            std::vector<edit> edits;
+            std::vector<immediate<TSymbolName>> targets;
+            for (auto address : lengthenable_branches)
+            {
+                auto ref = std::find_if(
+                    references.begin(), references.end(),
+                    [&](const auto& r) { return (r.fixup_location == address) && (r.type == reference_type::conditional_branch); });
+                if (ref == references.end())
+                {
+                    continue;
+                }
+
+                auto value = try_get_value(ref->value, origin);
+                if (value && !reaches(*value, address, origin, conditional_branch))
+                {
+                    // The inverted branch has an offset of zero, which skips the unconditional branch.
+                    // A layout-only copy only needs the size of the replacement.
+                    bytevector replacement(4, 0);
+                    if (!layout_only_source)
+                    {
+                        auto inverted_condition = ((peek16(address) >> 8) & 15) ^ 1;
+                        set16(replacement, 0, (0b1101 << 12) | (inverted_condition << 8));
+                        set16(replacement, 2, 0b11100 << 11);
+                    }
+                    edits.emplace_back(address, 2, std::move(replacement));
+                    targets.push_back(ref->value);
+                }
+            }
+
+            if (edits.empty())
+            {
+                return;
+            }
+
+            layout l(current_lc(), alignments, edits, {});
+            apply_layout(l, edits);
+            for (size_t i = 0; i < edits.size(); ++i)
+            {
+                auto address = l.replacement_address(i);
+                references.emplace_back(reference_type::unconditional_branch, address + 2, targets[i]);
+                for (auto instruction : { address, address + 2 })
+                {
+                    instructions.insert(std::lower_bound(instructions.begin(), instructions.end(), instruction), instruction);
+                }
+            }
+        }
+    }
+
+    void relax_literal_loads(address_t origin, literal_relaxation relaxation)
+    {
+        if ((relaxation == literal_relaxation::none) || literal_loads.empty())
+        {
+            return;
+        }
+
+        // Replacements are chosen based on the current layout, but replacing loads and
+        // removing pool entries moves code and symbols around. So we verify the choices
+        // against the new layout. Loads whose replacement turns out to be invalid are
+        // excluded and we start over. Since loads can only ever be excluded, this terminates.
+        std::vector<bool> excluded(literal_loads.size(), false);
+
+        // Unlike ldr, the mov based sequences set the flags. Loads after which the flags may still
+        // be read are only replaced by adr.
+        std::vector<literal_relaxation> load_relaxations(literal_loads.size(), relaxation);
+        if (relaxation == literal_relaxation::all)
+        {
+            auto fixups = get_fixup_locations();
+            auto targets = get_branch_targets(origin);
+            for (size_t i = 0; i < literal_loads.size(); ++i)
+            {
+                auto instruction = std::lower_bound(instructions.begin(), instructions.end(), literal_loads[i].fixup_location);
+                if ((instruction == instructions.end()) || (*instruction != literal_loads[i].fixup_location) ||
+                    !are_flags_dead(instruction - instructions.begin(), all_flags, fixups, targets, true))
+                {
+                    load_relaxations[i] = literal_relaxation::flag_preserving;
+                }
+            }
+        }
+
+        while (true)
+        {
+            std::vector<std::optional<literal_replacement>> replacements(literal_loads.size());
+            std::vector<size_t> unrelaxed_loads(pool_entries.size(), 0);
+            for (size_t i = 0; i < literal_loads.size(); ++i)
+            {
+                const auto& load = literal_loads[i];
+                if (auto value = try_get_value(pool_entries[load.entry].value, origin); !excluded[i] && value)
+                {
+                    replacements[i] = choose_literal_replacement(load_relaxations[i], *value, origin + load.fixup_location);
+                }
+
+                if (!replacements[i])
+                {
+                    ++unrelaxed_loads[load.entry];
+                }
+            }
+
+            // Replacing a load by a four byte sequence only pays off if it is
+            // the only one to do so and if the pool entry can then be removed.
+            std::vector<size_t> long_replacements(pool_entries.size(), 0);
+            for (size_t i = 0; i < literal_loads.size(); ++i)
+            {
+                if (replacements[i] && (replacements[i]->size > 2))
+                {
+                    ++long_replacements[literal_loads[i].entry];
+                }
+            }
+            for (size_t i = 0; i < literal_loads.size(); ++i)
+            {
+                auto entry = literal_loads[i].entry;
+                if (replacements[i] && (replacements[i]->size > 2) && (unrelaxed_loads[entry] || (long_replacements[entry] > 1)))
+                {
+                    replacements[i].reset();
+                    ++unrelaxed_loads[entry];
+                }
+            }
+
+            // Build edits, sorted by address. Loads always precede the pool they refer to.
+            std::vector<edit> edits;
+            std::vector<size_t> edit_to_load;
+            std::vector<size_t> removed_alignments;
+            std::vector<size_t> entries_per_pool(alignments.size(), 0);
+            std::vector<size_t> removed_entries_per_pool(alignments.size(), 0);
+            for (size_t i = 0; i < literal_loads.size(); ++i)
+            {
+                if (replacements[i])
+                {
+                    edits.emplace_back(literal_loads[i].fixup_location, 2, bytevector(replacements[i]->size, 0));
+                    edit_to_load.push_back(i);
+                }
+            }
+            for (const auto& entry : pool_entries)
+            {
+                ++entries_per_pool[entry.alignment_index];
+            }
+            for (size_t i = 0; i < pool_entries.size(); ++i)
+            {
+                if (unrelaxed_loads[i] == 0)
+                {
+                    edits.emplace_back(pool_entries[i].address, 4, bytevector());
+                    edit_to_load.push_back(literal_loads.size());
+                    ++removed_entries_per_pool[pool_entries[i].alignment_index];
+                }
+            }
+            for (size_t i = 0; i < alignments.size(); ++i)
+            {
+                if (entries_per_pool[i] && (entries_per_pool[i] == removed_entries_per_pool[i]))
+                {
+                    removed_alignments.push_back(i);
+                }
+            }
+
+            if (edits.empty())
+            {
+                return;
+            }
+
+            std::vector<size_t> order(edits.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return edits[a].address < edits[b].address; });
+            std::vector<edit> sorted_edits;
+            std::vector<size_t> sorted_edit_to_load;
+            for (auto i : order)
+            {
+                sorted_edits.push_back(edits[i]);
+                sorted_edit_to_load.push_back(edit_to_load[i]);
+            }
+
+            layout l(current_lc(), alignments, sorted_edits, removed_alignments);
+
+            // Verify replacements against the new layout and compute their opcodes.
+            bool all_valid = true;
+            for (size_t i = 0; i < sorted_edits.size(); ++i)
+            {
+                auto load_index = sorted_edit_to_load[i];
+                if (load_index == literal_loads.size())
+                {
+                    continue;
+                }
+
+                const auto& load = literal_loads[load_index];
+                auto rd = (peek16(load.fixup_location) >> 8) & 7;
+                auto address = origin + l.replacement_address(i);
+                auto value = try_get_value(pool_entries[load.entry].value, origin, &l);
+                auto replacement = value ? choose_literal_replacement(load_relaxations[load_index], *value, address) : std::nullopt;
+                if (!replacement || (replacement->size != replacements[load_index]->size))
+                {
+                    excluded[load_index] = true;
+                    all_valid = false;
+                    continue;
+                }
+
+                auto& bytes = sorted_edits[i].replacement;
+                if (replacement->is_adr)
+                {
+                    auto offset = static_cast<address_t>(*value) - clear_bit1(address + 4);
+                    set16(bytes, 0, (0b10100 << 11) | (rd << 8) | (offset / 4));
+                }
+                else
+                {
+                    address_t offset = 0;
+                    auto synthesis = synthesize_constant(static_cast<address_t>(*value), max_synthesis_instructions);
+                    for (const auto& step : *synthesis)
+                    {
+                        set16(bytes, offset, step.opcode(rd));
+                        offset += 2;
+                    }
+                }
+            }
+
+            // The edits also move code between other fixups and their targets. A fixup that
+            // no longer reaches its target excludes the replacements in between.
+            if (all_valid)
+            {
+                auto broken_fixups = find_broken_fixups(origin, l);
+                for (const auto& [from, to] : broken_fixups)
+                {
+                    for (size_t i = 0; i < sorted_edits.size(); ++i)
+                    {
+                        auto load_index = sorted_edit_to_load[i];
+                        auto address = sorted_edits[i].address;
+                        if ((load_index != literal_loads.size()) && (address >= std::min(from, to)) && (address <= std::max(from, to)))
+                        {
+                            excluded[load_index] = true;
+                            all_valid = false;
+                        }
+                    }
+                }
+
+                // A fixup can also break because of padding that changed elsewhere.
+                if (!broken_fixups.empty() && all_valid)
+                {
+                    for (auto load_index : sorted_edit_to_load)
+                    {
+                        if (load_index != literal_loads.size())
+                        {
+                            excluded[load_index] = true;
+                        }
+                    }
+                    all_valid = false;
+                }
+            }
+
+            if (all_valid)
+            {
+                apply_layout(l, sorted_edits);
+                return;
+            }
+        }
+    }
+
+    // Returns the pc-relative fixups that reach their targets in the current layout, but not in l.
+    // Each is returned as its fixup location and the address of its target in the current layout.
+    // Fixups that l removes are skipped.
+    std::vector<std::pair<address_t, address_t>> find_broken_fixups(address_t origin, const layout& l)
+    {
+        std::vector<std::pair<address_t, address_t>> broken_fixups;
+        auto check = [&](address_t fixup_location, immediate_t old_target, immediate_t new_target, const reference_type_descriptor& d)
+        {
+            auto new_fixup_location = l.map_location(fixup_location);
+            if (new_fixup_location &&
+                reaches(old_target, fixup_location, origin, d) &&
+                !reaches(new_target, *new_fixup_location, origin, d))
+            {
+                broken_fixups.emplace_back(fixup_location, static_cast<address_t>(old_target) - origin);
+            }
+        };
+
+        const auto& literal = reference_type_descriptors::get<reference_type::literal>();
+        for (const auto& load : literal_loads)
+        {
+            const auto& entry = pool_entries[load.entry];
+            if (auto address = l.map_location(entry.address))
+            {
+                check(load.fixup_location, origin + entry.address, origin + *address, literal);
+            }
+        }
+        for (const auto& ref : references)
+        {
+            if (is_pc_relative(ref.type))
+            {
+                auto value = try_get_value(ref.value, origin);
+                auto new_value = try_get_value(ref.value, origin, &l);
+                if (value && new_value)
+                {
+                    check(ref.fixup_location, *value, *new_value, reference_type_descriptors::get(ref.type));
+                }
+            }
+        }
+        for (const auto& ref : local_references)
+        {
+            if (const auto& label = local_labels[ref.label])
+            {
+                auto new_address = l.map_symbol(label->address, label->alignment_count);
+                check(ref.fixup_location, origin + label->address, origin + new_address, reference_type_descriptors::get(ref.type));
+            }
+        }
+        for (const auto& table : switch_tables)
+        {
+            const auto& d = reference_type_descriptors::get(table.type);
+            for (const auto& target : table.targets)
+            {
+                auto value = try_get_value(target, origin);
+                auto new_value = try_get_value(target, origin, &l);
+                if (value && new_value)
+                {
+                    // The table is relative to the add pc instruction directly in front of it.
+                    check(table.table - 2, *value, *new_value, d);
+                }
+            }
+        }
+        return broken_fixups;
+    }
+
+    // Whether a pc-relative fixup at fixup_location can encode the distance to target.
+    bool reaches(immediate_t target, address_t fixup_location, address_t origin, const reference_type_descriptor& d)
+    {
+        auto relative_address = static_cast<immediate_t>(get_relative_address(target, fixup_location, origin, d));
+        return (relative_address >= d.min) && (relative_address <= d.max) && ((relative_address & (get_byte_alignment(d.alignment) - 1)) == 0);
+    }
+
+    // Blocks are placed from the largest to the smallest, so that a block that is the end of
+    // a larger block can be merged with it. Merged blocks are aliases into the larger block.
+    void emit_mergeable_data()
+    {
+        std::vector<size_t> order(mergeable_blocks.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(
+            order.begin(), order.end(),
+            [&](size_t a, size_t b) { return mergeable_blocks[a].bytes.size() > mergeable_blocks[b].bytes.size(); });
+
+        std::vector<std::pair<size_t, address_t>> placed;
+        for (auto i : order)
+        {
+            const auto& block = mergeable_blocks[i];
+            auto merged = false;
+            for (const auto& [j, address] : placed)
+            {
+                if (auto offset = block.find_in(mergeable_blocks[j], [&](reference_type type) { return get_reference_size(type); }))
+                {
+                    symbols.emplace(block.name, symbol_definition{ address + *offset, alignments.size() });
+                    merged = true;
+                    break;
+                }
+            }
+            if (merged)
+            {
+                continue;
+            }
+
+            if (block.alignment)
+            {
+                align(block.alignment);
+            }
+            placed.emplace_back(i, current_lc());
+            add_symbol(block.name);
+            for (const auto& ref : block.references)
+            {
+                references.emplace_back(ref.type, current_lc() + ref.fixup_location, ref.value);
+            }
+            if (layout_only_source)
+            {
+                layout_only_size += static_cast<address_t>(block.bytes.size());
+            }
+            else
+            {
+                data.insert(data.end(), block.bytes.begin(), block.bytes.end());
+            }
+        }
+
+        mergeable_blocks.clear();
+    }
+
+    // Removes the code and data that cannot be reached from the entry points.
+    // The object is split into ranges at symbols and literal pools. A range is reachable if
+    // a reachable range refers to it, through a reference, a literal load, a switch table or
+    // by falling through into it. Code in front of the first symbol is always kept.
+    void strip_unreachable(address_t origin)
+    {
+        if (entry_points.empty())
+        {
+            report(origin, "No entry point for dead code stripping");
+            return;
+        }
+        std::vector<address_t> entry_addresses;
+        for (const auto& entry_point : entry_points)
+        {
+            auto value = find_symbol_value(entry_point, 0);
+            if (!value)
+            {
+                report(origin, "Undefined symbol");
+                return;
+            }
+            entry_addresses.push_back(static_cast<address_t>(*value));
+        }
+
+        // A symbol directly following alignment padding owns the padding.
+        std::vector<address_t> boundaries{ 0 };
+        for (const auto& [name, definition] : symbols)
+        {
+            auto start = definition.address;
+            if (definition.alignment_count > 0)
+            {
+                const auto& a = alignments[definition.alignment_count - 1];
+                if (a.location + a.padding == start)
+                {
+                    start = a.location;
+                }
+            }
+            boundaries.push_back(start);
+        }
+        for (const auto& entry : pool_entries)
+        {
+            boundaries.push_back(alignments[entry.alignment_index].location);
+        }
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+        auto range_end = [&](size_t i) { return i + 1 < boundaries.size() ? boundaries[i + 1] : current_lc(); };
+        auto range_of = [&](address_t address) -> size_t { return std::upper_bound(boundaries.begin(), boundaries.end(), address) - boundaries.begin() - 1; };
+
+        std::vector<std::vector<size_t>> successors(boundaries.size());
+        auto add_edge = [&](address_t from, address_t to)
+        {
+            if (to < current_lc())
+            {
+                successors[range_of(from)].push_back(range_of(to));
+            }
+        };
+        for (const auto& ref : references)
+        {
+            ref.value.for_each_symbol(
+                [&](const auto& s)
+                {
+                    if (auto definition = symbols.find(s); definition != symbols.end())
+                    {
+                        add_edge(ref.fixup_location, definition->second.address);
+                    }
+                });
+            if (auto value = try_get_value(ref.value, origin); !ref.value.is_symbol_reference() && is_pc_relative(ref.type) && value)
+            {
+                add_edge(ref.fixup_location, static_cast<address_t>(*value) - origin);
+            }
+        }
+        for (const auto& ref : local_references)
+        {
+            if (const auto& label = local_labels[ref.label])
+            {
+                add_edge(ref.fixup_location, label->address);
+            }
+        }
+        for (const auto& load : literal_loads)
+        {
+            add_edge(load.fixup_location, pool_entries[load.entry].address);
+        }
+        for (const auto& table : switch_tables)
+        {
+            for (const auto& target : table.targets)
+            {
+                if (auto value = try_get_value(target, origin))
+                {
+                    add_edge(table.table, static_cast<address_t>(*value) - origin);
+                }
+            }
+        }
+        for (size_t i = 0; i + 1 < boundaries.size(); ++i)
+        {
+            if (falls_through(boundaries[i], range_end(i)))
+            {
+                successors[i].push_back(i + 1);
+            }
+        }
+
+        std::vector<size_t> roots{ 0 };
+        for (auto address : entry_addresses)
+        {
+            roots.push_back(range_of(address));
+        }
+        auto reachable = find_reachable(successors, roots);
+
+        // Padding at the start of a removed range is removed with its alignment directive.
+        std::vector<edit> edits;
+        std::vector<size_t> removed_alignments;
+        for (size_t i = 0; i < boundaries.size(); ++i)
+        {
+            if (reachable[i])
+            {
+                continue;
+            }
+
+            auto start = boundaries[i];
+            for (size_t a = 0; a < alignments.size(); ++a)
+            {
+                if (alignments[a].location == start)
+                {
+                    removed_alignments.push_back(a);
+                    start += alignments[a].padding;
+                }
+            }
+            if (range_end(i) > start)
+            {
+                edits.emplace_back(start, range_end(i) - start, bytevector());
+            }
+
+            for (const auto& [name, definition] : symbols)
+            {
+                if (range_of(definition.address) == i)
+                {
+                    ++stripping.removed_symbols;
+                }
+            }
+        }
+
+        auto old_size = current_lc();
+        relayout(edits, removed_alignments);
+        stripping.saved_bytes = old_size - current_lc();
+    }
+
+    // Replaces routines that are identical to an earlier one by an alias of the earlier one.
+    // Routines are compared by their bytes and by what their fixups resolve to, so that
+    // pc-relative references and literal loads are equal if they reach the same targets.
+    // Folding is repeated until nothing changes, since routines that call folded copies
+    // may have become identical too. A routine the code in front of it falls into is never removed.
+    void fold_identical_code(address_t origin)
+    {
+        auto old_size = current_lc();
+        for (;;)
+        {
+            auto routines = get_foldable_routines(origin);
+
+            std::map<uint64_t, std::vector<size_t>> kept;
+            std::vector<edit> edits;
+            std::vector<std::pair<symbol<TSymbolName>, symbol<TSymbolName>>> aliases;
+            for (size_t i = 0; i < routines.size(); ++i)
+            {
+                auto& candidates = kept[routines[i].key.hash()];
+                auto original = std::find_if(candidates.begin(), candidates.end(), [&](size_t k) { return routines[k].key == routines[i].key; });
+                if (original == candidates.end())
+                {
+                    candidates.push_back(i);
+                    continue;
+                }
+                if (is_fallen_into(routines[i].start))
+                {
+                    continue;
+                }
+
+                edits.emplace_back(routines[i].start, routines[i].end - routines[i].start, bytevector());
+                auto target = std::find_if(symbols.begin(), symbols.end(), [&](const auto& entry) { return entry.second.address == routines[*original].start; });
+                for (const auto& entry : symbols)
+                {
+                    if (entry.second.address == routines[i].start)
+                    {
+                        aliases.emplace_back(entry.first, target->first);
+                    }
+                }
+            }
+
+            if (edits.empty())
+            {
+                break;
+            }
+
+            relayout(edits);
+            for (const auto& [alias, target] : aliases)
+            {
+                symbols.insert_or_assign(alias, symbols.at(target));
+            }
+            folding.folded_routines += edits.size();
+        }
+
+        folding.saved_bytes = old_size - current_lc();
+    }
+
+    // Whether execution reaches address by running off the end of the code in front of it.
+    // Alignment padding in front of address is skipped.
+    bool is_fallen_into(address_t address) const
+    {
+        for (auto a = alignments.rbegin(); a != alignments.rend(); ++a)
+        {
+            if ((a->padding > 0) && (a->location + a->padding == address))
+            {
+                address = a->location;
+            }
+        }
+        return falls_through(0, address);
+    }
+
+    // Whether execution continues at end after the code from begin to end.
+    // Ranges ending with data or with an unconditional transfer do not fall through.
+    bool falls_through(address_t begin, address_t end) const
+    {
+        auto is_instruction = [&](address_t address) { return std::binary_search(instructions.begin(), instructions.end(), address); };
+        auto ends_with_instruction = (end - begin >= 2) && is_instruction(end - 2);
+        auto ends_with_bl = (end - begin >= 4) && is_instruction(end - 4) && ((peek16(end - 4) >> 11) == 0b11110);
+        return (ends_with_instruction && !is_unconditional_transfer(peek16(end - 2))) || ends_with_bl;
+    }
+
+    // A routine starts at a symbol and ends at the next symbol or alignment directive.
+    std::vector<foldable_routine> get_foldable_routines(address_t origin)
+    {
+        std::vector<address_t> boundaries;
+        for (const auto& entry : symbols)
+        {
+            boundaries.push_back(entry.second.address);
+        }
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+        std::vector<foldable_routine> routines;
+        for (size_t i = 0; i < boundaries.size(); ++i)
+        {
+            auto start = boundaries[i];
+            auto end = (i + 1 < boundaries.size()) ? boundaries[i + 1] : current_lc();
+            for (const auto& a : alignments)
+            {
+                if (a.location >= start)
+                {
+                    end = std::min(end, a.location);
+                }
+            }
+
+            if (auto key = get_folding_key(start, end, origin))
+            {
+                routines.push_back(foldable_routine{ start, end, std::move(*key) });
+            }
+        }
+        return routines;
+    }
+
+    // Returns nothing if the routine cannot be folded. A routine that can be folded ends with an
+    // unconditional transfer, is only entered at its start and contains no data other code refers to.
+    std::optional<folding_key> get_folding_key(address_t start, address_t end, address_t origin)
+    {
+        auto inside = [&](address_t address) { return (address >= start) && (address < end); };
+
+        if ((end - start < 2) ||
+            !std::binary_search(instructions.begin(), instructions.end(), end - 2) ||
+            !is_unconditional_transfer(peek16(end - 2)))
+        {
+            return std::nullopt;
+        }
+
+        if (std::any_of(pool_entries.begin(), pool_entries.end(), [&](const auto& entry) { return inside(entry.address); }) ||
+            std::any_of(switch_tables.begin(), switch_tables.end(), [&](const auto& table) { return inside(table.table - table.dispatch_size) || inside(table.table); }))
+        {
+            return std::nullopt;
+        }
+
+        for (const auto& ref : references)
+        {
+            // Nothing is folded in a program that does not link. This also covers the pool entries.
+            auto value = try_get_value(ref.value, origin);
+            if (!value || (is_pc_relative(ref.type) && !ref.value.is_symbol_reference() && inside(static_cast<address_t>(*value) - origin)))
+            {
+                return std::nullopt;
+            }
+        }
+        for (const auto& ref : local_references)
+        {
+            const auto& label = local_labels[ref.label];
+            if (label && !inside(ref.fixup_location) && inside(label->address))
+            {
+                return std::nullopt;
+            }
+        }
+
+        folding_key key;
+        key.bytes.assign(data.begin() + start, data.begin() + end);
+        for (auto address : instructions)
+        {
+            if (inside(address))
+            {
+                key.instructions.push_back(address - start);
+            }
+        }
+        std::sort(key.instructions.begin(), key.instructions.end());
+
+        auto add_fixup = [&](address_t fixup_location, reference_type type, immediate_t value, bool may_be_internal)
+        {
+            auto address = static_cast<address_t>(value) - origin;
+            if (may_be_internal && inside(address))
+            {
+                key.fixups.push_back(folding_fixup{ fixup_location - start, type, true, static_cast<immediate_t>(address - start) });
+            }
+            else
+            {
+                key.fixups.push_back(folding_fixup{ fixup_location - start, type, false, value });
+            }
+        };
+        for (const auto& ref : references)
+        {
+            if (inside(ref.fixup_location))
+            {
+                add_fixup(ref.fixup_location, ref.type, *try_get_value(ref.value, origin), ref.value.is_symbol_reference());
+            }
+        }
+        for (const auto& ref : local_references)
+        {
+            const auto& label = local_labels[ref.label];
+            if (inside(ref.fixup_location) && label)
+            {
+                add_fixup(ref.fixup_location, ref.type, static_cast<immediate_t>(origin + label->address), true);
+            }
+        }
+        for (const auto& load : literal_loads)
+        {
+            if (inside(load.fixup_location))
+            {
+                key.bytes[load.fixup_location - start] = 0;
+                add_fixup(load.fixup_location, reference_type::literal, *try_get_value(pool_entries[load.entry].value, origin), false);
+            }
+        }
+        std::stable_sort(key.fixups.begin(), key.fixups.end(), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+
+        return key;
+    }
+
+    // switch_table emits halfword tables. Tables whose offsets all fit into bytes are converted to byte tables,
+    // which take the same dispatch code size. Like literal relaxation, the choice is verified against the new
+    // layout, and tables that no longer fit are excluded before starting over.
+    void shrink_switch_tables(address_t origin)
+    {
+        std::vector<bool> excluded(switch_tables.size(), false);
+        while (true)
+        {
+            auto fits = [&](const switch_table<TSymbolName>& table, address_t address, auto get_target)
+            {
+                const auto& d = reference_type_descriptors::get(reference_type::switch_offset8);
+                return std::all_of(
+                    table.targets.begin(), table.targets.end(),
+                    [&](const immediate<TSymbolName>& target)
+                    {
+                        auto value = get_target(target);
+                        if (!value)
+                        {
+                            return false;
+                        }
+
+                        auto offset = static_cast<immediate_t>(get_relative_address(*value, address - 2, origin, d));
+                        return (offset >= d.min) && (offset <= d.max) && !(offset & 1);
+                    });
+            };
+
+            // A table with a single entry would need a padding byte, and save nothing.
+            std::vector<size_t> shrunk;
+            std::vector<edit> edits;
+            for (size_t i = 0; i < switch_tables.size(); ++i)
+            {
+                const auto& table = switch_tables[i];
+                auto count = static_cast<address_t>(table.targets.size());
+                if ((table.type == reference_type::switch_offset16) && (count > 1) && !excluded[i] &&
+                    fits(table, table.table, [&](const immediate<TSymbolName>& target) { return try_get_value(target, origin); }))
+                {
+                    bytevector dispatch(table.dispatch_size);
+                    if (!layout_only_source)
+                    {
+                        auto rx = peek16(table.table - table.dispatch_size) & 7;
+                        set16(dispatch, 0, 0x4478 | rx);                    // add rx, pc
+                        set16(dispatch, 2, 0x7900 | (rx << 3) | rx);        // ldrb rx, [rx, #4]
+                        set16(dispatch, 4, 0x0040 | (rx << 3) | rx);        // lsl rx, rx, #1
+                        set16(dispatch, 6, 0x4487 | (rx << 3));             // add pc, rx
+                    }
+                    edits.emplace_back(table.table - table.dispatch_size, table.dispatch_size, dispatch);
+                    edits.emplace_back(table.table, 2 * count, bytevector(count + count % 2, 0));
+                    shrunk.push_back(i);
+                }
+            }
+
+            if (shrunk.empty())
+            {
+                return;
+            }
+
+            layout l(current_lc(), alignments, edits, {});
+            bool all_valid = true;
+            for (size_t k = 0; k < shrunk.size(); ++k)
+            {
+                const auto& table = switch_tables[shrunk[k]];
+                if (!fits(table, l.replacement_address(2 * k + 1), [&](const immediate<TSymbolName>& target) { return try_get_value(target, origin, &l); }))
+                {
+                    excluded[shrunk[k]] = true;
+                    all_valid = false;
+                }
+            }
+
+            if (all_valid)
+            {
+                std::vector<switch_table<TSymbolName>> byte_tables;
+                for (size_t k = 0; k < shrunk.size(); ++k)
+                {
+                    byte_tables.emplace_back(reference_type::switch_offset8, l.replacement_address(2 * k + 1), switch_tables[shrunk[k]].targets);
+                }
+
+                apply_layout(l, edits);
+
+                // apply_layout() dropped the replaced tables and dispatch instructions.
+                std::vector<switch_table<TSymbolName>> merged;
+                auto p = switch_tables.begin();
+                for (const auto& table : byte_tables)
+                {
+                    for (; (p != switch_tables.end()) && (p->table < table.table); ++p)
+                    {
+                        merged.push_back(*p);
+                    }
+                    merged.push_back(table);
+                    for (auto address = table.table - table.dispatch_size; address < table.table; address += 2)
+                    {
+                        instructions.insert(std::lower_bound(instructions.begin(), instructions.end(), address), address);
+                    }
+                }
+                for (; p != switch_tables.end(); ++p)
+                {
+                    merged.push_back(*p);
+                }
+                switch_tables.swap(merged);
+                return;
+            }
+        }
+    }
+
+    // Removes redundant Thumb instructions. Every round works on the current layout,
+    // since removing an instruction can make others redundant, e.g. a branch to the next instruction.
+    void remove_redundant_instructions(address_t origin)
+    {
+        while (true)
+        {
+            auto removals = find_redundant_instructions(origin);
+            if (removals.empty())
+            {
+                return;
+            }
+
+            std::vector<edit> edits;
+            for (auto i : removals)
+            {
+                ++peephole.removed_instructions;
+                peephole.saved_bytes += 2;
+                peephole.saved_cycles += get_removed_instruction_cycles(peek16(instructions[i]));
+                edits.emplace_back(instructions[i], 2, bytevector());
+            }
+
+            relayout(edits);
+        }
+    }
+
+    // Returns the indices of removable instructions, in ascending order.
+    // Instructions are only matched by their opcodes if their operands are known, that is, if they have no fixup.
+    std::vector<size_t> find_redundant_instructions(address_t origin)
+    {
+        auto fixups = get_fixup_locations();
+        auto labels = get_label_addresses(origin);
+        auto targets = get_branch_targets(origin);
+        auto contains = [](const std::vector<address_t>& v, address_t address) { return std::binary_search(v.begin(), v.end(), address); };
+
+        std::vector<size_t> removals;
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            auto address = instructions[i];
+            auto opcode = peek16(address);
+            auto info = decode_thumb_instruction(opcode);
+            auto next = address + info.size;
+            auto is_contiguous = (i + 1 < instructions.size()) && (instructions[i + 1] == next);
+
+            if ((info.flow == thumb_flow::conditional_branch) || (info.flow == thumb_flow::unconditional_branch))
+            {
+                // Branch to the next instruction
+                auto target = targets.find(address);
+                if ((target != targets.end()) && (target->second == next))
+                {
+                    removals.push_back(i);
+                }
+            }
+            else if (contains(fixups, address))
+            {
+                continue;
+            }
+            else if (auto flags = get_no_op_flags(opcode))
+            {
+                if (are_flags_dead(i, *flags, fixups, targets))
+                {
+                    removals.push_back(i);
+                }
+            }
+            else if (auto rn = get_cmp_zero_register(opcode))
+            {
+                // cmp rn, #0 after an instruction that has already set N and Z according to rn.
+                // The previous instruction must not be removed in the same round.
+                if ((i > 0) && (instructions[i - 1] + 2 == address) && !contains(labels, address) &&
+                    (removals.empty() || (removals.back() != i - 1)) &&
+                    (get_nz_result_register(peek16(instructions[i - 1])) == rn) &&
+                    are_flags_dead(i, flag_c | flag_v, fixups, targets))
+                {
+                    removals.push_back(i);
+                }
+            }
+            else if (is_push_without_lr(opcode) && is_contiguous && (peek16(next) == (opcode | 0x0800)) && !contains(labels, next) && !contains(fixups, next))
+            {
+                // push {list} immediately followed by pop {list}
+                removals.push_back(i);
+                removals.push_back(++i);
+            }
+        }
+
+        return removals;
+    }
+
+    // Returns true if the given flags are written before they are read on all paths following an instruction.
+    // Paths leaving the known instructions, e.g. through calls, returns or data, are considered to read all flags.
+    // With calls_clobber_flags, calls and returns are instead assumed to leave the flags undefined, as the
+    // procedure call standard allows.
+    bool are_flags_dead(size_t index, unsigned flags, const std::vector<address_t>& fixups, const std::map<address_t, address_t>& targets, bool calls_clobber_flags = false) const
+    {
+        std::vector<unsigned> visited(instructions.size(), 0);
+        std::vector<std::pair<size_t, unsigned>> pending;
+        auto add_successor = [&](address_t address, unsigned live)
+        {
+            auto i = std::lower_bound(instructions.begin(), instructions.end(), address);
+            if ((i == instructions.end()) || (*i != address))
+            {
+                return false;
+            }
+            pending.emplace_back(i - instructions.begin(), live);
+            return true;
+        };
+
+        if (flags && !add_successor(instructions[index] + decode_thumb_instruction(peek16(instructions[index])).size, flags))
+        {
+            return false;
+        }
+
+        while (!pending.empty())
+        {
+            auto [i, live] = pending.back();
+            pending.pop_back();
+            live &= ~visited[i];
+            if (!live)
+            {
+                continue;
+            }
+            visited[i] |= live;
+
+            auto address = instructions[i];
+            if (calls_clobber_flags && is_call_or_return(peek16(address)))
+            {
+                continue;
+            }
+
+            auto info = get_instruction_info(i, fixups);
+            if ((info.reads & live) || (info.flow == thumb_flow::unknown))
+            {
+                return false;
+            }
+
+            live &= ~info.writes;
+            if (!live)
+            {
+                continue;
+            }
+
+            if ((info.flow != thumb_flow::unconditional_branch) && !add_successor(address + info.size, live))
+            {
+                return false;
+            }
+
+            if (info.flow != thumb_flow::next)
+            {
+                auto target = targets.find(address);
+                if ((target == targets.end()) || !add_successor(target->second, live))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // bl, bx lr and pop {..., pc}.
+    static constexpr bool is_call_or_return(uint_fast16_t opcode)
+    {
+        return ((opcode >> 11) == 0b11110) || (opcode == bx_lr_opcode) || ((opcode & 0xff00) == 0xbd00);
+    }
+
+    thumb_instruction_info get_instruction_info(size_t index, const std::vector<address_t>& fixups) const
+    {
+        auto address = instructions[index];
+        auto opcode = peek16(address);
+        auto info = decode_thumb_instruction(opcode);
+
+        // A shift by a symbol may become lsl #0 at link time, which does not modify C.
+        if (((opcode >> 13) == 0b000) && std::binary_search(fixups.begin(), fixups.end(), address))
+        {
+            info.writes &= flag_n | flag_z;
+        }
+
+        return info;
+    }
+
+    // Reorders straight-line code between labels and branches to hide load-use interlocks.
+    // Only instruction bytes move, instructions with fixups and instructions reading pc stay where they are.
+    void schedule_loads(address_t origin)
+    {
+        auto fixups = get_fixup_locations();
+        auto labels = get_label_addresses(origin);
+        auto targets = get_branch_targets(origin);
+        auto contains = [](const std::vector<address_t>& v, address_t address) { return std::binary_search(v.begin(), v.end(), address); };
+
+        size_t begin = 0;
+        while (begin < instructions.size())
+        {
+            std::vector<schedulable_instruction> region;
+            auto end = begin;
+            while (end < instructions.size())
+            {
+                auto info = get_instruction_info(end, fixups);
+                auto continues_region = (end == begin) || ((instructions[end] == instructions[end - 1] + 2) && !contains(labels, instructions[end]));
+                if ((info.flow != thumb_flow::next) || !continues_region)
+                {
+                    break;
+                }
+
+                auto pinned = contains(fixups, instructions[end]) || (info.uses & pc_mask);
+                region.push_back({ peek16(instructions[end]), info, pinned });
+                ++end;
+            }
+
+            if (region.size() < 2)
+            {
+                begin = std::max(end, begin + 1);
+                continue;
+            }
+
+            // The instruction after the region executes next, unless the region ends in data.
+            uint_fast16_t successor_uses = 0;
+            if ((end < instructions.size()) && (instructions[end] == instructions[end - 1] + 2))
+            {
+                successor_uses = get_instruction_info(end, fixups).uses;
+            }
+
+            unsigned live_out_flags = 0;
+            for (auto flag : { flag_n, flag_z, flag_c, flag_v })
+            {
+                if (!are_flags_dead(end - 1, flag, fixups, targets))
+                {
+                    live_out_flags |= flag;
+                }
+            }
+
+            load_use_scheduler scheduler(region, successor_uses, live_out_flags);
+            scheduling.saved_cycles += scheduler.schedule();
+            for (size_t i = 0; i < region.size(); ++i)
+            {
+                auto opcode = scheduler.instructions()[i].opcode;
+                if (opcode != region[i].opcode)
+                {
+                    ++scheduling.moved_instructions;
+                    poke16(instructions[begin + i], opcode);
+                }
+            }
+
+            begin = end;
+        }
+    }
+
+    std::vector<address_t> get_fixup_locations() const
+    {
+        std::vector<address_t> result;
+        for (const auto& ref : references)
+        {
+            result.push_back(ref.fixup_location);
+        }
+        for (const auto& ref : local_references)
+        {
+            result.push_back(ref.fixup_location);
+        }
+        for (const auto& load : literal_loads)
+        {
+            result.push_back(load.fixup_location);
+        }
+        for (const auto& table : switch_tables)
+        {
+            // The dispatch code reads pc, so none of it may move.
+            for (auto address = table.table - table.dispatch_size; address < table.table; address += 2)
+            {
+                result.push_back(address);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Addresses code can be entered at: symbols, local labels and numeric branch targets.
+    std::vector<address_t> get_label_addresses(address_t origin) const
+    {
+        std::vector<address_t> result;
+        for (const auto& entry : symbols)
+        {
+            result.push_back(entry.second.address);
+        }
+        for (const auto& label : local_labels)
+        {
+            if (label)
+            {
+                result.push_back(label->address);
+            }
+        }
+        for (const auto& ref : references)
+        {
+            if (ref.value.is_symbol_reference())
+            {
+                continue;
+            }
+            if (auto value = try_get_value(ref.value, origin); value && (static_cast<address_t>(*value) >= origin))
+            {
+                result.push_back(static_cast<address_t>(*value) - origin);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Maps the locations of Thumb branches to their targets. Branches to undefined symbols are left out.
+    std::map<address_t, address_t> get_branch_targets(address_t origin) const
+    {
+        auto is_branch = [](reference_type type) { return (type == reference_type::conditional_branch) || (type == reference_type::unconditional_branch); };
+
+        std::map<address_t, address_t> result;
+        for (const auto& ref : references)
+        {
+            if (!is_branch(ref.type))
+            {
+                continue;
+            }
+
+            if (auto value = try_get_value(ref.value, origin); value && (static_cast<address_t>(*value) >= origin))
+            {
+                result.emplace(ref.fixup_location, static_cast<address_t>(*value) - origin);
+            }
+        }
+        for (const auto& ref : local_references)
+        {
+            if (is_branch(ref.type) && local_labels[ref.label])
+            {
+                result.emplace(ref.fixup_location, local_labels[ref.label]->address);
+            }
+        }
+        return result;
+    }
+
+    std::optional<literal_replacement> choose_literal_replacement(literal_relaxation relaxation, immediate_t value, address_t address)
+    {
+        // adr does not modify the flags, so prefer it.
+        auto target = static_cast<address_t>(value);
+        auto source = clear_bit1(address + 4);
+        if ((target >= source) && (target - source <= 0xff * 4) && ((target & 3) == 0))
+        {
+            return literal_replacement{ true, 2 };
+        }
+
+        if (relaxation == literal_relaxation::all)
+        {
+            if (auto synthesis = synthesize_constant(target, max_synthesis_instructions))
+            {
+                return literal_replacement{ false, synthesis->size() };
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    static constexpr bool is_pc_relative(reference_type type)
+    {
+        return (type == reference_type::adr) || (type == reference_type::arm_branch) || (type == reference_type::bl) ||
+            (type == reference_type::conditional_branch) || (type == reference_type::literal) || (type == reference_type::unconditional_branch);
+    }
+
+    static void set16(bytevector& bytes, address_t address, uint_fast16_t u16)
+    {
+        bytes[address + 0] = u16 & 255;
+        bytes[address + 1] = (u16 >> 8) & 255;
+    }
+
+    auto get_name_of_new_or_existing_literal(const immediate<TSymbolName>& imm)
+    {
+        auto iter = std::find_if(literals.begin(), literals.end(), [&](const auto& literal) { return literal.value == imm; });
+        if (iter == literals.end())
+        {
+            literals.emplace_back(imm);
+            iter = literals.end() - 1;
+        }
+
+        // The index of the literal in the literals buffer is the literal's name by
+        // which it can be referenced. The literal itself does not store its name.
+        return iter - literals.begin();
+    }
+
+    // Applies the fixups of all references, grouped by reference type. Within a batch the type,
+    // its descriptor and the way the opcode is patched are fixed, so the per reference work
+    // is a loop without dispatch. Batches keep the order of the references.
+    // The values are looked up beforehand, in the order of the references, in a sorted copy of the
+    // symbol table. Binary search in contiguous memory is much faster than following the nodes of the map.
+    void fix_references(address_t origin)
+    {
+        std::vector<std::pair<symbol<TSymbolName>, address_t>> sorted_symbols;
+        sorted_symbols.reserve(symbols.size());
+        for (const auto& [name, definition] : symbols)
+        {
+            sorted_symbols.emplace_back(name, definition.address + origin);
+        }
+
+        std::vector<immediate_t> values;
+        values.reserve(references.size());
+        for (const auto& ref : references)
+        {
+            auto value = ref.value.try_evaluate(
+                [&](const symbol<TSymbolName>& s)
+                {
+                    auto entry = std::lower_bound(sorted_symbols.begin(), sorted_symbols.end(), s, [](const auto& e, const auto& name) { return e.first < name; });
+                    if ((entry != sorted_symbols.end()) && (entry->first == s))
+                    {
+                        return std::optional<immediate_t>(entry->second);
+                    }
+
+                    // Constants, external and undefined symbols.
+                    return find_symbol_value(s, origin);
+                });
+            values.push_back(value ? *value : get_value(ref.value, origin, origin + ref.fixup_location));
+        }
+
+        auto type_count = static_cast<size_t>(to_underlying(reference_type::first_custom)) + custom_reference_types.size();
+        std::vector<size_t> batch_start(type_count + 1, 0);
+        for (const auto& ref : references)
+        {
+            ++batch_start[to_underlying(ref.type) + 1];
+        }
+        std::partial_sum(batch_start.begin(), batch_start.end(), batch_start.begin());
+
+        std::vector<size_t> order(references.size());
+        auto next = batch_start;
+        for (size_t i = 0; i < references.size(); ++i)
+        {
+            order[next[to_underlying(references[i].type)]++] = i;
+        }
+
+        std::vector<immediate_t> batch_values;
+        for (size_t t = 0; t < type_count; ++t)
+        {
+            std::span<const size_t> batch(order.data() + batch_start[t], batch_start[t + 1] - batch_start[t]);
+            if (!batch.empty())
+            {
+                batch_values.clear();
+                for (auto i : batch)
+                {
+                    batch_values.push_back(values[i]);
+                }
+                fix_batch(static_cast<reference_type>(t), batch, batch_values, origin);
+            }
+        }
+    }
+
+    void fix_batch(reference_type type, std::span<const size_t> batch, std::vector<immediate_t>& values, address_t origin)
+    {
+        if (is_custom(type))
+        {
+            for (auto i : batch)
+            {
+                fix_custom(references[i], origin);
+            }
+            return;
+        }
+
+        dispatch_reference_type(type, [&](auto t) { fix_batch<decltype(t)::value>(batch, values, origin); });
+    }
+
+    // The range and alignment checks run over all values of a batch without branches. Only when
+    // one of them fails are the values checked one by one, to report the error of the first reference that fails.
+    template <reference_type type>
+    void fix_batch(std::span<const size_t> batch, std::vector<immediate_t>& values, address_t origin)
+    {
+        constexpr const auto& d = reference_type_descriptors::get<type>();
+        if constexpr (is_pc_relative(type))
+        {
+            for (size_t k = 0; k < batch.size(); ++k)
+            {
+                values[k] = get_relative_address(values[k], references[batch[k]].fixup_location, origin, d);
+            }
+        }
+
+        constexpr auto min = get_link_time_min<type>();
+        constexpr auto alignment_mask = static_cast<immediate_t>(get_byte_alignment(d.alignment) - 1);
+        auto valid = true;
+        for (auto value : values)
+        {
+            valid &= (value >= min) & (value <= d.max) & ((value & alignment_mask) == 0);
+        }
+        if (!valid)
+        {
+            for (size_t k = 0; k < batch.size(); ++k)
+            {
+                values[k] = check_fixup_value(values[k], min, d.max, d.alignment, origin + references[batch[k]].fixup_location);
+            }
+        }
+
+        for (size_t k = 0; k < batch.size(); ++k)
+        {
+            patch_immediate_bits<type>(references[batch[k]].fixup_location, values[k], discard_implicitly_zero_bits(values[k], d));
+        }
+    }
+
+    void fix_address(const reference<TSymbolName>& ref, address_t origin)
+    {
+        if (is_custom(ref.type))
+        {
+            return fix_custom(ref, origin);
+        }
+
+        dispatch_reference_type(ref.type, [&](auto t) { fix_address<decltype(t)::value>(ref, origin); });
+    }
+
+    template <reference_type type>
+    void fix_address(const reference<TSymbolName>& ref, address_t origin)
+    {
+        auto value = get_value(ref.value, origin, origin + ref.fixup_location);
+        patch_immediate_bits<type>(ref.fixup_location, value, get_reference_bits<type>(ref.fixup_location, value, origin));
+    }
+
+    // Computes the immediate bits of a reference like fix_address(), but does not write them.
+    void check_address(const reference<TSymbolName>& ref, address_t origin)
+    {
+        if (is_custom(ref.type))
+        {
+            get_custom_value(ref, origin);
+            return;
+        }
+
+        auto value = get_value(ref.value, origin, origin + ref.fixup_location);
+        dispatch_reference_type(ref.type, [&](auto t) { get_reference_bits<decltype(t)::value>(ref.fixup_location, value, origin); });
+    }
+
+    void fix_local_reference(const local_reference& ref, address_t origin)
+    {
+        fix_address(to_reference(ref, origin), origin);
+    }
+
+    reference<TSymbolName> to_reference(const local_reference& ref, address_t origin) const
+    {
+        const auto& label = local_labels[ref.label];
+        if (!label)
+        {
+            report_error("Internal error: undefined local label");
+        }
+
+        return reference<TSymbolName>(ref.type, ref.fixup_location, static_cast<immediate_t>(origin + label->address));
+    }
+
+    // Smallest value a reference may resolve to. Unlike the assembler, link() does not perform
+    // special handling of negative values for add/sub instructions, and requires that the
+    // resolved value is >= 0. Other types encode negative values in two's complement, e.g. byte(-1).
+    template <reference_type type>
+    static constexpr immediate_t get_link_time_min()
+    {
+        if constexpr ((type == reference_type::abs3) || (type == reference_type::abs8_add_sub) || (type == reference_type::abs9_add_sub_sp))
+        {
+            return 0;
+        }
+        else
+        {
+            return reference_type_descriptors::get<type>().min;
+        }
+    }
+
+    // Checks the value a reference resolves to and returns the bits to write into the opcode.
+    template <reference_type type>
+    immediate_t get_reference_bits(address_t fixup_location, immediate_t value, address_t origin)
+    {
+        constexpr const auto& d = reference_type_descriptors::get<type>();
+        if constexpr (is_pc_relative(type))
+        {
+            value = get_relative_address(value, fixup_location, origin, d);
+        }
+
+        value = check_fixup_value(value, get_link_time_min<type>(), d.max, d.alignment, origin + fixup_location);
+        return discard_implicitly_zero_bits(value, d);
+    }
+
+    // Writes the immediate bits of a reference. value is the value the bits were computed from.
+    template <reference_type type>
+    void patch_immediate_bits(address_t location, immediate_t value, immediate_t bits)
+    {
+        constexpr const auto& d = reference_type_descriptors::get<type>();
+        if constexpr (type == reference_type::abs5_asr_lsr)
+        {
+            // A shift count of 0 turns ASR/LSR into LSL, whose opcode has the five most significant bits cleared.
+            auto opcode = peek16(location) & (value == 0 ? 0b0000011111111111 : 0xffff);
+            poke16(location, opcode | (bits << d.bit_pos));
+        }
+        else if constexpr ((type == reference_type::abs8_byte) || (type == reference_type::adr) || (type == reference_type::conditional_branch) ||
+            (type == reference_type::literal) || (type == reference_type::switch_offset8))
+        {
+            // Note:
+            // * The byte directive cannot be patched using peek16 and poke16. This would read/write past
+            //   the end of the program if a byte directive is at the very end of the program.
+            //   poke8 never reads/writes past the end of the program.
+            // * This works for all types where the bit width is <= 8 and where the immediate
+            //   does not span more than one byte, and whose other bits in that byte are zero.
+            poke8(location, bits & 255);
+        }
+        else if constexpr (type == reference_type::abs32)
+        {
+            poke32(location, bits);
+        }
+        else if constexpr (type == reference_type::arm_branch)
+        {
+            poke32(location, 0xea000000 | (bits & 0x00ffffff));
+        }
+        else if constexpr (type == reference_type::bl)
+        {
+            // bl is encoded as an instruction pair, where each pair contains 11 bits of the address.
+            // The address itself is 23 bits wide, but the LSB is implicitly zero, so only 22 bits are encoded.
+            poke16(location + 0, 0xf000 | ((bits >> 11) & 2047));
+            poke16(location + 2, 0xf800 | (bits & 2047));
+        }
+        else if constexpr (type == reference_type::unconditional_branch)
+        {
+            poke16(location, (0b11100 << 11) | (bits & 2047));
+        }
+        else
+        {
+            auto opcode = peek16(location);
+
+            // The assembler should have left the bits for the immediate value all zero.
+            assert((opcode & (d.bit_mask << d.bit_pos)) == 0);
+
+            poke16(location, opcode | (bits << d.bit_pos));
+        }
+    }
+
+    void fix_custom(const reference<TSymbolName>& ref, address_t origin)
+    {
+        const auto& type = get_custom_reference_type(ref.type);
+        auto value = get_custom_value(ref, origin);
+        type.patch(std::span<unsigned char>(data.data() + ref.fixup_location, type.size), value);
+    }
+
+    immediate_t get_custom_value(const reference<TSymbolName>& ref, address_t origin)
+    {
+        const auto& type = get_custom_reference_type(ref.type);
+        auto value = get_value(ref.value, origin, origin + ref.fixup_location);
+        if (type.is_pc_relative)
+        {
+            value = static_cast<immediate_t>(static_cast<address_t>(value) - (origin + ref.fixup_location));
+        }
+        return check_fixup_value(value, type.min, type.max, type.alignment, origin + ref.fixup_location);
+    }
+
+    // Number of bytes a reference patches.
+    address_t get_reference_size(reference_type type) const
+    {
+        if (is_custom(type))
+        {
+            return get_custom_reference_type(type).size;
+        }
+
+        return (reference_type_descriptors::get(type).bit_width + 7) / 8;
+    }
+
+    void fix_literal_load(const literal_load& load)
+    {
+        constexpr const auto& d = reference_type_descriptors::get<reference_type::literal>();
+
+        auto target = pool_entries[load.entry].address;
+        auto relative_address = get_relative_address(target, load.fixup_location, 0, d);
+        auto immediate_bits = get_immediate_bits(relative_address, d, error_origin + load.fixup_location);
+
+        poke8(load.fixup_location, immediate_bits & 255);
+    }
+
+    void fix_reference_to_literal(const reference_to_literal& ref)
+    {
+        constexpr const auto& d = reference_type_descriptors::get<reference_type::literal>();
+
+        auto target = literals[ref.name].address;
+        auto relative_address = get_relative_address(target, ref.fixup_location, 0, d);
+        auto immediate_bits = get_immediate_bits(relative_address, d, error_origin + ref.fixup_location);
+
+        poke8(ref.fixup_location, immediate_bits & 255);
+    }
+
+    void fix_switch_table(const switch_table<TSymbolName>& table, address_t origin)
+    {
+        auto entries = get_switch_table_bits(table, origin);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            if (table.type == reference_type::switch_offset8)
+            {
+                poke8(table.table + i, entries[i]);
+            }
+            else
+            {
+                poke16(table.table + 2 * i, entries[i]);
+            }
+        }
+    }
+
+    std::vector<immediate_t> get_switch_table_bits(const switch_table<TSymbolName>& table, address_t origin)
+    {
+        const auto& d = reference_type_descriptors::get(table.type);
+
+        // The table directly follows the add pc instruction.
+        std::vector<immediate_t> entries;
+        for (const auto& target : table.targets)
+        {
+            auto relative_address = get_relative_address(get_value(target, origin, origin + table.table), table.table - 2, origin, d);
+            entries.push_back(get_immediate_bits(relative_address, d, origin + table.table));
+        }
+        return entries;
+    }
+
+    template <typename T>
+    auto get_relative_address(T target, address_t fixup_location, address_t origin, const reference_type_descriptor& d)
+    {
+        auto source = origin + fixup_location + d.pc_offset();
+
+        if (d.require_pc_bit1_cleared())
+        {
+            source = clear_bit1(source);
+        }
+
+        return target - source;
+    }
+
+    immediate_t get_immediate_bits(immediate_t imm, const reference_type_descriptor& d, address_t address)
+    {
+        return discard_implicitly_zero_bits(check_fixup_value(imm, d.min, d.max, d.alignment, address), d);
+    }
+
+    // Like check_immediate_range() and check_immediate_is_aligned(), but reports errors through
+    // the error policy, at the address of the fixup. Policies that do not throw continue with zero.
+    immediate_t check_fixup_value(immediate_t value, immediate_t min, immediate_t max, immediate_t alignment, address_t address)
+    {
+        if ((value < min) || (value > max))
+        {
+            report(address, "Immediate value is out of range");
+            return 0;
+        }
+        if (value & (get_byte_alignment(alignment) - 1))
+        {
+            report(address, "Misaligned immediate value");
+            return 0;
+        }
+        return value;
+    }
+
+    immediate_t discard_implicitly_zero_bits(immediate_t imm, const reference_type_descriptor& d)
+    {
+        // The bitwise and is needed to special handle asr/lsr. It maps shift count 32 to 0.
+        return (imm >> d.alignment) & d.bit_mask;
+    }
+
+    // Value of an immediate, or nothing if a symbol is undefined or the immediate divides by zero.
+    // Symbols the object defines are mapped into l, a layout that has not yet been applied, unless l is null.
+    std::optional<immediate_t> try_get_value(const immediate<TSymbolName>& imm, address_t origin, const layout* l = nullptr) const
+    {
+        return imm.try_evaluate([&](const symbol<TSymbolName>& s) { return find_symbol_value(s, origin, l); });
+    }
+
+    // Like try_get_value(), but reports why there is no value through the error policy,
+    // at the address of the fixup. Policies that do not throw continue with zero.
+    immediate_t get_value(const immediate<TSymbolName>& imm, address_t origin, address_t address)
+    {
+        if (auto value = try_get_value(imm, origin))
+        {
+            return *value;
+        }
+
+        auto is_defined = true;
+        imm.for_each_symbol([&](const symbol<TSymbolName>& s) { is_defined = is_defined && find_symbol_value(s, origin).has_value(); });
+        report(address, is_defined ? "Division by zero" : "Undefined symbol");
+        return 0;
+    }
+
+    // Value of a constant, of an external symbol or of a symbol the object defines, or nothing if the
+    // symbol is undefined. Symbols the object defines are mapped into l, unless l is null.
+    std::optional<immediate_t> find_symbol_value(const symbol<TSymbolName>& s, address_t origin, const layout* l = nullptr) const
+    {
+        if (auto constant = constants.find(s); constant != constants.end())
+        {
+            return constant->second.value;
+        }
+        if (auto external = externals.find(s); external != externals.end())
+        {
+            return static_cast<immediate_t>(external->second);
+        }
+
+        auto symbol_table_entry = symbols.find(s);
+        if (symbol_table_entry == symbols.end())
+        {
+            return std::nullopt;
+        }
+
+        const auto& definition = symbol_table_entry->second;
+        auto address = l ? l->map_symbol(definition.address, definition.alignment_count) : definition.address;
+        return static_cast<immediate_t>(address + origin);
+    }
+
+    // Asks the resolver for the symbols that are referenced but not defined. Each symbol is looked
+    // up once, so the cost of linking does not depend on how many symbols the resolver knows.
+    void resolve_external_symbols(const symbol_resolver<TSymbolName>& resolver)
+    {
+        externals.clear();
+        if (!resolver)
+        {
+            return;
+        }
+
+        auto resolve = [&](const symbol<TSymbolName>& s)
+        {
+            if (!symbols.contains(s) && !constants.contains(s) && !externals.contains(s))
+            {
+                if (auto address = resolver(s))
+                {
+                    externals.emplace(s, *address);
+                }
+            }
+        };
+        for (const auto& ref : references)
+        {
+            ref.value.for_each_symbol(resolve);
+        }
+        for (const auto& table : switch_tables)
+        {
+            for (const auto& target : table.targets)
+            {
+                target.for_each_symbol(resolve);
+            }
+        }
+        for (const auto& entry_point : entry_points)
+        {
+            resolve(entry_point);
+        }
+    }
+
+    // Elements have const members, so they cannot be erased from the middle.
+    template <typename T>
+    static void truncate(std::vector<T>& v, size_t size)
+    {
+        while (v.size() > size)
+        {
+            v.pop_back();
+        }
+    }
+
+    double estimate_padding_bits(address_t padding, padding_fill fill)
+    {
+        auto start = current_lc();
+        append_padding(data, padding, fill);
+        auto bits = estimate_compressed_bits(start);
+        truncate(data, start);
+        return bits;
+    }
+
+    // The values of symbols are not known yet, their pool entries are zero until link().
+    uint32_t get_pool_value(size_t literal_index) const
+    {
+        const auto& value = literals[literal_index].value;
+        return value.is_constant() ? static_cast<uint32_t>(value.value()) : dummy_value;
+    }
+
+    // The order of the literals in the pool. When optimizing for compressed size, literals may be
+    // sorted by value, which puts literals sharing their upper bytes next to each other.
+    std::vector<size_t> get_literal_pool_order()
+    {
+        std::vector<size_t> order(literals.size());
+        std::iota(order.begin(), order.end(), 0);
+        if (goal != optimization_goal::compressed_size)
+        {
+            return order;
+        }
+
+        auto value = [&](size_t i) { return get_pool_value(i); };
+        auto ascending = order;
+        std::stable_sort(ascending.begin(), ascending.end(), [&](size_t a, size_t b) { return value(a) < value(b); });
+        auto descending = order;
+        std::stable_sort(descending.begin(), descending.end(), [&](size_t a, size_t b) { return value(a) > value(b); });
+
+        auto estimate = [&](const std::vector<size_t>& candidate)
+        {
+            auto start = current_lc();
+            for (auto i : candidate)
+            {
+                emit32(value(i));
+            }
+            auto bits = estimate_compressed_bits(start);
+            truncate(data, start);
+            return bits;
+        };
+
+        auto best = order;
+        auto best_bits = estimate(order);
+        for (const auto& candidate : { ascending, descending })
+        {
+            if (auto bits = estimate(candidate); bits < best_bits)
+            {
+                best = candidate;
+                best_bits = bits;
+            }
+        }
+        return best;
+    }
+
+    static void check_alignment_is_in_range(address_t alignment)
+    {
+        if (alignment > max_alignment)
         {
             report_error("Alignment out of range");
         }
     }
 
+    // A literal load and its pool entry take six bytes. Longer sequences never pay off.
+    static constexpr size_t max_synthesis_instructions = 2;
     static constexpr auto dummy_value = 0;
+    static constexpr uint_fast16_t bx_lr_opcode = 0x4770;
     bytevector data;
-    std::map<symbol<TSymbolName>, address_t> symbols;
+    std::map<symbol<TSymbolName>, symbol_definition> symbols;
+    std::map<symbol<TSymbolName>, constant_definition> constants;
+    std::map<symbol<TSymbolName>, address_t> externals;
+    std::vector<custom_reference_type> custom_reference_types;
     std::vector<reference<TSymbolName>> references;
     std::vector<detail::literal<TSymbolName>> literals;
     std::vector<reference_to_literal> literal_references;
+    std::vector<std::optional<symbol_definition>> local_labels;
+    std::vector<local_reference> local_references;
+    std::vector<alignment_record> alignments;
+    std::vector<pool_entry<TSymbolName>> pool_entries;
+    std::vector<literal_load> literal_loads;
+    std::vector<address_t> instructions;
+    std::vector<symbol<TSymbolName>> hot_loops;
+    std::vector<switch_table<TSymbolName>> switch_tables;
+    std::vector<address_t> lengthenable_branches;
+    std::optional<function_record> function;
+    std::vector<mergeable_block<TSymbolName>> mergeable_blocks;
+    std::optional<mergeable_data_start> mergeable_start;
+    optimization_goal goal = optimization_goal::size;
+    std::vector<symbol<TSymbolName>> entry_points;
+    stripping_report stripping;
+    folding_report folding;
+    peephole_report peephole;
+    scheduling_report scheduling;
+    TErrorPolicy errors;
+
+    // Number of errors reported so far, so that link() knows whether it found any.
+    size_t error_count = 0;
+
+    // Added to the addresses of errors of literal loads. It is the origin while link() lays out
+    // the object, so that errors are reported at absolute addresses, and zero while assembling.
+    address_t error_origin = 0;
+
+    // Set on the copy a dry run lays out, which collects its errors there.
+    std::vector<link_error>* dry_run_errors = nullptr;
+
+    // Set on the layout-only copy a dry run lays out. It points to the bytes of the object it was copied from.
+    // The copy has no bytes of its own, layout_only_size is their count.
+    const bytevector* layout_only_source = nullptr;
+    address_t layout_only_size = 0;
 };
 
 }
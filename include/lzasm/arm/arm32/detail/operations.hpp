@@ -54,6 +54,19 @@ enum class alu_operation
     mvn = 0b1111
 };
 
+enum class arm_data_processing_operation
+{
+    sub = 0b0010,
+    add = 0b0100,
+    mov = 0b1101
+};
+
+enum class arm_multiply_long_operation
+{
+    umull = 0b100,
+    smull = 0b110
+};
+
 enum class high_register_operation
 {
     add = 0b00,
@@ -101,4 +114,12 @@ constexpr imm8_operation invert_operation(imm8_operation operation)
 
 }
 
+namespace lzasm::arm::arm32
+{
+
+// Condition of a conditional branch, e.g. for cold().
+using condition_code = detail::condition_code;
+
+}
+
 #endif
@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_OPTIMIZATION_GOAL_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_OPTIMIZATION_GOAL_HPP_INCLUDED
+
+namespace lzasm::arm::arm32
+{
+
+// Selects what pseudo instructions with several possible expansions optimize for.
+enum class optimization_goal
+{
+    // Smallest code, ties are broken by cycle count.
+    size,
+
+    // Fewest cycles on the ARM7TDMI, ties are broken by code size.
+    speed,
+
+    // Smallest code after compression with an LZ compressor such as Shrinkler.
+    // Alternatives are compared by their estimated compressed size in the context
+    // of the code before them, ties are broken like for size.
+    compressed_size
+};
+
+}
+
+#endif
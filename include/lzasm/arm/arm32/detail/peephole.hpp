@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_PEEPHOLE_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_PEEPHOLE_HPP_INCLUDED
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/thumb_decoder.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// What the peephole pass of the last link() removed.
+// Cycles are those of the ARM7TDMI executing from zero wait state memory,
+// counting every removed instruction once. Conditional branches count as not taken.
+class peephole_report final
+{
+public:
+    size_t removed_instructions = 0;
+    address_t saved_bytes = 0;
+    unsigned saved_cycles = 0;
+};
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+// If the instruction does nothing except possibly modifying the flags, returns the flags it modifies.
+// mov r8, r8 is the canonical Thumb nop. It is kept, since it is used for padding and timing.
+constexpr std::optional<unsigned> get_no_op_flags(uint_fast16_t opcode)
+{
+    auto rd = opcode & 7;
+    auto rn = (opcode >> 3) & 7;
+
+    if ((opcode & 0xff00) == 0x4600)
+    {
+        // mov rd, rm with at least one high register
+        auto high_rd = ((opcode >> 4) & 8) | rd;
+        auto high_rm = (opcode >> 3) & 15;
+        if ((high_rd == high_rm) && (high_rd != 8) && (high_rd != 15))
+        {
+            return 0;
+        }
+    }
+
+    if (((opcode & 0xffc0) == 0x0000) && (rd == rn))
+    {
+        // lsl rd, rd, #0
+        return flag_n | flag_z;
+    }
+
+    if (((opcode & 0xfdc0) == 0x1c00) && (rd == rn))
+    {
+        // add/sub rd, rd, #0
+        return all_flags;
+    }
+
+    if ((opcode & 0xf0ff) == 0x3000)
+    {
+        // add/sub rd, #0
+        return all_flags;
+    }
+
+    if ((opcode & 0xff7f) == 0xb000)
+    {
+        // add/sub sp, #0
+        return 0;
+    }
+
+    return std::nullopt;
+}
+
+// Returns rn if the instruction is cmp rn, #0.
+constexpr std::optional<unsigned> get_cmp_zero_register(uint_fast16_t opcode)
+{
+    return (opcode & 0xf8ff) == 0x2800 ? std::optional<unsigned>((opcode >> 8) & 7) : std::nullopt;
+}
+
+// Returns rd if the instruction sets N and Z according to the value it writes to rd.
+constexpr std::optional<unsigned> get_nz_result_register(uint_fast16_t opcode)
+{
+    if ((opcode >> 13) == 0b000)
+    {
+        return opcode & 7;
+    }
+
+    if (((opcode >> 13) == 0b001) && (((opcode >> 11) & 3) != 0b01))
+    {
+        return (opcode >> 8) & 7;
+    }
+
+    if ((opcode >> 10) == 0b010000)
+    {
+        auto operation = (opcode >> 6) & 15;
+        if ((operation != 0b1000) && (operation != 0b1010) && (operation != 0b1011))
+        {
+            return opcode & 7;
+        }
+    }
+
+    return std::nullopt;
+}
+
+constexpr bool is_push_without_lr(uint_fast16_t opcode) { return (opcode & 0xff00) == 0xb400; }
+constexpr bool is_pop_without_pc(uint_fast16_t opcode) { return (opcode & 0xff00) == 0xbc00; }
+
+// Cycles of an instruction the peephole pass removes.
+constexpr unsigned get_removed_instruction_cycles(uint_fast16_t opcode)
+{
+    auto registers = static_cast<unsigned>(std::popcount(static_cast<unsigned>(opcode & 0xff)));
+
+    if (is_push_without_lr(opcode))
+    {
+        // stmdb: (n-1)S + 2N
+        return registers + 1;
+    }
+
+    if (is_pop_without_pc(opcode))
+    {
+        // ldmia: nS + 1N + 1I
+        return registers + 2;
+    }
+
+    if ((opcode >> 11) == 0b11100)
+    {
+        // b: 2S + 1N
+        return 3;
+    }
+
+    // Data processing instructions and not taken conditional branches: 1S
+    return 1;
+}
+
+}
+
+#endif
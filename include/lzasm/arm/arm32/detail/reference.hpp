@@ -5,8 +5,13 @@
 #ifndef LZASM_ARM_ARM32_DETAIL_REFERENCE_HPP_INCLUDED
 #define LZASM_ARM_ARM32_DETAIL_REFERENCE_HPP_INCLUDED
 
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "lzasm/arm/arm32/detail/basic_types.hpp"
 #include "lzasm/arm/arm32/detail/immediate.hpp"
+#include "lzasm/arm/arm32/detail/literal.hpp"
 #include "lzasm/arm/arm32/detail/utilities.hpp"
 
 namespace lzasm::arm::arm32::detail
@@ -34,6 +39,12 @@ enum class reference_type
     conditional_branch,
     unconditional_branch,
     literal,
+    switch_offset8,
+    switch_offset16,
+
+    // Types registered by register_reference_type() are numbered from here on.
+    // They have no descriptor in reference_type_descriptors::descriptors.
+    first_custom
 };
 
 class reference_type_descriptor final
@@ -88,6 +99,15 @@ public:
         return descriptors[index];
     }
 
+    // Descriptor of a type known at compile time. Its fields are constants, so range checks and masks fold into the code.
+    template <reference_type type>
+    static constexpr const reference_type_descriptor& get()
+    {
+        static_assert(to_underlying(type) < std::ssize(descriptors));
+        static_assert(descriptors[to_underlying(type)].type == type);
+        return descriptors[to_underlying(type)];
+    }
+
 private:
     reference_type_descriptors() = delete;
 
@@ -112,10 +132,48 @@ private:
         reference_type_descriptor(reference_type::bl,                   -0x200000 * 2,  0x1fffff * 2,   1,  22, 0),
         reference_type_descriptor(reference_type::conditional_branch,   -0x80 * 2,      0x7f * 2,       1,  8,  0),
         reference_type_descriptor(reference_type::unconditional_branch, -0x400 * 2,     0x3ff * 2,      1,  11, 0),
-        reference_type_descriptor(reference_type::literal,              0,              0xff * 4,       2,  8,  0)
+        reference_type_descriptor(reference_type::literal,              0,              0xff * 4,       2,  8,  0),
+        reference_type_descriptor(reference_type::switch_offset8,       0,              0xff * 2,       1,  8,  0),
+        reference_type_descriptor(reference_type::switch_offset16,      0,              0xffff,         0,  16, 0)
     };
 };
 
+template <reference_type type>
+using reference_type_constant = std::integral_constant<reference_type, type>;
+
+// Calls f with reference_type_constant<type>, so that f can use a type only known
+// at runtime as template argument. Custom reference types cannot be dispatched.
+template <typename F>
+decltype(auto) dispatch_reference_type(reference_type type, F f)
+{
+    switch (type)
+    {
+        case reference_type::abs3: return f(reference_type_constant<reference_type::abs3>());
+        case reference_type::abs5: return f(reference_type_constant<reference_type::abs5>());
+        case reference_type::abs5_asr_lsr: return f(reference_type_constant<reference_type::abs5_asr_lsr>());
+        case reference_type::abs6: return f(reference_type_constant<reference_type::abs6>());
+        case reference_type::abs7: return f(reference_type_constant<reference_type::abs7>());
+        case reference_type::abs8_add_sub: return f(reference_type_constant<reference_type::abs8_add_sub>());
+        case reference_type::abs8_byte: return f(reference_type_constant<reference_type::abs8_byte>());
+        case reference_type::abs8_unsigned: return f(reference_type_constant<reference_type::abs8_unsigned>());
+        case reference_type::abs9_add_sub_sp: return f(reference_type_constant<reference_type::abs9_add_sub_sp>());
+        case reference_type::abs10: return f(reference_type_constant<reference_type::abs10>());
+        case reference_type::abs16: return f(reference_type_constant<reference_type::abs16>());
+        case reference_type::abs32: return f(reference_type_constant<reference_type::abs32>());
+        case reference_type::adr: return f(reference_type_constant<reference_type::adr>());
+        case reference_type::arm_branch: return f(reference_type_constant<reference_type::arm_branch>());
+        case reference_type::bl: return f(reference_type_constant<reference_type::bl>());
+        case reference_type::conditional_branch: return f(reference_type_constant<reference_type::conditional_branch>());
+        case reference_type::unconditional_branch: return f(reference_type_constant<reference_type::unconditional_branch>());
+        case reference_type::literal: return f(reference_type_constant<reference_type::literal>());
+        case reference_type::switch_offset8: return f(reference_type_constant<reference_type::switch_offset8>());
+        case reference_type::switch_offset16: return f(reference_type_constant<reference_type::switch_offset16>());
+        default:
+            report_error("Internal error: invalid reference type");
+            return f(reference_type_constant<reference_type::abs32>());
+    }
+}
+
 template <typename TSymbolName>
 class reference final
 {
@@ -132,6 +190,20 @@ public:
     const immediate<TSymbolName> value;
 };
 
+using local_label_t = size_t;
+
+// A reference to a local label, which is an anonymous label used by pseudo instructions.
+class local_reference final
+{
+public:
+    local_reference(reference_type type, address_t fixup_location, local_label_t label)
+        : type(type), fixup_location(fixup_location), label(label) {}
+
+    const reference_type type;
+    const address_t fixup_location;
+    const local_label_t label;
+};
+
 class reference_to_literal final
 {
 public:
@@ -142,6 +214,25 @@ public:
     const literal_name_t name;
 };
 
+// Jump table emitted by switch_table. The table follows the add pc instruction of the dispatch code.
+// Entries are offsets of the targets relative to the pc value that instruction reads, that is, the
+// address of the table plus 2. Halfword entries are plain offsets, byte entries are offsets divided by 2.
+template <typename TSymbolName>
+class switch_table final
+{
+public:
+    switch_table(reference_type type, address_t table, std::vector<immediate<TSymbolName>> targets)
+        : type(type), table(table), targets(std::move(targets)) {}
+
+    // switch_offset8 or switch_offset16
+    const reference_type type;
+    const address_t table;
+    const std::vector<immediate<TSymbolName>> targets;
+
+    // Size of the dispatch code in front of the table.
+    static constexpr address_t dispatch_size = 8;
+};
+
 template <typename T>
 constexpr T check_immediate_range(T imm, T min, T max)
 {
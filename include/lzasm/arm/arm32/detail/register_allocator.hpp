@@ -0,0 +1,396 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_REGISTER_ALLOCATOR_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_REGISTER_ALLOCATOR_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "lzasm/arm/arm32/detail/registers.hpp"
+#include "lzasm/arm/arm32/detail/utilities.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+// Values 0 to 7 are the physical registers r0 to r7, higher values are virtual registers.
+inline constexpr size_t physical_register_count = 8;
+
+class allocation_instruction final
+{
+public:
+    std::vector<size_t> uses;
+    std::vector<size_t> defs;
+
+    // Instructions that may execute next. An empty list leaves the routine.
+    std::vector<size_t> successors;
+
+    // A move copies uses[0] to defs[0]. Both are given the same register if possible.
+    bool is_move = false;
+};
+
+class register_allocation final
+{
+public:
+    // Register of each virtual register, or nothing if it was spilled.
+    std::vector<std::optional<register_number_t>> registers;
+
+    // Spill slot of each spilled virtual register.
+    std::vector<std::optional<size_t>> slots;
+    size_t slot_count = 0;
+
+    // For each instruction, the registers that hold spilled virtual registers while it executes.
+    std::vector<std::vector<std::pair<size_t, register_number_t>>> spill_registers;
+};
+
+// Linear scan register allocator.
+// Live intervals are computed from liveness across branches, so that a virtual register
+// occupies its register from its first definition to its last use in program order.
+// Physical registers that instructions use explicitly are not available to virtual registers
+// that are live at the same time. If registers run out, the virtual register whose interval
+// ends last is spilled. A spilled virtual register is replaced by a short lived temporary at
+// every instruction that accesses it, and allocation is repeated until nothing more is spilled.
+class linear_scan_allocator final
+{
+public:
+    linear_scan_allocator(const std::vector<allocation_instruction>& instructions, size_t value_count)
+        : instructions(instructions), value_count(value_count)
+    {
+        auto l = compute_liveness(instructions, value_count, value_count);
+        if (!instructions.empty())
+        {
+            for (auto v = physical_register_count; v < value_count; ++v)
+            {
+                if (l.live_in[0][v])
+                {
+                    report_error("Virtual register is used before it is defined");
+                }
+            }
+        }
+    }
+
+    // allocatable has bit n set if rn may be given to virtual registers.
+    register_allocation allocate(unsigned allocatable) const
+    {
+        std::vector<bool> spilled(value_count, false);
+        for (;;)
+        {
+            // Replace spilled virtual registers by temporaries.
+            auto rewritten = instructions;
+            std::vector<std::vector<std::pair<size_t, size_t>>> temporaries(instructions.size());
+            auto rewritten_value_count = value_count;
+            for (size_t i = 0; i < rewritten.size(); ++i)
+            {
+                auto replace = [&](size_t& v)
+                {
+                    if (!spilled[v])
+                    {
+                        return;
+                    }
+                    auto& t = temporaries[i];
+                    auto p = std::find_if(t.begin(), t.end(), [&](const auto& entry) { return entry.first == v; });
+                    if (p == t.end())
+                    {
+                        t.emplace_back(v, rewritten_value_count++);
+                        p = t.end() - 1;
+                    }
+                    v = p->second;
+                };
+                std::for_each(rewritten[i].uses.begin(), rewritten[i].uses.end(), replace);
+                std::for_each(rewritten[i].defs.begin(), rewritten[i].defs.end(), replace);
+            }
+
+            auto l = compute_liveness(rewritten, rewritten_value_count, value_count);
+            auto ranges = compute_live_ranges(rewritten, rewritten_value_count, l);
+            std::vector<size_t> new_spills;
+            auto registers = scan(rewritten, ranges, rewritten_value_count, allocatable, new_spills);
+
+            if (new_spills.empty())
+            {
+                register_allocation allocation;
+                allocation.registers.assign(registers.begin(), registers.begin() + value_count);
+                allocation.slots.resize(value_count);
+                for (auto v = physical_register_count; v < value_count; ++v)
+                {
+                    if (spilled[v])
+                    {
+                        allocation.slots[v] = allocation.slot_count++;
+                    }
+                }
+                for (const auto& t : temporaries)
+                {
+                    allocation.spill_registers.emplace_back();
+                    for (const auto& [v, temporary] : t)
+                    {
+                        allocation.spill_registers.back().emplace_back(v, *registers[temporary]);
+                    }
+                }
+                return allocation;
+            }
+
+            for (auto v : new_spills)
+            {
+                spilled[v] = true;
+            }
+        }
+    }
+
+private:
+    class liveness final
+    {
+    public:
+        std::vector<std::vector<bool>> live_in;
+        std::vector<std::vector<bool>> live_out;
+    };
+
+    class interval final
+    {
+    public:
+        size_t value;
+
+        // Positions are 2i for reading the operands of instruction i and 2i + 1 for writing its results.
+        // A register whose interval ends when an instruction reads it can be written by the same instruction.
+        size_t start;
+        size_t end;
+    };
+
+    class live_ranges final
+    {
+    public:
+        // Intervals of virtual registers, sorted by start.
+        std::vector<interval> intervals;
+
+        // Sorted positions at which each physical register holds a value.
+        std::vector<std::vector<size_t>> occupied;
+    };
+
+    // Temporaries are loaded right before and stored right after their instruction, so they are never live across instructions.
+    static liveness compute_liveness(const std::vector<allocation_instruction>& instructions, size_t value_count, size_t first_temporary)
+    {
+        liveness l;
+        l.live_in.assign(instructions.size(), std::vector<bool>(value_count, false));
+        l.live_out.assign(instructions.size(), std::vector<bool>(value_count, false));
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto i = instructions.size(); i-- > 0;)
+            {
+                const auto& instruction = instructions[i];
+                std::vector<bool> out(value_count, false);
+                for (auto s : instruction.successors)
+                {
+                    for (size_t v = 0; v < first_temporary; ++v)
+                    {
+                        out[v] = out[v] || l.live_in[s][v];
+                    }
+                }
+
+                auto in = out;
+                for (auto v : instruction.defs)
+                {
+                    in[v] = false;
+                }
+                for (auto v : instruction.uses)
+                {
+                    in[v] = true;
+                }
+
+                if ((in != l.live_in[i]) || (out != l.live_out[i]))
+                {
+                    l.live_in[i].swap(in);
+                    l.live_out[i].swap(out);
+                    changed = true;
+                }
+            }
+        }
+
+        return l;
+    }
+
+    static live_ranges compute_live_ranges(const std::vector<allocation_instruction>& instructions, size_t value_count, const liveness& l)
+    {
+        constexpr auto none = std::numeric_limits<size_t>::max();
+        std::vector<interval> all(value_count, interval{ 0, none, 0 });
+        live_ranges ranges;
+        ranges.occupied.resize(physical_register_count);
+
+        auto extend = [&](size_t v, size_t position)
+        {
+            all[v].value = v;
+            all[v].start = std::min(all[v].start, position);
+            all[v].end = std::max(all[v].end, position);
+            if (v < physical_register_count)
+            {
+                ranges.occupied[v].push_back(position);
+            }
+        };
+
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            for (size_t v = 0; v < value_count; ++v)
+            {
+                if (l.live_in[i][v])
+                {
+                    extend(v, 2 * i);
+                }
+                if (l.live_out[i][v])
+                {
+                    extend(v, 2 * i + 1);
+                }
+            }
+            for (auto v : instructions[i].defs)
+            {
+                extend(v, 2 * i + 1);
+            }
+        }
+
+        for (auto& positions : ranges.occupied)
+        {
+            std::sort(positions.begin(), positions.end());
+        }
+
+        for (auto v = physical_register_count; v < value_count; ++v)
+        {
+            if (all[v].start != none)
+            {
+                ranges.intervals.push_back(all[v]);
+            }
+        }
+        std::stable_sort(
+            ranges.intervals.begin(), ranges.intervals.end(),
+            [](const interval& a, const interval& b) { return a.start < b.start; });
+
+        return ranges;
+    }
+
+    // Values from value_count onwards are temporaries, which are never spilled.
+    std::vector<std::optional<register_number_t>> scan(
+        const std::vector<allocation_instruction>& rewritten, const live_ranges& ranges, size_t rewritten_value_count,
+        unsigned allocatable, std::vector<size_t>& spills) const
+    {
+        std::vector<std::optional<register_number_t>> registers(rewritten_value_count);
+        std::vector<const interval*> owners(physical_register_count, nullptr);
+
+        auto is_temporary = [&](const interval& i) { return i.value >= value_count; };
+        auto is_usable = [&](register_number_t r, const interval& i)
+        {
+            if (!(allocatable & (1u << r)))
+            {
+                return false;
+            }
+            const auto& positions = ranges.occupied[r];
+            auto p = std::lower_bound(positions.begin(), positions.end(), i.start);
+            return (p == positions.end()) || (*p > i.end);
+        };
+
+        for (const auto& current : ranges.intervals)
+        {
+            for (auto& owner : owners)
+            {
+                if (owner && (owner->end < current.start))
+                {
+                    owner = nullptr;
+                }
+            }
+
+            std::optional<register_number_t> chosen;
+            for (auto hint : get_hints(rewritten, registers, current))
+            {
+                if (!chosen && !owners[hint] && is_usable(hint, current))
+                {
+                    chosen = hint;
+                }
+            }
+            for (register_number_t r = 0; !chosen && (r < static_cast<register_number_t>(physical_register_count)); ++r)
+            {
+                if (!owners[r] && is_usable(r, current))
+                {
+                    chosen = r;
+                }
+            }
+
+            if (!chosen)
+            {
+                // Take the register of the interval that ends last, if that is later than the current one.
+                // Temporaries always get a register.
+                std::optional<register_number_t> victim;
+                for (register_number_t r = 0; r < static_cast<register_number_t>(physical_register_count); ++r)
+                {
+                    if (owners[r] && !is_temporary(*owners[r]) && is_usable(r, current) &&
+                        (is_temporary(current) || (owners[r]->end > current.end)) &&
+                        (!victim || (owners[r]->end > owners[*victim]->end)))
+                    {
+                        victim = r;
+                    }
+                }
+
+                if (!victim)
+                {
+                    if (is_temporary(current))
+                    {
+                        report_error("Not enough registers to allocate virtual registers");
+                    }
+                    spills.push_back(current.value);
+                    continue;
+                }
+
+                spills.push_back(owners[*victim]->value);
+                chosen = victim;
+            }
+
+            owners[*chosen] = &current;
+            registers[current.value] = *chosen;
+        }
+
+        for (register_number_t r = 0; r < static_cast<register_number_t>(physical_register_count); ++r)
+        {
+            registers[r] = r;
+        }
+        return registers;
+    }
+
+    // Registers that would make the moves at either end of an interval unnecessary.
+    static std::vector<register_number_t> get_hints(
+        const std::vector<allocation_instruction>& rewritten, const std::vector<std::optional<register_number_t>>& registers, const interval& i)
+    {
+        std::vector<register_number_t> hints;
+        auto add_hint = [&](size_t v)
+        {
+            if (v < physical_register_count)
+            {
+                hints.push_back(static_cast<register_number_t>(v));
+            }
+            else if (registers[v])
+            {
+                hints.push_back(*registers[v]);
+            }
+        };
+
+        const auto& first = rewritten[i.start / 2];
+        if (first.is_move && (first.defs[0] == i.value))
+        {
+            add_hint(first.uses[0]);
+        }
+
+        const auto& last = rewritten[i.end / 2];
+        if (last.is_move && (last.uses[0] == i.value))
+        {
+            add_hint(last.defs[0]);
+        }
+
+        return hints;
+    }
+
+    const std::vector<allocation_instruction>& instructions;
+    size_t value_count;
+};
+
+}
+
+#endif
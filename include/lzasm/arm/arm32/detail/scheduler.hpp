@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_SCHEDULER_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_SCHEDULER_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "lzasm/arm/arm32/detail/thumb_decoder.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// What the load scheduling pass of the last link() did.
+// Saved cycles are estimated for the ARM9TDMI, which interlocks for one cycle if an
+// instruction reads the destination of a load immediately before it.
+// The ARM7TDMI never interlocks, there the reordered code takes as long as before.
+class scheduling_report final
+{
+public:
+    size_t moved_instructions = 0;
+    unsigned saved_cycles = 0;
+};
+
+}
+
+namespace lzasm::arm::arm32::detail
+{
+
+class schedulable_instruction final
+{
+public:
+    uint_fast16_t opcode;
+    thumb_instruction_info info;
+
+    // Pinned instructions must keep their address, e.g. because they have a fixup or read pc.
+    bool pinned;
+};
+
+// Reorders straight-line code to hide load-use interlocks.
+// Instructions are moved by swapping neighbours. A swap must preserve register dependencies,
+// the order of memory accesses if one of them is a store, and the value of all live flags.
+class load_use_scheduler final
+{
+public:
+    // successor_uses are the registers read by the instruction following the region,
+    // live_out_flags the flags that may be read after the region.
+    load_use_scheduler(std::vector<schedulable_instruction> region, uint_fast16_t successor_uses, unsigned live_out_flags)
+        : region(std::move(region)), successor_uses(successor_uses), live_out_flags(live_out_flags) {}
+
+    // Returns the number of interlocks removed.
+    unsigned schedule()
+    {
+        auto initial = count_interlocks(region);
+        auto current = initial;
+
+        // Every accepted move removes at least one interlock, so this terminates.
+        bool improved = true;
+        while (improved && current)
+        {
+            improved = false;
+            for (size_t k = 0; !improved && (k < region.size()); ++k)
+            {
+                if (!is_interlocked(region, k))
+                {
+                    continue;
+                }
+
+                // Fill the slot after the load with a later instruction, or move the load up.
+                for (size_t j = k + 2; !improved && (j < region.size()); ++j)
+                {
+                    improved = try_move(j, k + 1, current);
+                }
+                for (size_t j = k; !improved && (j-- > 0);)
+                {
+                    improved = try_move(k, j, current);
+                }
+            }
+        }
+
+        return initial - current;
+    }
+
+    const std::vector<schedulable_instruction>& instructions() const { return region; }
+
+private:
+    // Moves the instruction at from to position to, if all swaps are valid and this removes interlocks.
+    bool try_move(size_t from, size_t to, unsigned& interlocks)
+    {
+        auto candidate = region;
+        while (from != to)
+        {
+            auto p = from > to ? from - 1 : from;
+            if (!can_swap(candidate, p))
+            {
+                return false;
+            }
+            std::swap(candidate[p], candidate[p + 1]);
+            from = from > to ? from - 1 : from + 1;
+        }
+
+        auto candidate_interlocks = count_interlocks(candidate);
+        if (candidate_interlocks >= interlocks)
+        {
+            return false;
+        }
+
+        region.swap(candidate);
+        interlocks = candidate_interlocks;
+        return true;
+    }
+
+    // Whether the instructions at p and p + 1 may be swapped.
+    bool can_swap(const std::vector<schedulable_instruction>& order, size_t p) const
+    {
+        if (order[p].pinned || order[p + 1].pinned)
+        {
+            return false;
+        }
+
+        const auto& a = order[p].info;
+        const auto& b = order[p + 1].info;
+        if ((a.defs & (b.uses | b.defs)) || (b.defs & a.uses))
+        {
+            return false;
+        }
+
+        if ((a.memory != memory_access::none) && (b.memory != memory_access::none) &&
+            ((a.memory == memory_access::store) || (b.memory == memory_access::store)))
+        {
+            return false;
+        }
+
+        // After the swap, a writes the flags both write, so these must be dead.
+        return !(a.clobbers & b.reads) && !(b.clobbers & a.reads) && !(a.clobbers & b.clobbers & get_live_flags(order, p + 1));
+    }
+
+    // Flags that may be read after the instruction at index.
+    unsigned get_live_flags(const std::vector<schedulable_instruction>& order, size_t index) const
+    {
+        auto live = live_out_flags;
+        for (auto i = order.size() - 1; i > index; --i)
+        {
+            live = (live & ~order[i].info.writes) | order[i].info.reads;
+        }
+        return live;
+    }
+
+    bool is_interlocked(const std::vector<schedulable_instruction>& order, size_t k) const
+    {
+        auto next_uses = k + 1 < order.size() ? order[k + 1].info.uses : successor_uses;
+        return (order[k].info.load_result & next_uses) != 0;
+    }
+
+    unsigned count_interlocks(const std::vector<schedulable_instruction>& order) const
+    {
+        unsigned interlocks = 0;
+        for (size_t k = 0; k < order.size(); ++k)
+        {
+            interlocks += is_interlocked(order, k);
+        }
+        return interlocks;
+    }
+
+    std::vector<schedulable_instruction> region;
+    uint_fast16_t successor_uses;
+    unsigned live_out_flags;
+};
+
+}
+
+#endif
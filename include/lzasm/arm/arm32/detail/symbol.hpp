@@ -5,8 +5,11 @@
 #ifndef LZASM_ARM_ARM32_DETAIL_SYMBOL_HPP_INCLUDED
 #define LZASM_ARM_ARM32_DETAIL_SYMBOL_HPP_INCLUDED
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <utility>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
 
 namespace lzasm::arm::arm32
 {
@@ -60,4 +63,13 @@ static_assert(sizeof(symbol<std::string>) == sizeof(std::string));
 
 }
 
+namespace lzasm::arm::arm32::detail
+{
+
+// Returns the address of a symbol the program does not define, or nothing if it is unknown.
+template <typename TSymbolName>
+using symbol_resolver = std::function<std::optional<address_t>(const symbol<TSymbolName>&)>;
+
+}
+
 #endif
@@ -0,0 +1,277 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_DETAIL_THUMB_DECODER_HPP_INCLUDED
+#define LZASM_ARM_ARM32_DETAIL_THUMB_DECODER_HPP_INCLUDED
+
+#include <cstdint>
+#include "lzasm/arm/arm32/detail/basic_types.hpp"
+
+namespace lzasm::arm::arm32::detail
+{
+
+inline constexpr unsigned flag_n = 8;
+inline constexpr unsigned flag_z = 4;
+inline constexpr unsigned flag_c = 2;
+inline constexpr unsigned flag_v = 1;
+inline constexpr unsigned all_flags = flag_n | flag_z | flag_c | flag_v;
+
+// Register masks have bit n set for register rn.
+inline constexpr uint_fast16_t sp_mask = 1u << 13;
+inline constexpr uint_fast16_t lr_mask = 1u << 14;
+inline constexpr uint_fast16_t pc_mask = 1u << 15;
+
+enum class thumb_flow
+{
+    next,                   // Continues with the next instruction
+    conditional_branch,     // Continues with the next instruction or the branch target
+    unconditional_branch,   // Continues with the branch target
+    unknown                 // Calls, returns, indirect branches, exceptions and undefined instructions
+};
+
+enum class memory_access
+{
+    none,
+    load,
+    store
+};
+
+// What the link time optimizations need to know about a Thumb instruction.
+// Register usage of branches other than bx is not decoded.
+class thumb_instruction_info final
+{
+public:
+    address_t size = 2;
+
+    // Flags read, flags that are always written and flags that may be written.
+    unsigned reads = 0;
+    unsigned writes = 0;
+    unsigned clobbers = 0;
+
+    thumb_flow flow = thumb_flow::next;
+
+    // Registers read and written.
+    uint_fast16_t uses = 0;
+    uint_fast16_t defs = 0;
+
+    memory_access memory = memory_access::none;
+
+    // Destination of a single register load. The ARM9TDMI interlocks if the next instruction reads it.
+    uint_fast16_t load_result = 0;
+};
+
+constexpr unsigned get_condition_flags(unsigned cc)
+{
+    switch (cc >> 1)
+    {
+        case 0: return flag_z;                      // eq, ne
+        case 1: return flag_c;                      // cs, cc
+        case 2: return flag_n;                      // mi, pl
+        case 3: return flag_v;                      // vs, vc
+        case 4: return flag_c | flag_z;             // hi, ls
+        case 5: return flag_n | flag_v;             // ge, lt
+        default: return flag_n | flag_z | flag_v;   // gt, le
+    }
+}
+
+// Whether execution never continues with the next instruction: b, bx, pop with pc and mov or add to pc.
+constexpr bool is_unconditional_transfer(uint_fast16_t opcode)
+{
+    return ((opcode >> 11) == 0b11100) || ((opcode & 0xff00) == 0xbd00) || ((opcode & 0xff80) == 0x4700) || ((opcode & 0xfd87) == 0x4487);
+}
+
+constexpr thumb_instruction_info decode_thumb_instruction(uint_fast16_t opcode)
+{
+    auto r = [](unsigned n) { return static_cast<uint_fast16_t>(1u << n); };
+    auto r0 = opcode & 7;
+    auto r3 = (opcode >> 3) & 7;
+    auto r6 = (opcode >> 6) & 7;
+    auto r8 = (opcode >> 8) & 7;
+    auto is_load = (opcode & 0x0800) != 0;
+
+    thumb_instruction_info info;
+    auto set_transfer = [&](bool load, unsigned rd, uint_fast16_t address_registers)
+    {
+        info.uses = address_registers;
+        if (load)
+        {
+            info.defs = r(rd);
+            info.memory = memory_access::load;
+            info.load_result = r(rd);
+        }
+        else
+        {
+            info.uses |= r(rd);
+            info.memory = memory_access::store;
+        }
+    };
+
+    if ((opcode >> 11) == 0b00011)
+    {
+        // add/sub with register or 3 bit immediate
+        info.writes = all_flags;
+        info.uses = r(r3) | ((opcode & 0x0400) ? 0 : r(r6));
+        info.defs = r(r0);
+    }
+    else if ((opcode >> 13) == 0b000)
+    {
+        // Shifts by immediate. lsl #0 does not modify C.
+        info.writes = (opcode & 0xffc0) == 0 ? flag_n | flag_z : flag_n | flag_z | flag_c;
+        info.uses = r(r3);
+        info.defs = r(r0);
+    }
+    else if ((opcode >> 13) == 0b001)
+    {
+        // mov/cmp/add/sub with 8 bit immediate
+        auto operation = (opcode >> 11) & 3;
+        info.writes = operation == 0b00 ? flag_n | flag_z : all_flags;
+        info.uses = operation == 0b00 ? 0 : r(r8);
+        info.defs = operation == 0b01 ? 0 : r(r8);
+    }
+    else if ((opcode >> 10) == 0b010000)
+    {
+        auto operation = (opcode >> 6) & 15;
+        switch (operation)
+        {
+            case 0b0101:    // adc
+            case 0b0110:    // sbc
+                info.reads = flag_c;
+                info.writes = all_flags;
+                break;
+            case 0b1001:    // neg
+            case 0b1010:    // cmp
+            case 0b1011:    // cmn
+                info.writes = all_flags;
+                break;
+            case 0b0010:    // lsl
+            case 0b0011:    // lsr
+            case 0b0100:    // asr
+            case 0b0111:    // ror
+            case 0b1101:    // mul
+                // Register shifts by 0 do not modify C, mul destroys it.
+                info.writes = flag_n | flag_z;
+                info.clobbers = flag_c;
+                break;
+            default:
+                info.writes = flag_n | flag_z;
+                break;
+        }
+        info.uses = r(r0) | r(r3);
+        info.defs = ((operation == 0b1000) || (operation == 0b1010) || (operation == 0b1011)) ? 0 : r(r0);
+    }
+    else if ((opcode >> 10) == 0b010001)
+    {
+        auto operation = (opcode >> 8) & 3;
+        auto rd = ((opcode >> 4) & 8) | r0;
+        auto rm = (opcode >> 3) & 15;
+        if (operation == 0b01)
+        {
+            info.writes = all_flags;
+            info.uses = r(rd) | r(rm);
+        }
+        else
+        {
+            // bx, and add or mov to pc, are indirect branches.
+            info.flow = ((operation == 0b11) || (rd == 15)) ? thumb_flow::unknown : thumb_flow::next;
+            info.uses = r(rm) | (operation == 0b00 ? r(rd) : 0);
+            info.defs = operation == 0b11 ? 0 : r(rd);
+        }
+    }
+    else if ((opcode >> 11) == 0b01001)
+    {
+        // ldr rd, [pc, #imm]
+        set_transfer(true, r8, pc_mask);
+    }
+    else if ((opcode >> 12) == 0b0101)
+    {
+        // Loads and stores with register offset. strh is the only store with bit 9 set.
+        auto load = (opcode & 0x0200) ? ((opcode & 0x0c00) != 0) : is_load;
+        set_transfer(load, r0, r(r3) | r(r6));
+    }
+    else if (((opcode >> 13) == 0b011) || ((opcode >> 12) == 0b1000))
+    {
+        // Loads and stores with immediate offset
+        set_transfer(is_load, r0, r(r3));
+    }
+    else if ((opcode >> 12) == 0b1001)
+    {
+        // Loads and stores relative to sp
+        set_transfer(is_load, r8, sp_mask);
+    }
+    else if ((opcode >> 12) == 0b1010)
+    {
+        // add rd, pc/sp, #imm
+        info.uses = (opcode & 0x0800) ? sp_mask : pc_mask;
+        info.defs = r(r8);
+    }
+    else if ((opcode >> 12) == 0b1011)
+    {
+        // add sp, push and pop. pop with pc returns, anything else is undefined.
+        auto list = static_cast<uint_fast16_t>(opcode & 0xff);
+        if ((opcode & 0x0f00) == 0x0000)
+        {
+            info.uses = sp_mask;
+            info.defs = sp_mask;
+        }
+        else if (((opcode & 0x0600) != 0x0400) || ((opcode & 0x0f00) == 0x0d00))
+        {
+            info.flow = thumb_flow::unknown;
+        }
+        else if (is_load)
+        {
+            info.uses = sp_mask;
+            info.defs = sp_mask | list;
+            info.memory = memory_access::load;
+        }
+        else
+        {
+            info.uses = sp_mask | list | ((opcode & 0x0100) ? lr_mask : 0);
+            info.defs = sp_mask;
+            info.memory = memory_access::store;
+        }
+    }
+    else if ((opcode >> 12) == 0b1100)
+    {
+        // ldmia/stmia with writeback
+        auto list = static_cast<uint_fast16_t>(opcode & 0xff);
+        info.uses = r(r8) | (is_load ? 0 : list);
+        info.defs = r(r8) | (is_load ? list : 0);
+        info.memory = is_load ? memory_access::load : memory_access::store;
+    }
+    else if ((opcode >> 12) == 0b1101)
+    {
+        auto cc = (opcode >> 8) & 15;
+        if (cc >= 0b1110)
+        {
+            // Undefined, swi
+            info.flow = thumb_flow::unknown;
+        }
+        else
+        {
+            info.reads = get_condition_flags(cc);
+            info.flow = thumb_flow::conditional_branch;
+        }
+    }
+    else if ((opcode >> 11) == 0b11100)
+    {
+        info.flow = thumb_flow::unconditional_branch;
+    }
+    else if ((opcode >> 11) == 0b11110)
+    {
+        // First half of bl
+        info.size = 4;
+        info.flow = thumb_flow::unknown;
+    }
+    else
+    {
+        info.flow = thumb_flow::unknown;
+    }
+
+    info.clobbers |= info.writes;
+    return info;
+}
+
+}
+
+#endif
@@ -5,15 +5,34 @@
 #ifndef LZASM_ARM_ARM32_DIVIDED_THUMB_ASSEMBLER_HPP_INCLUDED
 #define LZASM_ARM_ARM32_DIVIDED_THUMB_ASSEMBLER_HPP_INCLUDED
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <concepts>
+#include <cstdint>
+#include <functional>
 #include <limits>
+#include <optional>
 #include <string>
+#include <vector>
 #include "lzasm/arm/arm32/detail/basic_types.hpp"
+#include "lzasm/arm/arm32/detail/block_transfer.hpp"
+#include "lzasm/arm/arm32/detail/constant_synthesis.hpp"
+#include "lzasm/arm/arm32/detail/cost.hpp"
+#include "lzasm/arm/arm32/detail/custom_reference.hpp"
+#include "lzasm/arm/arm32/detail/division_magic.hpp"
+#include "lzasm/arm/arm32/detail/error_policy.hpp"
 #include "lzasm/arm/arm32/detail/immediate.hpp"
+#include "lzasm/arm/arm32/detail/immediate_operand.hpp"
+#include "lzasm/arm/arm32/detail/link_options.hpp"
+#include "lzasm/arm/arm32/detail/link_summary.hpp"
+#include "lzasm/arm/arm32/detail/multiplication_chain.hpp"
 #include "lzasm/arm/arm32/detail/object.hpp"
 #include "lzasm/arm/arm32/detail/operations.hpp"
+#include "lzasm/arm/arm32/detail/optimization_goal.hpp"
+#include "lzasm/arm/arm32/detail/peephole.hpp"
 #include "lzasm/arm/arm32/detail/reference.hpp"
+#include "lzasm/arm/arm32/detail/scheduler.hpp"
 #include "lzasm/arm/arm32/detail/registers.hpp"
 #include "lzasm/arm/arm32/detail/register_lists.hpp"
 #include "lzasm/arm/arm32/detail/symbol.hpp"
@@ -22,11 +41,16 @@
 namespace lzasm::arm::arm32
 {
 
-template <typename TSymbolName>
+template <typename TSymbolName, error_policy TErrorPolicy = throwing_error_policy>
 class basic_divided_thumb_assembler
 {
 public:
     using immediate = detail::immediate<TSymbolName>;
+    using symbol_resolver = detail::symbol_resolver<TSymbolName>;
+
+    // Immediate operand that must fit into the given reference type. imm<value> is checked at compile time.
+    template <detail::reference_type type>
+    using immediate_operand = detail::immediate_operand<TSymbolName, type>;
 
     virtual ~basic_divided_thumb_assembler() = default;
 
@@ -35,12 +59,81 @@ public:
         return obj.current_lc();
     }
 
-    bytevector link(address_t origin)
+    // With an error policy that does not throw, link() returns an empty program if there are errors.
+    bytevector link(address_t origin, const link_options& options = link_options())
+    {
+        flush_cold();
+        if (!obj.link(origin, options))
+        {
+            return {};
+        }
+        return obj.to_bytevector();
+    }
+
+    // Like link(), but symbols the program does not define are looked up by the resolver.
+    // Their addresses are absolute, origin is not added to them.
+    bytevector link(address_t origin, const symbol_resolver& resolver, const link_options& options = link_options())
     {
-        obj.link(origin);
+        flush_cold();
+        if (!obj.link(origin, options, resolver))
+        {
+            return {};
+        }
         return obj.to_bytevector();
     }
 
+    // Lays out the program like link() with default options, but neither writes nor copies any bytes.
+    // Returns the size, the label addresses and all errors link() would report, regardless of the error policy.
+    // Apart from emitting the deferred cold code, the program is left unchanged, so a dry run
+    // can be repeated, e.g. at other origins, and be followed by link().
+    basic_link_summary<TSymbolName> dry_run_link(address_t origin)
+    {
+        flush_cold();
+        return obj.dry_run_link(origin);
+    }
+
+    basic_link_summary<TSymbolName> dry_run_link(address_t origin, const symbol_resolver& resolver)
+    {
+        flush_cold();
+        return obj.dry_run_link(origin, resolver);
+    }
+
+    // Code and data removed by the dead code stripping pass of the last link().
+    const stripping_report& last_stripping_report() const
+    {
+        return obj.get_stripping_report();
+    }
+
+    // Routines folded by the identical code folding pass of the last link().
+    const folding_report& last_folding_report() const
+    {
+        return obj.get_folding_report();
+    }
+
+    // Instructions removed by the peephole pass of the last link().
+    const peephole_report& last_peephole_report() const
+    {
+        return obj.get_peephole_report();
+    }
+
+    // Instructions moved by the load scheduling pass of the last link().
+    const scheduling_report& last_scheduling_report() const
+    {
+        return obj.get_scheduling_report();
+    }
+
+    // The error policy, e.g. to check and clear the errors of an error_code_policy.
+    TErrorPolicy& errors()
+    {
+        return obj.get_error_policy();
+    }
+
+    // Adds a reference type for data formats the assembler does not know, see fixup().
+    custom_reference_id register_reference_type(custom_reference_type type)
+    {
+        return obj.add_custom_reference_type(std::move(type));
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Miscellaneous directives
     ////////////////////////////////////////////////////////////////////////////
@@ -57,12 +150,134 @@ public:
         return *this;
     }
 
+    basic_divided_thumb_assembler& align_code(address_t alignment)
+    {
+        obj.align_code(alignment);
+        return *this;
+    }
+
+    // Defines a label at the start of a loop that link() aligns if hot_loop_alignment is set.
+    basic_divided_thumb_assembler& hot_loop(const symbol<TSymbolName>& s)
+    {
+        obj.add_hot_loop(s);
+        return *this;
+    }
+
     basic_divided_thumb_assembler& label(const symbol<TSymbolName>& s)
     {
         obj.add_symbol(s);
         return *this;
     }
 
+    // Defines s as a number. Immediates referring to s are resolved right away, like numbers.
+    basic_divided_thumb_assembler& equ(const symbol<TSymbolName>& s, const immediate& value)
+    {
+        obj.add_constant(s, value, false);
+        return *this;
+    }
+
+    // Like equ(), but s may be defined again by set(). Immediates use the value at the time they are emitted.
+    basic_divided_thumb_assembler& set(const symbol<TSymbolName>& s, const immediate& value)
+    {
+        obj.add_constant(s, value, true);
+        return *this;
+    }
+
+    // Keeps the code at s, and everything it refers to, when link() strips unreachable code.
+    basic_divided_thumb_assembler& entry_point(const symbol<TSymbolName>& s)
+    {
+        obj.add_entry_point(s);
+        return *this;
+    }
+
+    // Starts a function whose prologue and epilogue end_function() chooses.
+    basic_divided_thumb_assembler& begin_function()
+    {
+        obj.begin_function();
+        return *this;
+    }
+
+    // Returns from the function started by begin_function().
+    basic_divided_thumb_assembler& ret()
+    {
+        obj.add_function_return();
+        return *this;
+    }
+
+    // Emits the smallest push and pop pair that preserves the registers r4-r7 written by the function
+    // and lr if the function contains calls. Leaf functions that write no such register get no frame.
+    basic_divided_thumb_assembler& end_function()
+    {
+        flush_cold();
+        obj.end_function();
+        return *this;
+    }
+
+    // Defers rarely executed code, e.g. an error path, to keep the hot path contiguous.
+    // flush_cold() calls emitter and places the code it emits behind the label s. Unless that code
+    // ends with an unconditional branch, it is followed by a branch back to where cold() was called.
+    basic_divided_thumb_assembler& cold(const symbol<TSymbolName>& s, std::function<void()> emitter)
+    {
+        auto resume = obj.create_local_label();
+        obj.define_local_label(resume);
+        cold_blocks.push_back(cold_block{ s, resume, std::move(emitter) });
+        return *this;
+    }
+
+    // Like cold(s, emitter), but also emits the conditional branch to the cold code. If the cold code
+    // ends up out of the branch's range, link() replaces the branch by an inverted conditional branch
+    // over an unconditional branch to the cold code.
+    basic_divided_thumb_assembler& cold(condition_code cc, const symbol<TSymbolName>& s, std::function<void()> emitter)
+    {
+        obj.add_lengthenable_branch();
+        emit_conditional_branch(cc, s);
+        return cold(s, std::move(emitter));
+    }
+
+    // Emits the deferred cold code. If the code before can continue with the next instruction,
+    // a branch around the cold code is emitted. end_function() and link() call this.
+    basic_divided_thumb_assembler& flush_cold()
+    {
+        if (cold_blocks.empty())
+        {
+            return *this;
+        }
+
+        std::optional<detail::local_label_t> end;
+        if (!obj.ends_with_unconditional_transfer())
+        {
+            end = obj.create_local_label();
+            emit_unconditional_branch(*end);
+        }
+
+        // Cold code may defer more cold code.
+        for (size_t i = 0; i < cold_blocks.size(); ++i)
+        {
+            auto block = cold_blocks[i];
+            obj.add_symbol(block.label);
+            block.emitter();
+            if (!obj.ends_with_unconditional_transfer())
+            {
+                emit_unconditional_branch(block.resume);
+            }
+        }
+        cold_blocks.clear();
+
+        if (end)
+        {
+            obj.define_local_label(*end);
+        }
+        return *this;
+    }
+
+    // Selects what pseudo instructions with several possible expansions optimize for.
+    basic_divided_thumb_assembler& optimize_for(optimization_goal g)
+    {
+        goal = g;
+        obj.set_optimization_goal(g);
+        return *this;
+    }
+
     basic_divided_thumb_assembler& pool()
     {
         obj.emit_literal_pool();
@@ -99,27 +314,27 @@ public:
         return *this;
     }
 
-    basic_divided_thumb_assembler& byte(const immediate& imm8)
+    basic_divided_thumb_assembler& byte(const immediate_operand<detail::reference_type::abs8_byte>& imm8)
     {
-        obj.emit8(to_abs(reference_type::abs8_byte, imm8) & 255);
+        obj.emit8(to_abs<reference_type::abs8_byte>(imm8) & 255);
         return *this;
     }
 
     template <typename... Bytes>
-    basic_divided_thumb_assembler& byte(const immediate& imm8, const Bytes&... bytes)
+    basic_divided_thumb_assembler& byte(const immediate_operand<detail::reference_type::abs8_byte>& imm8, const Bytes&... bytes)
     {
         byte(imm8);
         return byte(bytes...);
     }
 
-    basic_divided_thumb_assembler& hword(const immediate& imm16)
+    basic_divided_thumb_assembler& hword(const immediate_operand<detail::reference_type::abs16>& imm16)
     {
-        obj.emit16(to_abs(reference_type::abs16, imm16));
+        obj.emit16(to_abs<reference_type::abs16>(imm16));
         return *this;
     }
 
     template <typename... Hwords>
-    basic_divided_thumb_assembler& hword(const immediate& imm16, const Hwords&... hwords)
+    basic_divided_thumb_assembler& hword(const immediate_operand<detail::reference_type::abs16>& imm16, const Hwords&... hwords)
     {
         hword(imm16);
         return hword(hwords...);
@@ -135,19 +350,48 @@ public:
         return *this;
     }
 
-    basic_divided_thumb_assembler& word(const immediate& imm32)
+    basic_divided_thumb_assembler& word(const immediate_operand<detail::reference_type::abs32>& imm32)
     {
-        obj.emit32(to_abs(reference_type::abs32, imm32));
+        obj.emit32(to_abs<reference_type::abs32>(imm32));
         return *this;
     }
 
     template <typename... Words>
-    basic_divided_thumb_assembler& word(const immediate& imm32, const Words&... words)
+    basic_divided_thumb_assembler& word(const immediate_operand<detail::reference_type::abs32>& imm32, const Words&... words)
     {
         word(imm32);
         return word(words...);
     }
 
+    // Emits the zero bytes of a custom reference type, which link() patches with the value of imm.
+    basic_divided_thumb_assembler& fixup(custom_reference_id type, const immediate& imm)
+    {
+        auto size = obj.get_custom_reference_type(type).size;
+        obj.add_reference(type, imm);
+        for (address_t i = 0; i < size; ++i)
+        {
+            obj.emit8(0);
+        }
+        return *this;
+    }
+
+    // Defines read-only data that may share its bytes with other mergeable data.
+    // The data definition directives called by emitter define a block labeled s, which link()
+    // places after the code. If the block equals the end of another block, s refers to that instead.
+    // alignment is the alignment of the block, as for align().
+    basic_divided_thumb_assembler& mergeable_data(const symbol<TSymbolName>& s, std::function<void()> emitter)
+    {
+        return mergeable_data(s, 0, std::move(emitter));
+    }
+
+    basic_divided_thumb_assembler& mergeable_data(const symbol<TSymbolName>& s, address_t alignment, std::function<void()> emitter)
+    {
+        obj.begin_mergeable_data();
+        emitter();
+        obj.end_mergeable_data(s, alignment);
+        return *this;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // ARM code generation pseudo instructions
     ////////////////////////////////////////////////////////////////////////////
@@ -171,9 +415,277 @@ public:
     {
         obj.emit32((0xe28fu << 16) | (r.n() << 12) | 0x001);
         obj.emit32((0xe12fff1u << 4) | r.n());
+        obj.add_register_writes(1u << r.n());
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Arbitrary immediate pseudo instructions
+    ////////////////////////////////////////////////////////////////////////////
+
+    // These accept any 32 bit constant and generate the cheapest expansion
+    // according to the optimization goal. Expansions may use a scratch register,
+    // if one is given. Unless noted otherwise, the flags are undefined afterwards.
+
+    // rx = rx + imm
+    basic_divided_thumb_assembler& add_imm(const low_reg rx, immediate_t imm)
+    {
+        return emit_add_imm(rx, static_cast<uint32_t>(imm), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& add_imm(const low_reg rx, immediate_t imm, const low_reg scratch)
+    {
+        return emit_add_imm(rx, static_cast<uint32_t>(imm), scratch);
+    }
+
+    // sp = sp + imm, where imm must be a multiple of 4.
+    // Expansions that do not use a literal do not modify the flags.
+    basic_divided_thumb_assembler& add_imm(const reg_sp, immediate_t imm)
+    {
+        return emit_add_sp_imm(static_cast<uint32_t>(imm), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& add_imm(const reg_sp, immediate_t imm, const low_reg scratch)
+    {
+        return emit_add_sp_imm(static_cast<uint32_t>(imm), scratch);
+    }
+
+    // rd = sp + imm. rd itself serves as scratch register.
+    basic_divided_thumb_assembler& add_imm(const low_reg rd, const reg_sp, immediate_t imm)
+    {
+        return emit_add_rd_sp_imm(rd, static_cast<uint32_t>(imm));
+    }
+
+    // Compares rn with imm. The flags are set exactly as if cmp rn, #imm existed.
+    // Unless imm is in the range [0, 255] a scratch register is required.
+    basic_divided_thumb_assembler& cmp_imm(const low_reg rn, immediate_t imm)
+    {
+        return emit_cmp_imm(rn, static_cast<uint32_t>(imm), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& cmp_imm(const low_reg rn, immediate_t imm, const low_reg scratch)
+    {
+        return emit_cmp_imm(rn, static_cast<uint32_t>(imm), scratch);
+    }
+
+    // rd = rs * k. Generates a sequence of lsl/add/sub/neg instructions or,
+    // if that is cheaper, builds k in a register and uses mul.
+    // rs is preserved unless it is the same register as rd.
+    basic_divided_thumb_assembler& mul_const(const low_reg rd, const low_reg rs, immediate_t k)
+    {
+        return emit_mul_const(rd, rs, static_cast<uint32_t>(k), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& mul_const(const low_reg rd, const low_reg rs, immediate_t k, const low_reg scratch)
+    {
+        return emit_mul_const(rd, rs, static_cast<uint32_t>(k), scratch);
+    }
+
+    // rd = rn / d and rd = rn % d, rounding towards zero, where rn and d are signed (sdiv_const, smod_const)
+    // or unsigned (udiv_const, umod_const). Division by a power of two uses shifts. Other divisors use a
+    // reciprocal multiplication, for which the code briefly switches to ARM state to use smull/umull.
+    // That requires a scratch register and rd must differ from rn.
+    // rn is preserved unless it is the same register as rd.
+    basic_divided_thumb_assembler& sdiv_const(const low_reg rd, const low_reg rn, immediate_t d)
+    {
+        return emit_sdiv_const(rd, rn, d, std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& sdiv_const(const low_reg rd, const low_reg rn, immediate_t d, const low_reg scratch)
+    {
+        return emit_sdiv_const(rd, rn, d, scratch);
+    }
+
+    basic_divided_thumb_assembler& smod_const(const low_reg rd, const low_reg rn, immediate_t d)
+    {
+        return emit_smod_const(rd, rn, d, std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& smod_const(const low_reg rd, const low_reg rn, immediate_t d, const low_reg scratch)
+    {
+        return emit_smod_const(rd, rn, d, scratch);
+    }
+
+    // rx = rx - imm
+    basic_divided_thumb_assembler& sub_imm(const low_reg rx, immediate_t imm)
+    {
+        return emit_add_imm(rx, negate(imm), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& sub_imm(const low_reg rx, immediate_t imm, const low_reg scratch)
+    {
+        return emit_add_imm(rx, negate(imm), scratch);
+    }
+
+    // sp = sp - imm, where imm must be a multiple of 4.
+    basic_divided_thumb_assembler& sub_imm(const reg_sp, immediate_t imm)
+    {
+        return emit_add_sp_imm(negate(imm), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& sub_imm(const reg_sp, immediate_t imm, const low_reg scratch)
+    {
+        return emit_add_sp_imm(negate(imm), scratch);
+    }
+
+    // rd = sp - imm
+    basic_divided_thumb_assembler& sub_imm(const low_reg rd, const reg_sp, immediate_t imm)
+    {
+        return emit_add_rd_sp_imm(rd, negate(imm));
+    }
+
+    basic_divided_thumb_assembler& udiv_const(const low_reg rd, const low_reg rn, immediate_t d)
+    {
+        return emit_udiv_const(rd, rn, static_cast<uint32_t>(d), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& udiv_const(const low_reg rd, const low_reg rn, immediate_t d, const low_reg scratch)
+    {
+        return emit_udiv_const(rd, rn, static_cast<uint32_t>(d), scratch);
+    }
+
+    basic_divided_thumb_assembler& umod_const(const low_reg rd, const low_reg rn, immediate_t d)
+    {
+        return emit_umod_const(rd, rn, static_cast<uint32_t>(d), std::nullopt);
+    }
+
+    basic_divided_thumb_assembler& umod_const(const low_reg rd, const low_reg rn, immediate_t d, const low_reg scratch)
+    {
+        return emit_umod_const(rd, rn, static_cast<uint32_t>(d), scratch);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Block transfer pseudo instructions
+    ////////////////////////////////////////////////////////////////////////////
+
+    // These generate code specialized for a block size known at assembly time.
+    // Words are transferred with ldmia/stmia bursts using the registers in temporaries.
+    // Depending on the optimization goal the bursts are either straight-line code or a loop,
+    // in which case one of the temporaries serves as loop counter.
+    // dst and src are modified, the temporaries and the flags are undefined afterwards.
+    // The estimate functions return the size and cycle count of the code that would be generated.
+
+    // Copies size bytes from src to dst. Overlapping blocks are supported if dst < src.
+    basic_divided_thumb_assembler& copy_block(const low_reg dst, const low_reg src, address_t size, const low_reg_list temporaries, const block_options& options = block_options())
+    {
+        if (!check_block_transfer_registers(temporaries, dst, src))
+        {
+            return *this;
+        }
+
+        auto registers = to_registers(temporaries);
+        emit_block_transfer(choose_block_transfer(block_transfer_kind::copy, size, options, registers.size()), dst, src, registers);
+        return *this;
+    }
+
+    detail::cost estimate_copy_block(address_t size, const low_reg_list temporaries, const block_options& options = block_options()) const
+    {
+        return choose_block_transfer(block_transfer_kind::copy, size, options, to_registers(temporaries).size()).estimate();
+    }
+
+    // Fills size bytes at dst with the word in value. For the head and tail of
+    // the block the low halfword or byte of value is stored, so unless dst and size
+    // are word aligned, all bytes of value should be equal.
+    basic_divided_thumb_assembler& fill_block(const low_reg dst, const low_reg value, address_t size, const block_options& options = block_options())
+    {
+        if (!check_block_transfer_registers(low_reg_list(value), dst, dst))
+        {
+            return *this;
+        }
+
+        emit_block_transfer(choose_block_transfer(block_transfer_kind::fill, size, options, 1), dst, dst, { value });
+        return *this;
+    }
+
+    basic_divided_thumb_assembler& fill_block(const low_reg dst, const low_reg value, address_t size, const low_reg_list temporaries, const block_options& options = block_options())
+    {
+        if (!check_block_transfer_registers(temporaries, dst, value))
+        {
+            return *this;
+        }
+
+        auto registers = to_registers(temporaries, { value });
+        emit_block_transfer(choose_block_transfer(block_transfer_kind::fill, size, options, registers.size()), dst, dst, registers);
+        return *this;
+    }
+
+    detail::cost estimate_fill_block(address_t size, const block_options& options = block_options()) const
+    {
+        return choose_block_transfer(block_transfer_kind::fill, size, options, 1).estimate();
+    }
+
+    detail::cost estimate_fill_block(address_t size, const low_reg_list temporaries, const block_options& options = block_options()) const
+    {
+        return choose_block_transfer(block_transfer_kind::fill, size, options, to_registers(temporaries).size() + 1).estimate();
+    }
+
+    // Sets size bytes at dst to zero.
+    basic_divided_thumb_assembler& zero_block(const low_reg dst, address_t size, const low_reg_list temporaries, const block_options& options = block_options())
+    {
+        if (!check_block_transfer_registers(temporaries, dst, dst))
+        {
+            return *this;
+        }
+
+        auto registers = to_registers(temporaries);
+        emit_block_transfer(choose_block_transfer(block_transfer_kind::zero, size, options, registers.size()), dst, dst, registers);
+        return *this;
+    }
+
+    detail::cost estimate_zero_block(address_t size, const low_reg_list temporaries, const block_options& options = block_options()) const
+    {
+        return choose_block_transfer(block_transfer_kind::zero, size, options, to_registers(temporaries).size()).estimate();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Jump table pseudo instructions
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Jumps to labels[index]. If index is out of range, execution continues after the table.
+    // The table holds offsets to the labels, which must follow the table. It starts out with halfword
+    // entries, link() turns it into a byte table if all offsets fit. index is destroyed.
+    basic_divided_thumb_assembler& switch_table(const low_reg index, const std::vector<immediate>& labels)
+    {
+        if (labels.empty() || (labels.size() > max_switch_table_entries))
+        {
+            report("Invalid number of switch table entries");
+            return *this;
+        }
+
+        auto count = static_cast<address_t>(labels.size());
+        auto end = obj.create_local_label();
+        cmp(index, static_cast<immediate_t>(count - 1));
+        if (2 * count + 6 <= max_conditional_branch_offset)
+        {
+            emit_conditional_branch(condition_code::hi, end);
+        }
+        else
+        {
+            auto dispatch = obj.create_local_label();
+            emit_conditional_branch(condition_code::ls, dispatch);
+            emit_unconditional_branch(end);
+            obj.define_local_label(dispatch);
+        }
+
+        lsl(index, index, 1);
+        add(index, pc);
+        ldrh(index, index, 2);
+        add(pc, index);
+        obj.add_switch_table(reference_type::switch_offset16, labels);
+        for (address_t i = 0; i < count; ++i)
+        {
+            obj.emit16(dummy_value);
+        }
+        obj.define_local_label(end);
         return *this;
     }
 
+    template <typename... TLabels>
+    basic_divided_thumb_assembler& switch_table(const low_reg index, const TLabels&... labels)
+    {
+        return switch_table(index, std::vector<immediate>{ immediate(labels)... });
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Thumb instructions
     ////////////////////////////////////////////////////////////////////////////
@@ -182,25 +694,25 @@ public:
     basic_divided_thumb_assembler& adc(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::adc, rx, rm); }
 
     // ["add", "Rx!=HI, Rx!=HI, #ImmZ", "T16", "0011|0|Rx:3|ImmZ:8", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& add(const low_reg rx, const immediate& imm8)
+    basic_divided_thumb_assembler& add(const low_reg rx, const immediate_operand<detail::reference_type::abs8_add_sub>& imm8)
     {
         return emit_add_sub_imm8(imm8_operation::add, rx, imm8);
     }
 
     // ["add", "Rd!=HI, Rn!=HI, #ImmZ", "T16", "0001|110|ImmZ:3|Rn:3|Rd:3", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& add(const low_reg rd, const low_reg rn, const immediate& imm3)
+    basic_divided_thumb_assembler& add(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs3>& imm3)
     {
         return emit_add_sub_imm3(add_sub_operation::add, rd, rn, imm3);
     }
 
     // ["add", "Rx==SP, Rx==SP, #ImmZ*4", "T16", "1011|00000|ImmZ:7", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& add(const reg_sp, const immediate& imm9)
+    basic_divided_thumb_assembler& add(const reg_sp, const immediate_operand<detail::reference_type::abs9_add_sub_sp>& imm9)
     {
         return emit_add_sub_sp_imm9(add_sub_operation::add, imm9);
     }
 
     // ["add", "Rd!=SP, Rn==SP, #ImmZ*4", "T16", "1010|1|Rd:3|ImmZ:8", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& add(const low_reg rd, const reg_sp, const immediate& imm10)
+    basic_divided_thumb_assembler& add(const low_reg rd, const reg_sp, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
         return emit_load_address(true, rd, imm10);
     }
@@ -229,7 +741,7 @@ public:
 
     // ["adr", "Rd!=HI, #RelZ*4", "T16", "1010|0|Rd:3|RelZ:8", "ARMv4T+ IT=ANY ADD=1"]
     // Note: asmdb lists this instruction as adr, but adr is a pseudo instruction which generates this add instruction.
-    basic_divided_thumb_assembler& add(const low_reg rd, const reg_pc, const immediate& imm10)
+    basic_divided_thumb_assembler& add(const low_reg rd, const reg_pc, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
         return emit_load_address(false, rd, imm10);
     }
@@ -238,7 +750,7 @@ public:
     basic_divided_thumb_assembler& and_(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::and_, rx, rm); }
 
     // ["asr", "Rd!=HI, Rn!=HI, #Shift", "T16", "0001|0|Shift:5|Rn:3|Rd:3", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& asr(const low_reg rd, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& asr(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs5_asr_lsr>& imm5)
     {
         return emit_asr_lsr_imm5(shift_operation::asr, rd, rn, imm5);
     }
@@ -268,7 +780,7 @@ public:
     basic_divided_thumb_assembler& b(const immediate& imm12)
     {
         obj.add_reference(reference_type::unconditional_branch, imm12);
-        obj.emit16(0);
+        obj.emit_instruction16(0b11100 << 11);
         return *this;
     }
 
@@ -279,14 +791,14 @@ public:
     basic_divided_thumb_assembler& bl(const immediate& imm23)
     {
         obj.add_reference(reference_type::bl, imm23);
-        obj.emit32(0);
+        obj.emit_instruction32(0xf800f000);
         return *this;
     }
 
     // ["bx", "Rm", "T16", "0100|011|10|Rm:4|000", "ARMv4T+ IT=OUT|LAST"]
     basic_divided_thumb_assembler& bx(const reg rm)
     {
-        obj.emit16((0b010001110 << 7) | (rm.n() << 3));
+        obj.emit_instruction16((0b010001110 << 7) | (rm.n() << 3));
         return *this;
     }
 
@@ -294,7 +806,7 @@ public:
     basic_divided_thumb_assembler& cmn(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::cmn, rx, rm); }
 
     // ["cmp", "Rn!=HI, #ImmZ", "T16", "0010|1|Rn:3|ImmZ:8", "ARMv4T+ IT=ANY APSR.NZCV=W"]
-    basic_divided_thumb_assembler& cmp(const low_reg rd, const immediate& imm8)
+    basic_divided_thumb_assembler& cmp(const low_reg rd, const immediate_operand<detail::reference_type::abs8_unsigned>& imm8)
     {
         return emit_cmp_mov_imm8(imm8_operation::cmp, rd, imm8);
     }
@@ -334,22 +846,22 @@ public:
     }
 
     // ["ldr", "Rd!=HI, [Rn!=HI, #ImmZ*4]", "T16", "0110|1|ImmZ:5|Rn:3|Rd:3", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& ldr(const low_reg rd, const low_reg rn, const immediate& imm7)
+    basic_divided_thumb_assembler& ldr(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs7>& imm7)
     {
         return emit_load_store_word(true, rd, rn, imm7);
     }
 
     // ["ldr", "Rd!=HI, [Rn==PC, #ImmZ*4]", "T16", "0100|1|Rd:3|ImmZ:8", "ARMv6T2+ IT=ANY"]
     // Note: asmdb says this instruction is available in ARMv6T2+, but it should be ARMv4T+.
-    basic_divided_thumb_assembler& ldr(const low_reg rd, const reg_pc, const immediate& imm10)
+    basic_divided_thumb_assembler& ldr(const low_reg rd, const reg_pc, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
-        auto imm = to_abs(reference_type::abs10, imm10);
-        obj.emit16((0b01001 << 11) | (rd.n() << 8) | (imm / 4));
+        auto imm = to_abs<reference_type::abs10>(imm10);
+        obj.emit_instruction16((0b01001 << 11) | (rd.n() << 8) | (imm / 4));
         return *this;
     }
 
     // ["ldr", "Rd!=HI, [Rn==SP, #ImmZ*4]", "T16", "1001|1|Rd:3|ImmZ:8", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& ldr(const low_reg rd, const reg_sp, const immediate& imm10)
+    basic_divided_thumb_assembler& ldr(const low_reg rd, const reg_sp, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
         return emit_sp_relative_load_store(true, rd, imm10);
     }
@@ -369,7 +881,7 @@ public:
     }
 
     // ["ldrb", "Rd!=HI, [Rn!=HI, #ImmZ*4]", "T16", "0111|1|ImmZ:5|Rn:3|Rd:3", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& ldrb(const low_reg rd, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& ldrb(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs5>& imm5)
     {
         return emit_load_store_byte(true, rd, rn, imm5);
     }
@@ -381,7 +893,7 @@ public:
     }
 
     // ["ldrh", "Rd!=HI, [Rn!=HI, #ImmZ*4]", "T16", "1000|1|ImmZ:5|Rn:3|Rd:3", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& ldrh(const low_reg rd, const low_reg rn, const immediate& imm6)
+    basic_divided_thumb_assembler& ldrh(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs6>& imm6)
     {
         return emit_load_store_halfword(true, rd, rn, imm6);
     }
@@ -405,10 +917,10 @@ public:
     }
 
     // ["lsl", "Rd!=HI, Rn!=HI, #Shift", "T16", "0000|0|Shift:5|Rn:3|Rd:3", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& lsl(const low_reg rd, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& lsl(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs5>& imm5)
     {
-        auto imm = to_abs(reference_type::abs5, imm5);
-        obj.emit16((0b00000 << 11) | (imm << 6) | (rn.n() << 3) | rd.n());
+        auto imm = to_abs<reference_type::abs5>(imm5);
+        obj.emit_instruction16((0b00000 << 11) | (imm << 6) | (rn.n() << 3) | rd.n());
         return *this;
     }
 
@@ -416,7 +928,7 @@ public:
     basic_divided_thumb_assembler& lsl(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::lsl, rx, rm); }
 
     // ["lsr", "Rd!=HI, Rn!=HI, #Shift", "T16", "0000|1|Shift:5|Rn:3|Rd:3", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& lsr(const low_reg rd, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& lsr(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs5_asr_lsr>& imm5)
     {
         return emit_asr_lsr_imm5(shift_operation::lsr, rd, rn, imm5);
     }
@@ -425,7 +937,7 @@ public:
     basic_divided_thumb_assembler& lsr(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::lsr, rx, rm); }
 
     // ["mov", "Rd!=HI, #ImmZ", "T16", "0010|0|Rd:3|ImmZ:8", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& mov(const low_reg rd, const immediate& imm8)
+    basic_divided_thumb_assembler& mov(const low_reg rd, const immediate_operand<detail::reference_type::abs8_unsigned>& imm8)
     {
         return emit_cmp_mov_imm8(imm8_operation::mov, rd, imm8);
     }
@@ -501,20 +1013,20 @@ public:
         auto tmp = low_reg(rn.n());
         if (list.contains(tmp) && !list.is_lowest(tmp))
         {
-            detail::report_error("Unpredictable behavior");
+            report("Unpredictable behavior");
         }
 
         return emit_ldmia_stmia(ldmia_stmia_operation::stmia, rn, list);
     }
 
     // ["str", "Rs!=HI, [Rn!=HI, #ImmZ*4]", "T16", "0110|0|ImmZ:5|Rn:3|Rs:3", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& str(const low_reg rs, const low_reg rn, const immediate& imm7)
+    basic_divided_thumb_assembler& str(const low_reg rs, const low_reg rn, const immediate_operand<detail::reference_type::abs7>& imm7)
     {
         return emit_load_store_word(false, rs, rn, imm7);
     }
 
     // ["str", "Rs!=HI, [Rn==SP, #ImmZ*4]", "T16", "1001|0|Rs:3|ImmZ:8", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& str(const low_reg rs, const reg_sp, const immediate& imm10)
+    basic_divided_thumb_assembler& str(const low_reg rs, const reg_sp, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
         return emit_sp_relative_load_store(false, rs, imm10);
     }
@@ -527,7 +1039,7 @@ public:
 
     // ["strb", "Rs!=HI, [Rn!=HI, #ImmZ*4]", "T16", "0111|0|ImmZ:5|Rn:3|Rs:3", "ARMv4T+ IT=ANY"]
     // Note: the #ImmZ*4 from asmdb appears to be wrong and should probably just be #ImmZ.
-    basic_divided_thumb_assembler& strb(const low_reg rs, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& strb(const low_reg rs, const low_reg rn, const immediate_operand<detail::reference_type::abs5>& imm5)
     {
         return emit_load_store_byte(false, rs, rn, imm5);
     }
@@ -539,7 +1051,7 @@ public:
     }
 
     // ["strh", "Rs!=HI, [Rn!=HI, #ImmZ*4]", "T16", "1000|0|ImmZ:5|Rn:3|Rs:3", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& strh(const low_reg rs, const low_reg rn, const immediate& imm6)
+    basic_divided_thumb_assembler& strh(const low_reg rs, const low_reg rn, const immediate_operand<detail::reference_type::abs6>& imm6)
     {
         return emit_load_store_halfword(false, rs, rn, imm6);
     }
@@ -551,19 +1063,19 @@ public:
     }
 
     // ["sub", "Rd!=HI, Rn!=HI, #ImmZ", "T16", "0001|111|ImmZ:3|Rn:3|Rd:3", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& sub(const low_reg rd, const low_reg rn, const immediate& imm3)
+    basic_divided_thumb_assembler& sub(const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs3>& imm3)
     {
         return emit_add_sub_imm3(add_sub_operation::sub, rd, rn, imm3);
     }
 
     // ["sub", "Rx!=HI, Rx!=HI, #ImmZ", "T16", "0011|1|Rx:3|ImmZ:8", "ARMv4T+ IT=IN"]
-    basic_divided_thumb_assembler& sub(const low_reg rx, const immediate& imm8)
+    basic_divided_thumb_assembler& sub(const low_reg rx, const immediate_operand<detail::reference_type::abs8_add_sub>& imm8)
     {
         return emit_add_sub_imm8(imm8_operation::sub, rx, imm8);
     }
 
     // ["sub", "Rx==SP, Rx==SP, #ImmZ*4", "T16", "1011|00001|ImmZ:7", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& sub(const reg_sp, const immediate& imm9)
+    basic_divided_thumb_assembler& sub(const reg_sp, const immediate_operand<detail::reference_type::abs9_add_sub_sp>& imm9)
     {
         return emit_add_sub_sp_imm9(add_sub_operation::sub, imm9);
     }
@@ -575,10 +1087,10 @@ public:
     }
 
     // ["svc", "#ImmZ", "T16", "1101|1111|ImmZ:8", "ARMv4T+ IT=ANY"]
-    basic_divided_thumb_assembler& swi(const immediate& imm8)
+    basic_divided_thumb_assembler& swi(const immediate_operand<detail::reference_type::abs8_unsigned>& imm8)
     {
-        auto imm = to_abs(reference_type::abs8_unsigned, imm8);
-        obj.emit16((0b11011111 << 8) | imm);
+        auto imm = to_abs<reference_type::abs8_unsigned>(imm8);
+        obj.emit_instruction16((0b11011111 << 8) | imm);
         return *this;
     }
 
@@ -586,18 +1098,21 @@ public:
     basic_divided_thumb_assembler& tst(const low_reg rx, const low_reg rm) { return emit_alu_operation(alu_operation::tst, rx, rm); }
 
 private:
-    using object = ::lzasm::arm::arm32::detail::object<TSymbolName>;
+    using object = ::lzasm::arm::arm32::detail::object<TSymbolName, TErrorPolicy>;
     using reference_type = ::lzasm::arm::arm32::detail::reference_type;
     using condition_code = ::lzasm::arm::arm32::detail::condition_code;
     using add_sub_operation = ::lzasm::arm::arm32::detail::add_sub_operation;
+    using arm_data_processing_operation = ::lzasm::arm::arm32::detail::arm_data_processing_operation;
+    using arm_multiply_long_operation = ::lzasm::arm::arm32::detail::arm_multiply_long_operation;
     using alu_operation = ::lzasm::arm::arm32::detail::alu_operation;
+    using block_transfer_kind = ::lzasm::arm::arm32::detail::block_transfer_kind;
     using high_register_operation = ::lzasm::arm::arm32::detail::high_register_operation;
     using imm8_operation = ::lzasm::arm::arm32::detail::imm8_operation;
     using ldmia_stmia_operation = ::lzasm::arm::arm32::detail::ldmia_stmia_operation;
     using push_pop_operation = ::lzasm::arm::arm32::detail::push_pop_operation;
     using shift_operation = ::lzasm::arm::arm32::detail::shift_operation;
 
-    basic_divided_thumb_assembler& emit_asr_lsr_imm5(shift_operation operation, const low_reg rd, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& emit_asr_lsr_imm5(shift_operation operation, const low_reg rd, const low_reg rn, const immediate_operand<detail::reference_type::abs5_asr_lsr>& imm5)
     {
         // ASR and LSR allow shift counts in the range [0, 32] in assembly source.
         //
@@ -607,17 +1122,17 @@ private:
         // * Shift counts 1..31 can be encoded as is.
         // * A shift count of 32 is encoded as a shift count of 0.
         assert((operation == shift_operation::asr) || (operation == shift_operation::lsr));
-        auto imm = to_abs(reference_type::abs5_asr_lsr, imm5);
-        if ((imm == 0) && !imm5.is_symbol_reference())
+        auto imm = to_abs<reference_type::abs5_asr_lsr>(imm5);
+        if ((imm == 0) && (imm5.is_checked() || obj.resolve_constants(imm5.value()).is_constant()))
         {
             // Map a shift count of 0 to an LSR instruction, but only if the shift count is known.
-            // If it is a symbol reference we don't know what instruction we're going to generate until link time.
+            // If it is only known at link time we don't know what instruction we're going to generate until then.
             return lsl(rd, rn, 0);
         }
         else
         {
             // Bitwise and with 31 maps shift counts of 32 to 0.
-            obj.emit16((to_underlying(operation) << 11) | ((imm & 31) << 6) | (rn.n() << 3) | rd.n());
+            obj.emit_instruction16((to_underlying(operation) << 11) | ((imm & 31) << 6) | (rn.n() << 3) | rd.n());
             return *this;
         }
     }
@@ -626,34 +1141,34 @@ private:
     basic_divided_thumb_assembler& emit_add_sub_register(add_sub_operation operation, const reg rd, const reg rn, const reg rm)
     {
         assert(are_all_low(rd, rn, rm));
-        obj.emit16((0b000110 << 10) | (to_underlying(operation) << 9) | (rm.n() << 6) | (rn.n() << 3) | rd.n());
+        obj.emit_instruction16((0b000110 << 10) | (to_underlying(operation) << 9) | (rm.n() << 6) | (rn.n() << 3) | rd.n());
         return *this;
     }
 
     // Caution: although operands are of type reg, only low registers are allowed.
-    basic_divided_thumb_assembler& emit_add_sub_imm3(add_sub_operation operation, const reg rd, const reg rn, const immediate& imm3)
+    basic_divided_thumb_assembler& emit_add_sub_imm3(add_sub_operation operation, const reg rd, const reg rn, const immediate_operand<detail::reference_type::abs3>& imm3)
     {
         assert(are_all_low(rd, rn));
-        auto imm = to_abs(reference_type::abs3, imm3);
+        auto imm = to_abs<reference_type::abs3>(imm3);
         invert_if_negative(operation, imm);
-        obj.emit16((0b000111 << 10) | (to_underlying(operation) << 9) | (imm << 6) | (rn.n() << 3) | rd.n());
+        obj.emit_instruction16((0b000111 << 10) | (to_underlying(operation) << 9) | (imm << 6) | (rn.n() << 3) | rd.n());
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_add_sub_imm8(imm8_operation operation, const low_reg rx, const immediate& imm8)
+    basic_divided_thumb_assembler& emit_add_sub_imm8(imm8_operation operation, const low_reg rx, const immediate_operand<detail::reference_type::abs8_add_sub>& imm8)
     {
         assert((operation == imm8_operation::add) || (operation == imm8_operation::sub));
-        auto imm = to_abs(reference_type::abs8_add_sub, imm8);
+        auto imm = to_abs<reference_type::abs8_add_sub>(imm8);
         invert_if_negative(operation, imm);
-        obj.emit16((0b001 << 13) | (to_underlying(operation) << 11) | (rx.n() << 8) | imm);
+        obj.emit_instruction16((0b001 << 13) | (to_underlying(operation) << 11) | (rx.n() << 8) | imm);
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_cmp_mov_imm8(imm8_operation operation, const low_reg rd, const immediate& imm8)
+    basic_divided_thumb_assembler& emit_cmp_mov_imm8(imm8_operation operation, const low_reg rd, const immediate_operand<detail::reference_type::abs8_unsigned>& imm8)
     {
         assert((operation == imm8_operation::cmp) || (operation == imm8_operation::mov));
-        auto imm = to_abs(reference_type::abs8_unsigned, imm8);
-        obj.emit16((0b001 << 13) | (to_underlying(operation) << 11) | (rd.n() << 8) | imm);
+        auto imm = to_abs<reference_type::abs8_unsigned>(imm8);
+        obj.emit_instruction16((0b001 << 13) | (to_underlying(operation) << 11) | (rd.n() << 8) | imm);
         return *this;
     }
 
@@ -661,34 +1176,34 @@ private:
     basic_divided_thumb_assembler& emit_alu_operation(alu_operation operation, const reg rx, const reg rm)
     {
         assert(are_all_low(rx, rm));
-        obj.emit16((0b010000 << 10) | (to_underlying(operation) << 6) | (rm.n() << 3) | rx.n());
+        obj.emit_instruction16((0b010000 << 10) | (to_underlying(operation) << 6) | (rm.n() << 3) | rx.n());
         return *this;
     }
 
     basic_divided_thumb_assembler& emit_high_register_operation(high_register_operation operation, const reg rx, const reg rm)
     {
         assert(!are_all_low(rx, rm));
-        obj.emit16((0b010001 << 10) | (to_underlying(operation) << 8) | (rx.high_bit() << 7) | (rm.n() << 3) | (rx.low_bits()));
+        obj.emit_instruction16((0b010001 << 10) | (to_underlying(operation) << 8) | (rx.high_bit() << 7) | (rm.n() << 3) | (rx.low_bits()));
         return *this;
     }
 
     basic_divided_thumb_assembler& emit_load_store_with_register_offset(bool is_load, bool is_byte, const low_reg rd_rs, const low_reg rn, const low_reg rm)
     {
-        obj.emit16((0b0101000 << 9) | (is_load << 11) | (is_byte << 10) | (rm.n() << 6) | (rn.n() << 3) | (rd_rs.n() << 0));
+        obj.emit_instruction16((0b0101000 << 9) | (is_load << 11) | (is_byte << 10) | (rm.n() << 6) | (rn.n() << 3) | (rd_rs.n() << 0));
         return *this;
     }
 
     basic_divided_thumb_assembler& emit_load_store_sign_extended(bool is_halfword, bool is_sign_extended, const low_reg rd_rs, const low_reg rn, const low_reg rm)
     {
-        obj.emit16((0b0101001 << 9) | (is_halfword << 11) | (is_sign_extended << 10) | (rm.n() << 6) | (rn.n() << 3) | (rd_rs.n() << 0));
+        obj.emit_instruction16((0b0101001 << 9) | (is_halfword << 11) | (is_sign_extended << 10) | (rm.n() << 6) | (rn.n() << 3) | (rd_rs.n() << 0));
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_add_sub_sp_imm9(add_sub_operation operation, const immediate& imm9)
+    basic_divided_thumb_assembler& emit_add_sub_sp_imm9(add_sub_operation operation, const immediate_operand<detail::reference_type::abs9_add_sub_sp>& imm9)
     {
-        auto imm = to_abs(reference_type::abs9_add_sub_sp, imm9);
+        auto imm = to_abs<reference_type::abs9_add_sub_sp>(imm9);
         invert_if_negative(operation, imm);
-        obj.emit16((0b10110000 << 8) | (to_underlying(operation) << 7) | (imm / 4));
+        obj.emit_instruction16((0b10110000 << 8) | (to_underlying(operation) << 7) | (imm / 4));
         return *this;
     }
 
@@ -696,79 +1211,912 @@ private:
     basic_divided_thumb_assembler& emit_push_pop(push_pop_operation operation, const T list)
     {
         assert((list.n() >= 1) && (list.n() <= 511));
-        obj.emit16((to_underlying(operation) << 9) | list.n());
+        obj.emit_instruction16((to_underlying(operation) << 9) | list.n());
         return *this;
     }
 
     basic_divided_thumb_assembler& emit_ldmia_stmia(ldmia_stmia_operation operation, const writeback_low_reg rn, const low_reg_list list)
     {
         assert((list.n() >= 1) && (list.n() <= 255));
-        obj.emit16((to_underlying(operation) << 11) | (rn.n() << 8) | list.n());
+        obj.emit_instruction16((to_underlying(operation) << 11) | (rn.n() << 8) | list.n());
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_sp_relative_load_store(bool is_load, const low_reg rd_rs, const immediate& imm10)
+    basic_divided_thumb_assembler& emit_sp_relative_load_store(bool is_load, const low_reg rd_rs, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
-        auto imm = to_abs(reference_type::abs10, imm10);
-        obj.emit16((0b1001 << 12) | (is_load << 11) | (rd_rs.n() << 8) | (imm / 4));
+        auto imm = to_abs<reference_type::abs10>(imm10);
+        obj.emit_instruction16((0b1001 << 12) | (is_load << 11) | (rd_rs.n() << 8) | (imm / 4));
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_load_store_byte(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate& imm5)
+    basic_divided_thumb_assembler& emit_load_store_byte(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate_operand<detail::reference_type::abs5>& imm5)
     {
-        auto imm = to_abs(reference_type::abs5, imm5);
-        obj.emit16((0b0111 << 12) | (is_load << 11) | (imm << 6) | (rn.n() << 3) | rd_rs.n());
+        auto imm = to_abs<reference_type::abs5>(imm5);
+        obj.emit_instruction16((0b0111 << 12) | (is_load << 11) | (imm << 6) | (rn.n() << 3) | rd_rs.n());
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_load_store_halfword(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate& imm6)
+    basic_divided_thumb_assembler& emit_load_store_halfword(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate_operand<detail::reference_type::abs6>& imm6)
     {
-        auto imm = to_abs(reference_type::abs6, imm6);
-        obj.emit16((0b1000 << 12) | (is_load << 11) | ((imm / 2) << 6) | (rn.n() << 3) | rd_rs.n());
+        auto imm = to_abs<reference_type::abs6>(imm6);
+        obj.emit_instruction16((0b1000 << 12) | (is_load << 11) | ((imm / 2) << 6) | (rn.n() << 3) | rd_rs.n());
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_load_store_word(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate& imm7)
+    basic_divided_thumb_assembler& emit_load_store_word(bool is_load, const low_reg rd_rs, const low_reg rn, const immediate_operand<detail::reference_type::abs7>& imm7)
     {
-        auto imm = to_abs(reference_type::abs7, imm7);
-        obj.emit16((0b0110 << 12) | (is_load << 11) | ((imm / 4) << 6) | (rn.n() << 3) | rd_rs.n());
+        auto imm = to_abs<reference_type::abs7>(imm7);
+        obj.emit_instruction16((0b0110 << 12) | (is_load << 11) | ((imm / 4) << 6) | (rn.n() << 3) | rd_rs.n());
         return *this;
     }
 
-    basic_divided_thumb_assembler& emit_load_address(bool is_sp, const low_reg rd, const immediate& imm10)
+    basic_divided_thumb_assembler& emit_load_address(bool is_sp, const low_reg rd, const immediate_operand<detail::reference_type::abs10>& imm10)
     {
-        auto imm = to_abs(reference_type::abs10, imm10);
-        obj.emit16((0b1010 << 12) | (is_sp << 11) | (rd.n() << 8) | (imm / 4));
+        auto imm = to_abs<reference_type::abs10>(imm10);
+        obj.emit_instruction16((0b1010 << 12) | (is_sp << 11) | (rd.n() << 8) | (imm / 4));
         return *this;
     }
 
     basic_divided_thumb_assembler& emit_conditional_branch(condition_code cc, const immediate& imm9)
     {
         obj.add_reference(reference_type::conditional_branch, imm9);
-        obj.emit16((0b1101 << 12) | (to_underlying(cc) << 8) | dummy_value);
+        obj.emit_instruction16((0b1101 << 12) | (to_underlying(cc) << 8) | dummy_value);
         return *this;
     }
 
-    constexpr immediate_t to_abs(reference_type type, const immediate& imm)
+    basic_divided_thumb_assembler& emit_add_imm(const low_reg rx, uint32_t addend, const std::optional<low_reg> scratch)
     {
-        const auto& d = detail::reference_type_descriptors::get(type);
+        if (addend == 0)
+        {
+            return *this;
+        }
 
-        if (imm.is_symbol_reference())
+        detail::cheapest_expansion expansion(goal);
+        auto chain_length = get_chain_length(addend, max_add_sub_imm8);
+        if (chain_length <= max_chain_length)
         {
-            obj.add_reference(d.type, imm);
-            return 0;
+            expansion.consider(detail::alu_instruction_cost * chain_length, [=, this] { emit_add_sub_imm8_chain(rx, addend); });
+        }
+
+        if (scratch)
+        {
+            if (!check_scratch_register(*scratch, rx))
+            {
+                return *this;
+            }
+            consider_constant(expansion, *scratch, addend, detail::alu_instruction_cost, [=, this] { add(rx, rx, *scratch); });
+            consider_constant(expansion, *scratch, 0u - addend, detail::alu_instruction_cost, [=, this] { sub(rx, rx, *scratch); });
         }
 
-        auto i = imm.value();
-        i = detail::check_immediate_range(i, d.min, d.max);
-        i = detail::check_immediate_is_aligned(i, d.alignment);
-        return i;
+        return emit_cheapest(expansion);
     }
 
-    template <typename TOp, typename TImm>
-    static constexpr void invert_if_negative(TOp& operation, TImm& imm)
+    basic_divided_thumb_assembler& emit_add_sp_imm(uint32_t addend, const std::optional<low_reg> scratch)
     {
-        if (imm < 0)
+        if (addend & 3)
+        {
+            report("Misaligned immediate value");
+            return *this;
+        }
+        if (addend == 0)
+        {
+            return *this;
+        }
+
+        detail::cheapest_expansion expansion(goal);
+        auto chain_length = get_chain_length(addend, max_add_sub_sp_imm9);
+        if (chain_length <= max_chain_length)
+        {
+            expansion.consider(detail::alu_instruction_cost * chain_length, [=, this] { emit_add_sub_sp_imm9_chain(addend); });
+        }
+
+        if (scratch)
+        {
+            // add sp, rm is a high register operation, which does not modify the flags.
+            consider_constant(expansion, *scratch, addend, detail::alu_instruction_cost, [=, this] { add(sp, *scratch); });
+        }
+
+        return emit_cheapest(expansion);
+    }
+
+    basic_divided_thumb_assembler& emit_add_rd_sp_imm(const low_reg rd, uint32_t addend)
+    {
+        constexpr auto max_imm10 = 0xff * 4;
+        if ((addend <= max_imm10) && ((addend & 3) == 0))
+        {
+            return add(rd, sp, static_cast<immediate_t>(addend));
+        }
+
+        // add rd, sp, #base followed by add/sub rd, #imm8 instructions.
+        detail::cheapest_expansion expansion(goal);
+        auto base = addend < 0x80000000 ? std::min(addend & ~3u, static_cast<uint32_t>(max_imm10)) : 0u;
+        auto chain_length = get_chain_length(addend - base, max_add_sub_imm8);
+        expansion.consider(detail::alu_instruction_cost * (chain_length + 1), [=, this]
+        {
+            add(rd, sp, static_cast<immediate_t>(base));
+            emit_add_sub_imm8_chain(rd, addend - base);
+        });
+
+        // Build the constant in rd, then add sp.
+        consider_constant(expansion, rd, addend, detail::alu_instruction_cost, [=, this] { add(rd, sp); });
+
+        return emit_cheapest(expansion);
+    }
+
+    basic_divided_thumb_assembler& emit_cmp_imm(const low_reg rn, uint32_t value, const std::optional<low_reg> scratch)
+    {
+        if (value <= 0xff)
+        {
+            return cmp(rn, static_cast<immediate_t>(value));
+        }
+
+        if (!scratch)
+        {
+            report("Immediate value requires a scratch register");
+            return *this;
+        }
+        if (!check_scratch_register(*scratch, rn))
+        {
+            return *this;
+        }
+
+        detail::cheapest_expansion expansion(goal);
+        consider_constant(expansion, *scratch, value, detail::alu_instruction_cost, [=, this] { cmp(rn, *scratch); });
+
+        // cmn rn, -value sets the same flags as cmp rn, value, except for 0 and 0x80000000.
+        if (value != 0x80000000)
+        {
+            consider_constant(expansion, *scratch, 0u - value, detail::alu_instruction_cost, [=, this] { cmn(rn, *scratch); });
+        }
+
+        return emit_cheapest(expansion);
+    }
+
+    basic_divided_thumb_assembler& emit_mul_const(const low_reg rd, const low_reg rs, uint32_t k, const std::optional<low_reg> scratch)
+    {
+        if (scratch && (!check_scratch_register(*scratch, rd) || !check_scratch_register(*scratch, rs)))
+        {
+            return *this;
+        }
+
+        detail::cheapest_expansion expansion(goal);
+        auto consider_chain = [&](detail::multiplication_chain_search search, const low_reg x, bool copy_x)
+        {
+            if (auto chain = search.find(k))
+            {
+                auto length = static_cast<unsigned>(chain->size()) + (copy_x ? 1 : 0);
+                expansion.consider(detail::alu_instruction_cost * length, [=, this, chain = *chain]
+                {
+                    if (copy_x)
+                    {
+                        mov(x, rs);
+                    }
+                    emit_multiplication_chain(chain, rd, x, scratch.value_or(rd));
+                });
+            }
+        };
+
+        if (rd.n() != rs.n())
+        {
+            consider_chain(detail::multiplication_chain_search(true, scratch.has_value(), false), rs, false);
+
+            // mul rd, rs: the multiplier is k, so its cycle count is known.
+            consider_constant(expansion, rd, k, detail::multiply_cost(k), [=, this] { mul(rd, rs); });
+        }
+        else
+        {
+            consider_chain(detail::multiplication_chain_search(false, scratch.has_value(), true), rd, false);
+            if (scratch)
+            {
+                // Keep a copy of the multiplicand in the scratch register.
+                consider_chain(detail::multiplication_chain_search(true, false, true), *scratch, true);
+                consider_constant(expansion, *scratch, k, detail::worst_case_multiply_cost, [=, this] { mul(rd, *scratch); });
+            }
+        }
+
+        return emit_cheapest(expansion);
+    }
+
+    void emit_multiplication_chain(const detail::multiplication_chain& chain, const low_reg rd, const low_reg x, const low_reg t)
+    {
+        using chain_operand = ::lzasm::arm::arm32::detail::chain_operand;
+        using chain_operation = ::lzasm::arm::arm32::detail::chain_operation;
+
+        auto get_reg = [&](chain_operand operand)
+        {
+            switch (operand)
+            {
+                case chain_operand::x:
+                    return x;
+                case chain_operand::t:
+                    return t;
+                default:
+                    return rd;
+            }
+        };
+
+        for (const auto& step : chain)
+        {
+            auto dst = get_reg(step.dst);
+            auto a = get_reg(step.a);
+            auto b = get_reg(step.b);
+            switch (step.operation)
+            {
+                case chain_operation::mov:
+                    mov(dst, a);
+                    break;
+                case chain_operation::mov_zero:
+                    mov(dst, 0);
+                    break;
+                case chain_operation::lsl:
+                    lsl(dst, a, static_cast<immediate_t>(step.shift));
+                    break;
+                case chain_operation::add:
+                    add(dst, a, b);
+                    break;
+                case chain_operation::sub:
+                    sub(dst, a, b);
+                    break;
+                case chain_operation::neg:
+                    neg(dst, a);
+                    break;
+            }
+        }
+    }
+
+    basic_divided_thumb_assembler& emit_udiv_const(const low_reg rd, const low_reg rn, uint32_t d, const std::optional<low_reg> scratch)
+    {
+        if (!check_division_operands(rd, rn, d, scratch))
+        {
+            return *this;
+        }
+
+        if (std::has_single_bit(d))
+        {
+            return lsr(rd, rn, std::countr_zero(d));
+        }
+
+        if (!check_reciprocal_scratch_register(rd, rn, scratch))
+        {
+            return *this;
+        }
+
+        auto magic = detail::get_unsigned_division_magic(d);
+        auto t = *scratch;
+        ldr(t, static_cast<immediate_t>(magic.multiplier));
+        enter_arm_state();
+        emit_arm_multiply_long(arm_multiply_long_operation::umull, t, rd, rn, t);
+        if (magic.add)
+        {
+            emit_arm_data_processing(arm_data_processing_operation::sub, t, rn, rd);
+            emit_arm_data_processing(arm_data_processing_operation::add, rd, rd, t, shift_operation::lsr, 1);
+        }
+        if (magic.shift)
+        {
+            emit_arm_data_processing(arm_data_processing_operation::mov, rd, rd, rd, shift_operation::lsr, magic.shift);
+        }
+        return arm_to_thumb(t);
+    }
+
+    basic_divided_thumb_assembler& emit_sdiv_const(const low_reg rd, const low_reg rn, immediate_t d, const std::optional<low_reg> scratch)
+    {
+        if (!check_division_operands(rd, rn, static_cast<uint32_t>(d), scratch))
+        {
+            return *this;
+        }
+
+        auto magnitude = get_magnitude(static_cast<uint32_t>(d));
+        if (magnitude == 1)
+        {
+            return d < 0 ? neg(rd, rn) : mov(rd, rn);
+        }
+
+        if (std::has_single_bit(magnitude))
+        {
+            if (!check_rounding_bias_register(rd, rn, scratch))
+            {
+                return *this;
+            }
+
+            // Add 2^k-1 to negative dividends, so that the arithmetic shift rounds towards zero.
+            auto t = emit_power_of_two_rounding_bias(rd, rn, magnitude, scratch);
+            asr(rd, t, std::countr_zero(magnitude));
+            return d < 0 ? neg(rd, rd) : *this;
+        }
+
+        if (!check_reciprocal_scratch_register(rd, rn, scratch))
+        {
+            return *this;
+        }
+
+        auto magic = detail::get_signed_division_magic(d);
+        auto t = *scratch;
+        ldr(t, magic.multiplier);
+        enter_arm_state();
+        emit_arm_multiply_long(arm_multiply_long_operation::smull, t, rd, rn, t);
+        if (magic.add_dividend)
+        {
+            emit_arm_data_processing(arm_data_processing_operation::add, rd, rd, rn);
+        }
+        if (magic.subtract_dividend)
+        {
+            emit_arm_data_processing(arm_data_processing_operation::sub, rd, rd, rn);
+        }
+        if (magic.shift)
+        {
+            emit_arm_data_processing(arm_data_processing_operation::mov, rd, rd, rd, shift_operation::asr, magic.shift);
+        }
+        emit_arm_data_processing(arm_data_processing_operation::add, rd, rd, rd, shift_operation::lsr, 31);
+        return arm_to_thumb(t);
+    }
+
+    basic_divided_thumb_assembler& emit_umod_const(const low_reg rd, const low_reg rn, uint32_t d, const std::optional<low_reg> scratch)
+    {
+        if (!check_division_operands(rd, rn, d, scratch))
+        {
+            return *this;
+        }
+
+        if (d == 1)
+        {
+            return mov(rd, 0);
+        }
+
+        if (std::has_single_bit(d))
+        {
+            auto shift = 32 - std::countr_zero(d);
+            lsl(rd, rn, shift);
+            return lsr(rd, rd, shift);
+        }
+
+        if (!check_reciprocal_scratch_register(rd, rn, scratch))
+        {
+            return *this;
+        }
+
+        // rd = rn - (rn / d) * d
+        emit_udiv_const(rd, rn, d, scratch);
+        emit_mul_const(rd, rd, d, scratch);
+        return sub(rd, rn, rd);
+    }
+
+    basic_divided_thumb_assembler& emit_smod_const(const low_reg rd, const low_reg rn, immediate_t d, const std::optional<low_reg> scratch)
+    {
+        if (!check_division_operands(rd, rn, static_cast<uint32_t>(d), scratch))
+        {
+            return *this;
+        }
+
+        // The sign of the remainder follows the dividend, so the sign of the divisor does not matter.
+        auto magnitude = get_magnitude(static_cast<uint32_t>(d));
+        if (magnitude == 1)
+        {
+            return mov(rd, 0);
+        }
+
+        if (std::has_single_bit(magnitude))
+        {
+            if (!check_rounding_bias_register(rd, rn, scratch))
+            {
+                return *this;
+            }
+
+            // rd = rn - ((rn + bias) & -2^k)
+            auto shift = std::countr_zero(magnitude);
+            auto t = emit_power_of_two_rounding_bias(rd, rn, magnitude, scratch);
+            lsr(t, t, shift);
+            lsl(t, t, shift);
+            return sub(rd, rn, t);
+        }
+
+        if (!check_reciprocal_scratch_register(rd, rn, scratch))
+        {
+            return *this;
+        }
+
+        // rd = rn - (rn / d) * d
+        emit_sdiv_const(rd, rn, d, scratch);
+        emit_mul_const(rd, rd, static_cast<uint32_t>(d), scratch);
+        return sub(rd, rn, rd);
+    }
+
+    // emit_power_of_two_rounding_bias() needs a scratch register if rd is the same register as rn.
+    bool check_rounding_bias_register(const low_reg rd, const low_reg rn, const std::optional<low_reg> scratch)
+    {
+        if ((rd.n() == rn.n()) && !scratch)
+        {
+            report("Immediate value requires a scratch register");
+            return false;
+        }
+        return true;
+    }
+
+    // Computes rn + (rn < 0 ? magnitude - 1 : 0), where magnitude is a power of two.
+    // The result is placed in rd, or in the scratch register if rd is the same register as rn.
+    low_reg emit_power_of_two_rounding_bias(const low_reg rd, const low_reg rn, uint32_t magnitude, const std::optional<low_reg> scratch)
+    {
+        auto t = rd.n() == rn.n() ? *scratch : rd;
+        auto shift = std::countr_zero(magnitude);
+        if (shift == 1)
+        {
+            lsr(t, rn, 31);
+        }
+        else
+        {
+            asr(t, rn, 31);
+            lsr(t, t, 32 - shift);
+        }
+        add(t, t, rn);
+        return t;
+    }
+
+    bool check_division_operands(const low_reg rd, const low_reg rn, uint32_t d, const std::optional<low_reg> scratch)
+    {
+        if (d == 0)
+        {
+            report("Division by zero");
+            return false;
+        }
+
+        return !scratch || (check_scratch_register(*scratch, rd) && check_scratch_register(*scratch, rn));
+    }
+
+    // Division by multiplication with the reciprocal loads it into the scratch register.
+    bool check_reciprocal_scratch_register(const low_reg rd, const low_reg rn, const std::optional<low_reg> scratch)
+    {
+        // smull/umull with RdHi equal to Rm is unpredictable.
+        if (rd.n() == rn.n())
+        {
+            report("Unpredictable behavior");
+            return false;
+        }
+
+        if (!scratch)
+        {
+            report("Immediate value requires a scratch register");
+            return false;
+        }
+
+        return true;
+    }
+
+    // Switches to ARM state. bx pc must be word aligned, since the halfword following it is skipped.
+    // Alignment padding, if any, executes as lsl r0, r0, #0, which modifies the flags.
+    void enter_arm_state()
+    {
+        align(2);
+        bx(pc);
+        nop();
+    }
+
+    void emit_arm_multiply_long(arm_multiply_long_operation operation, const low_reg rdlo, const low_reg rdhi, const low_reg rm, const low_reg rs)
+    {
+        obj.emit32((0xeu << 28) | (static_cast<uint32_t>(operation) << 21) | (rdhi.n() << 16) | (rdlo.n() << 12) | (rs.n() << 8) | (0b1001 << 4) | rm.n());
+        obj.add_register_writes((1u << rdlo.n()) | (1u << rdhi.n()));
+    }
+
+    // Emits operation rd, rn, rm, shift #shift_count. The condition is always AL and the flags are not set.
+    void emit_arm_data_processing(arm_data_processing_operation operation, const low_reg rd, const low_reg rn, const low_reg rm, shift_operation shift = shift_operation::lsr, uint32_t shift_count = 0)
+    {
+        // A shift count of 0 must be encoded as lsl #0, which means no shift at all.
+        auto shift_bits = shift_count ? (shift_count << 7) | (static_cast<uint32_t>(shift) << 5) : 0;
+        auto rn_bits = operation == arm_data_processing_operation::mov ? 0 : rn.n() << 16;
+        obj.emit32((0xeu << 28) | (static_cast<uint32_t>(operation) << 21) | rn_bits | (rd.n() << 12) | shift_bits | rm.n());
+        obj.add_register_writes(1u << rd.n());
+    }
+
+    detail::block_transfer_plan choose_block_transfer(block_transfer_kind kind, address_t size, const block_options& options, size_t registers) const
+    {
+        if ((options.dst_offset > 3) || (options.src_offset > 3))
+        {
+            detail::report_error("Immediate value is out of range");
+        }
+
+        auto register_count = static_cast<unsigned>(registers);
+        auto best = detail::plan_block_transfer(kind, size, options, register_count, 0);
+        auto consider = [&](unsigned unroll)
+        {
+            auto plan = detail::plan_block_transfer(kind, size, options, register_count, unroll);
+            if (plan && (!best || is_cheaper(plan->estimate(), best->estimate(), goal)))
+            {
+                best = plan;
+            }
+        };
+
+        if (options.unroll)
+        {
+            // Straight-line code is only used if the block is too small for a single loop iteration.
+            if (auto plan = detail::plan_block_transfer(kind, size, options, register_count, options.unroll))
+            {
+                return *plan;
+            }
+            return *best;
+        }
+
+        // Keep straight-line code within reasonable bounds, even when optimizing for speed.
+        if (best->remaining_elements > max_straight_line_bursts * register_count)
+        {
+            best.reset();
+        }
+
+        for (auto unroll : { 1u, 2u, 4u, 8u })
+        {
+            consider(unroll);
+        }
+
+        return best ? *best : *detail::plan_block_transfer(kind, size, options, register_count, 0);
+    }
+
+    void emit_block_transfer(const detail::block_transfer_plan& plan, const low_reg dst, const low_reg src, const std::vector<low_reg>& registers)
+    {
+        auto is_copy = plan.kind == block_transfer_kind::copy;
+        const auto& value = registers.front();
+
+        if (plan.kind == block_transfer_kind::zero)
+        {
+            mov(value, 0);
+        }
+        for (unsigned i = 1; !is_copy && (i < plan.used_registers()); ++i)
+        {
+            mov(registers[i], value);
+        }
+
+        for (auto element_size : plan.head)
+        {
+            emit_block_element_transfer(is_copy, element_size, value, dst, src, 0);
+            add(dst, static_cast<immediate_t>(element_size));
+            if (is_copy)
+            {
+                add(src, static_cast<immediate_t>(element_size));
+            }
+        }
+
+        if (plan.loop_iterations)
+        {
+            const auto& counter = registers[plan.burst_registers - 1];
+            if (auto synthesis = detail::synthesize_constant(plan.loop_iterations))
+            {
+                emit_constant_synthesis(counter, *synthesis);
+            }
+            else
+            {
+                ldr(counter, static_cast<immediate_t>(plan.loop_iterations));
+            }
+
+            auto loop = obj.create_local_label();
+            obj.define_local_label(loop);
+            for (unsigned i = 0; i < plan.unroll; ++i)
+            {
+                emit_block_burst(plan, plan.data_registers(), dst, src, registers);
+            }
+            sub(counter, 1);
+            emit_conditional_branch(condition_code::ne, loop);
+        }
+
+        for (auto remaining = plan.remaining_elements; remaining; )
+        {
+            auto n = std::min(remaining, plan.data_registers());
+            emit_block_burst(plan, n, dst, src, registers);
+            remaining -= n;
+        }
+
+        address_t offset = 0;
+        for (auto element_size : plan.tail)
+        {
+            emit_block_element_transfer(is_copy, element_size, value, dst, src, offset);
+            offset += element_size;
+        }
+
+        if (plan.function)
+        {
+            bx(lr);
+        }
+    }
+
+    void emit_block_burst(const detail::block_transfer_plan& plan, unsigned n, const low_reg dst, const low_reg src, const std::vector<low_reg>& registers)
+    {
+        if (plan.element_size == 4)
+        {
+            auto list = low_reg_list(registers.front());
+            for (unsigned i = 1; i < n; ++i)
+            {
+                list = list | low_reg_list(registers[i]);
+            }
+
+            if (plan.kind == block_transfer_kind::copy)
+            {
+                ldmia(!src, list);
+            }
+            stmia(!dst, list);
+            return;
+        }
+
+        // Bytes or halfwords of a copy whose source and destination are not equally aligned.
+        for (unsigned i = 0; i < n; ++i)
+        {
+            emit_block_element_load(plan.element_size, registers[i], src, i * plan.element_size);
+        }
+        for (unsigned i = 0; i < n; ++i)
+        {
+            emit_block_element_store(plan.element_size, registers[i], dst, i * plan.element_size);
+        }
+        add(src, static_cast<immediate_t>(n * plan.element_size));
+        add(dst, static_cast<immediate_t>(n * plan.element_size));
+    }
+
+    void emit_block_element_transfer(bool is_copy, address_t element_size, const low_reg r, const low_reg dst, const low_reg src, address_t offset)
+    {
+        if (is_copy)
+        {
+            emit_block_element_load(element_size, r, src, offset);
+        }
+        emit_block_element_store(element_size, r, dst, offset);
+    }
+
+    void emit_block_element_load(address_t element_size, const low_reg rd, const low_reg rn, address_t offset)
+    {
+        if (element_size == 1)
+        {
+            ldrb(rd, rn, static_cast<immediate_t>(offset));
+        }
+        else
+        {
+            ldrh(rd, rn, static_cast<immediate_t>(offset));
+        }
+    }
+
+    void emit_block_element_store(address_t element_size, const low_reg rs, const low_reg rn, address_t offset)
+    {
+        if (element_size == 1)
+        {
+            strb(rs, rn, static_cast<immediate_t>(offset));
+        }
+        else
+        {
+            strh(rs, rn, static_cast<immediate_t>(offset));
+        }
+    }
+
+    basic_divided_thumb_assembler& emit_conditional_branch(condition_code cc, detail::local_label_t label)
+    {
+        obj.add_local_reference(reference_type::conditional_branch, label);
+        obj.emit_instruction16((0b1101 << 12) | (to_underlying(cc) << 8) | dummy_value);
+        return *this;
+    }
+
+    basic_divided_thumb_assembler& emit_unconditional_branch(detail::local_label_t label)
+    {
+        obj.add_local_reference(reference_type::unconditional_branch, label);
+        obj.emit_instruction16(0b11100 << 11);
+        return *this;
+    }
+
+    bool check_block_transfer_registers(const low_reg_list temporaries, const low_reg dst, const low_reg src)
+    {
+        if (temporaries.contains(dst) || temporaries.contains(src))
+        {
+            report("Scratch register must differ from the other operands");
+            return false;
+        }
+        return true;
+    }
+
+    static std::vector<low_reg> to_registers(const low_reg_list list, std::vector<low_reg> registers = {})
+    {
+        for (register_number_t n = 0; n < 8; ++n)
+        {
+            if (list.contains(low_reg(n)))
+            {
+                registers.emplace_back(n);
+            }
+        }
+        return registers;
+    }
+
+    // Considers building value in rd, either inline or using a literal, followed by the instructions emitted by tail.
+    template <typename TTail>
+    void consider_constant(detail::cheapest_expansion& expansion, const low_reg rd, uint32_t value, const detail::cost& tail_cost, TTail tail)
+    {
+        if (auto synthesis = detail::synthesize_constant(value))
+        {
+            auto synthesis_cost = detail::alu_instruction_cost * static_cast<unsigned>(synthesis->count);
+            expansion.consider(synthesis_cost + tail_cost, [=, this, synthesis = *synthesis]
+            {
+                emit_constant_synthesis(rd, synthesis);
+                tail();
+            });
+        }
+
+        expansion.consider(detail::literal_load_cost + tail_cost, [=, this]
+        {
+            ldr(rd, static_cast<immediate_t>(value));
+            tail();
+        });
+    }
+
+    basic_divided_thumb_assembler& emit_cheapest(const detail::cheapest_expansion& expansion)
+    {
+        if (expansion.empty())
+        {
+            report("Immediate value requires a scratch register");
+            return *this;
+        }
+
+        if ((goal != optimization_goal::compressed_size) || (expansion.size() == 1))
+        {
+            expansion.emit();
+            return *this;
+        }
+
+        // Emit each expansion on trial, and keep the one that is estimated to compress best.
+        auto checkpoint = obj.get_checkpoint();
+        std::optional<size_t> best;
+        double best_bits = 0;
+        for (size_t i = 0; i < expansion.size(); ++i)
+        {
+            expansion.emit(i);
+            auto bits = obj.estimate_compressed_bits(checkpoint);
+            obj.rollback(checkpoint);
+            if (!best || (bits < best_bits) || ((bits == best_bits) && is_cheaper(expansion.get_cost(i), expansion.get_cost(*best), goal)))
+            {
+                best = i;
+                best_bits = bits;
+            }
+        }
+
+        expansion.emit(*best);
+        return *this;
+    }
+
+    basic_divided_thumb_assembler& emit_constant_synthesis(const low_reg rd, const detail::constant_synthesis& synthesis)
+    {
+        using synthesis_operation = ::lzasm::arm::arm32::detail::synthesis_operation;
+
+        for (const auto& step : synthesis)
+        {
+            auto imm = static_cast<immediate_t>(step.imm);
+            switch (step.operation)
+            {
+                case synthesis_operation::mov:
+                    mov(rd, imm);
+                    break;
+                case synthesis_operation::lsl:
+                    lsl(rd, rd, imm);
+                    break;
+                case synthesis_operation::mvn:
+                    mvn(rd, rd);
+                    break;
+                case synthesis_operation::add:
+                    add(rd, imm);
+                    break;
+                case synthesis_operation::sub:
+                    sub(rd, imm);
+                    break;
+            }
+        }
+
+        return *this;
+    }
+
+    void emit_add_sub_imm8_chain(const low_reg rx, uint32_t addend)
+    {
+        auto magnitude = get_magnitude(addend);
+        while (magnitude)
+        {
+            auto step = std::min(magnitude, static_cast<uint32_t>(max_add_sub_imm8));
+            if (is_negative(addend))
+            {
+                sub(rx, static_cast<immediate_t>(step));
+            }
+            else
+            {
+                add(rx, static_cast<immediate_t>(step));
+            }
+            magnitude -= step;
+        }
+    }
+
+    void emit_add_sub_sp_imm9_chain(uint32_t addend)
+    {
+        auto magnitude = get_magnitude(addend);
+        while (magnitude)
+        {
+            auto step = std::min(magnitude, static_cast<uint32_t>(max_add_sub_sp_imm9));
+            if (is_negative(addend))
+            {
+                sub(sp, static_cast<immediate_t>(step));
+            }
+            else
+            {
+                add(sp, static_cast<immediate_t>(step));
+            }
+            magnitude -= step;
+        }
+    }
+
+    bool check_scratch_register(const low_reg scratch, const low_reg r)
+    {
+        if (scratch.n() == r.n())
+        {
+            report("Scratch register must differ from the other operands");
+            return false;
+        }
+        return true;
+    }
+
+    static constexpr uint32_t negate(immediate_t imm)
+    {
+        return 0u - static_cast<uint32_t>(imm);
+    }
+
+    static constexpr bool is_negative(uint32_t addend)
+    {
+        return addend >= 0x80000000;
+    }
+
+    static constexpr uint32_t get_magnitude(uint32_t addend)
+    {
+        return is_negative(addend) ? 0u - addend : addend;
+    }
+
+    static constexpr unsigned get_chain_length(uint32_t addend, uint32_t max_step)
+    {
+        return (get_magnitude(addend) + max_step - 1) / max_step;
+    }
+
+    // Operands checked at compile time are returned as they are.
+    template <reference_type type>
+    immediate_t to_abs(const immediate_operand<type>& operand)
+    {
+        return operand.is_checked() ? operand.value().value() : to_abs<type>(operand.value());
+    }
+
+    // The type is a template argument, so that the range and alignment of the type are constants.
+    template <reference_type type>
+    immediate_t to_abs(const immediate& imm)
+    {
+        constexpr const auto& d = detail::reference_type_descriptors::get<type>();
+
+        immediate_t value = 0;
+        if (imm.is_constant())
+        {
+            value = imm.value();
+        }
+        else
+        {
+            auto resolved = obj.resolve_constants(imm);
+            if (!resolved.is_constant())
+            {
+                obj.add_reference(type, resolved);
+                return 0;
+            }
+            value = resolved.value();
+        }
+
+        if ((value < d.min) || (value > d.max))
+        {
+            report("Immediate value is out of range");
+            return 0;
+        }
+        if (value & (detail::get_byte_alignment(d.alignment) - 1))
+        {
+            report("Misaligned immediate value");
+            return 0;
+        }
+        return value;
+    }
+
+    // Reports an error of an operand at the location counter. Policies that do not throw
+    // return, and the instruction is emitted as if the operand were zero.
+    void report(const char* message)
+    {
+        obj.report(obj.current_lc(), message);
+    }
+
+    template <typename TOp, typename TImm>
+    static constexpr void invert_if_negative(TOp& operation, TImm& imm)
+    {
+        if (imm < 0)
         {
             operation = ::lzasm::arm::arm32::detail::invert_operation(operation);
             imm = abs(imm);
@@ -780,8 +2128,29 @@ private:
         return (registers.is_low() && ...);
     }
 
+    // Longest sequence of add/sub instructions an arbitrary immediate pseudo instruction generates.
+    static constexpr unsigned max_chain_length = 8;
+
+    // Longest sequence of bursts a block transfer generates without a loop, unless a fixed unroll factor is requested.
+    static constexpr unsigned max_straight_line_bursts = 64;
+    static constexpr auto max_add_sub_imm8 = 0xff;
+    static constexpr auto max_add_sub_sp_imm9 = 0x7f * 4;
+
+    // The bounds check of switch_table compares with an 8 bit immediate.
+    static constexpr size_t max_switch_table_entries = 256;
+    static constexpr address_t max_conditional_branch_offset = 0x7f * 2;
     static constexpr auto dummy_value = 0;
+    class cold_block final
+    {
+    public:
+        symbol<TSymbolName> label;
+        detail::local_label_t resume;
+        std::function<void()> emitter;
+    };
+
+    optimization_goal goal = optimization_goal::size;
     object obj;
+    std::vector<cold_block> cold_blocks;
 };
 
 using divided_thumb_assembler = basic_divided_thumb_assembler<std::string>;
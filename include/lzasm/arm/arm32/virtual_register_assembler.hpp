@@ -0,0 +1,518 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#ifndef LZASM_ARM_ARM32_VIRTUAL_REGISTER_ASSEMBLER_HPP_INCLUDED
+#define LZASM_ARM_ARM32_VIRTUAL_REGISTER_ASSEMBLER_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "lzasm/arm/arm32/detail/register_allocator.hpp"
+
+namespace lzasm::arm::arm32
+{
+
+// Virtual low register. Virtual registers are created by a virtual_register_assembler,
+// which assigns them to physical registers when the routine is emitted.
+class vreg final
+{
+public:
+    explicit constexpr vreg(size_t id) : m_id(id) {}
+
+    constexpr size_t id() const { return m_id; }
+
+private:
+    size_t m_id;
+};
+
+// Operand of a virtual_register_assembler instruction: a virtual register or a physical low register.
+class vreg_operand final
+{
+public:
+    constexpr vreg_operand(const vreg v) : m_value(v.id() + detail::physical_register_count) {}
+
+    constexpr vreg_operand(const low_reg r) : m_value(r.n()) {}
+
+    constexpr size_t value() const { return m_value; }
+
+private:
+    size_t m_value;
+};
+
+// Records a routine that uses virtual registers, and emits it into a divided_thumb_assembler.
+// emit() computes liveness across labels and branches, assigns physical registers with a
+// linear scan allocator and spills to stack slots if registers run out.
+// Physical registers can be used as operands too, e.g. to pass arguments and results.
+template <typename TSymbolName>
+class basic_virtual_register_assembler final
+{
+public:
+    using assembler = basic_divided_thumb_assembler<TSymbolName>;
+    using immediate = detail::immediate<TSymbolName>;
+
+    // Virtual registers are only assigned to the registers in allocatable.
+    explicit basic_virtual_register_assembler(const low_reg_list allocatable = r0 - r7)
+        : allocatable(allocatable.n()) {}
+
+    vreg create_vreg()
+    {
+        return vreg(vreg_count++);
+    }
+
+    // Allocates registers and emits the routine.
+    // Spill slots are allocated on the stack when the routine is entered and released by ret().
+    // If the routine calls other routines, lr is pushed on entry and ret() returns with pop {pc}.
+    void emit(assembler& a) const
+    {
+        std::vector<detail::allocation_instruction> allocation_instructions;
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            allocation_instructions.push_back(get_allocation_instruction(i));
+        }
+
+        auto value_count = detail::physical_register_count + vreg_count;
+        auto allocation = detail::linear_scan_allocator(allocation_instructions, value_count).allocate(allocatable);
+
+        auto frame_size = static_cast<immediate_t>(allocation.slot_count * 4);
+        auto has_calls = std::any_of(
+            instructions.begin(), instructions.end(),
+            [](const instruction& i) { return i.kind == instruction_kind::call; });
+        if (has_calls)
+        {
+            a.push(lr);
+        }
+        if (frame_size)
+        {
+            a.sub_imm(sp, frame_size);
+        }
+
+        for (size_t index = 0; index < instructions.size(); ++index)
+        {
+            // Spilled operands are loaded into a register before the instruction and stored afterwards.
+            const auto& i = instructions[index];
+            const auto& spilled = allocation.spill_registers[index];
+            std::vector<register_number_t> registers;
+            for (auto value : i.operands)
+            {
+                if (value < detail::physical_register_count)
+                {
+                    registers.push_back(static_cast<register_number_t>(value));
+                }
+                else if (allocation.registers[value])
+                {
+                    registers.push_back(*allocation.registers[value]);
+                }
+                else
+                {
+                    auto p = std::find_if(spilled.begin(), spilled.end(), [&](const auto& s) { return s.first == value; });
+                    registers.push_back(p->second);
+                }
+            }
+
+            auto access = [&](size_t value, unsigned mask)
+            {
+                bool result = false;
+                for (size_t k = 0; k < i.operands.size(); ++k)
+                {
+                    result = result || ((i.operands[k] == value) && (mask & (1u << k)));
+                }
+                return result;
+            };
+            auto slot_offset = [&](size_t value) { return static_cast<immediate_t>(*allocation.slots[value] * 4); };
+
+            for (const auto& [value, r] : spilled)
+            {
+                if (access(value, i.uses))
+                {
+                    a.ldr(low_reg(r), sp, slot_offset(value));
+                }
+            }
+
+            if (i.kind == instruction_kind::exit)
+            {
+                if (frame_size)
+                {
+                    a.add_imm(sp, frame_size);
+                }
+                if (has_calls)
+                {
+                    a.pop(pc);
+                }
+                else
+                {
+                    a.bx(lr);
+                }
+            }
+            else if ((i.kind != instruction_kind::move) || (registers[0] != registers[1]))
+            {
+                i.emit(a, registers);
+            }
+
+            for (const auto& [value, r] : spilled)
+            {
+                if (access(value, i.defs))
+                {
+                    a.str(low_reg(r), sp, slot_offset(value));
+                }
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Labels and control flow
+    ////////////////////////////////////////////////////////////////////////////
+
+    basic_virtual_register_assembler& label(const symbol<TSymbolName>& s)
+    {
+        if (!labels.insert(std::make_pair(s, instructions.size())).second)
+        {
+            detail::report_error("Symbol is already defined");
+        }
+        return add_instruction(instruction_kind::label, {}, 0, 0, [=](assembler& a, const auto&) { a.label(s); }, s);
+    }
+
+    basic_virtual_register_assembler& b(const symbol<TSymbolName>& target)
+    {
+        return add_instruction(instruction_kind::branch, {}, 0, 0, [=](assembler& a, const auto&) { a.b(target); }, target);
+    }
+
+    basic_virtual_register_assembler& beq(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::beq, target); }
+    basic_virtual_register_assembler& bne(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bne, target); }
+    basic_virtual_register_assembler& bcs(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bcs, target); }
+    basic_virtual_register_assembler& bcc(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bcc, target); }
+    basic_virtual_register_assembler& bmi(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bmi, target); }
+    basic_virtual_register_assembler& bpl(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bpl, target); }
+    basic_virtual_register_assembler& bvs(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bvs, target); }
+    basic_virtual_register_assembler& bvc(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bvc, target); }
+    basic_virtual_register_assembler& bhi(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bhi, target); }
+    basic_virtual_register_assembler& bls(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bls, target); }
+    basic_virtual_register_assembler& bge(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bge, target); }
+    basic_virtual_register_assembler& blt(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::blt, target); }
+    basic_virtual_register_assembler& bgt(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::bgt, target); }
+    basic_virtual_register_assembler& ble(const symbol<TSymbolName>& target) { return add_conditional_branch(&assembler::ble, target); }
+    basic_virtual_register_assembler& bhs(const symbol<TSymbolName>& target) { return bcs(target); }
+    basic_virtual_register_assembler& blo(const symbol<TSymbolName>& target) { return bcc(target); }
+
+    // Calls a routine that takes no arguments in registers. r0 to r3 are assumed to be destroyed.
+    basic_virtual_register_assembler& bl(const immediate& target)
+    {
+        return add_call(target, {});
+    }
+
+    // Calls a routine that takes arguments in the given registers. r0 to r3 are assumed to be destroyed.
+    basic_virtual_register_assembler& bl(const immediate& target, const low_reg_list arguments)
+    {
+        return add_call(target, get_operands(arguments));
+    }
+
+    // Returns from the routine.
+    basic_virtual_register_assembler& ret()
+    {
+        return add_instruction(instruction_kind::exit, {}, 0, 0, nullptr);
+    }
+
+    // Returns from the routine with results in the given registers.
+    basic_virtual_register_assembler& ret(const low_reg_list results)
+    {
+        auto operands = get_operands(results);
+        return add_instruction(instruction_kind::exit, operands, get_mask(operands.size()), 0, nullptr);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Instructions
+    ////////////////////////////////////////////////////////////////////////////
+
+    basic_virtual_register_assembler& adc(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::adc, rx, rm, true); }
+    basic_virtual_register_assembler& and_(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::and_, rx, rm, true); }
+    basic_virtual_register_assembler& asr(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::asr, rx, rm, true); }
+    basic_virtual_register_assembler& bic(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::bic, rx, rm, true); }
+    basic_virtual_register_assembler& cmn(const vreg_operand rx, const vreg_operand rm) { return add_compare(&assembler::cmn, rx, rm); }
+    basic_virtual_register_assembler& cmp(const vreg_operand rx, const vreg_operand rm) { return add_compare(&assembler::cmp, rx, rm); }
+    basic_virtual_register_assembler& eor(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::eor, rx, rm, true); }
+    basic_virtual_register_assembler& lsl(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::lsl, rx, rm, true); }
+    basic_virtual_register_assembler& lsr(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::lsr, rx, rm, true); }
+    basic_virtual_register_assembler& mul(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::mul, rx, rm, true); }
+    basic_virtual_register_assembler& mvn(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::mvn, rx, rm, false); }
+    basic_virtual_register_assembler& neg(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::neg, rx, rm, false); }
+    basic_virtual_register_assembler& orr(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::orr, rx, rm, true); }
+    basic_virtual_register_assembler& ror(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::ror, rx, rm, true); }
+    basic_virtual_register_assembler& sbc(const vreg_operand rx, const vreg_operand rm) { return add_alu_operation(&assembler::sbc, rx, rm, true); }
+    basic_virtual_register_assembler& tst(const vreg_operand rx, const vreg_operand rm) { return add_compare(&assembler::tst, rx, rm); }
+
+    basic_virtual_register_assembler& add(const vreg_operand rx, const immediate& imm8)
+    {
+        return add_instruction(instruction_kind::ordinary, { rx.value() }, 0b1, 0b1, [=](assembler& a, const auto& r) { a.add(low_reg(r[0]), imm8); });
+    }
+
+    basic_virtual_register_assembler& add(const vreg_operand rd, const vreg_operand rn, const immediate& imm3)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.add(low_reg(r[0]), low_reg(r[1]), imm3); });
+    }
+
+    basic_virtual_register_assembler& add(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.add(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& asr(const vreg_operand rd, const vreg_operand rn, const immediate& imm5)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.asr(low_reg(r[0]), low_reg(r[1]), imm5); });
+    }
+
+    basic_virtual_register_assembler& cmp(const vreg_operand rn, const immediate& imm8)
+    {
+        return add_instruction(instruction_kind::ordinary, { rn.value() }, 0b1, 0, [=](assembler& a, const auto& r) { a.cmp(low_reg(r[0]), imm8); });
+    }
+
+    basic_virtual_register_assembler& ldr(const vreg_operand rd, const vreg_operand rn, const immediate& imm7)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.ldr(low_reg(r[0]), low_reg(r[1]), imm7); });
+    }
+
+    basic_virtual_register_assembler& ldr(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.ldr(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& ldr(const vreg_operand rd, const immediate& imm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value() }, 0, 0b1, [=](assembler& a, const auto& r) { a.ldr(low_reg(r[0]), imm); });
+    }
+
+    basic_virtual_register_assembler& ldrb(const vreg_operand rd, const vreg_operand rn, const immediate& imm5)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.ldrb(low_reg(r[0]), low_reg(r[1]), imm5); });
+    }
+
+    basic_virtual_register_assembler& ldrb(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.ldrb(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& ldrh(const vreg_operand rd, const vreg_operand rn, const immediate& imm6)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.ldrh(low_reg(r[0]), low_reg(r[1]), imm6); });
+    }
+
+    basic_virtual_register_assembler& ldrh(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.ldrh(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& ldrsb(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.ldrsb(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& ldrsh(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.ldrsh(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& lsl(const vreg_operand rd, const vreg_operand rn, const immediate& imm5)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.lsl(low_reg(r[0]), low_reg(r[1]), imm5); });
+    }
+
+    basic_virtual_register_assembler& lsr(const vreg_operand rd, const vreg_operand rn, const immediate& imm5)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.lsr(low_reg(r[0]), low_reg(r[1]), imm5); });
+    }
+
+    basic_virtual_register_assembler& mov(const vreg_operand rd, const immediate& imm8)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value() }, 0, 0b1, [=](assembler& a, const auto& r) { a.mov(low_reg(r[0]), imm8); });
+    }
+
+    // Unlike mov with two low registers, this does not set the flags reliably,
+    // since it is not emitted at all if both operands are assigned the same register.
+    basic_virtual_register_assembler& mov(const vreg_operand rd, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::move, { rd.value(), rm.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.mov(low_reg(r[0]), low_reg(r[1])); });
+    }
+
+    basic_virtual_register_assembler& str(const vreg_operand rs, const vreg_operand rn, const immediate& imm7)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value() }, 0b11, 0, [=](assembler& a, const auto& r) { a.str(low_reg(r[0]), low_reg(r[1]), imm7); });
+    }
+
+    basic_virtual_register_assembler& str(const vreg_operand rs, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value(), rm.value() }, 0b111, 0, [=](assembler& a, const auto& r) { a.str(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& strb(const vreg_operand rs, const vreg_operand rn, const immediate& imm5)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value() }, 0b11, 0, [=](assembler& a, const auto& r) { a.strb(low_reg(r[0]), low_reg(r[1]), imm5); });
+    }
+
+    basic_virtual_register_assembler& strb(const vreg_operand rs, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value(), rm.value() }, 0b111, 0, [=](assembler& a, const auto& r) { a.strb(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& strh(const vreg_operand rs, const vreg_operand rn, const immediate& imm6)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value() }, 0b11, 0, [=](assembler& a, const auto& r) { a.strh(low_reg(r[0]), low_reg(r[1]), imm6); });
+    }
+
+    basic_virtual_register_assembler& strh(const vreg_operand rs, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rs.value(), rn.value(), rm.value() }, 0b111, 0, [=](assembler& a, const auto& r) { a.strh(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+    basic_virtual_register_assembler& sub(const vreg_operand rx, const immediate& imm8)
+    {
+        return add_instruction(instruction_kind::ordinary, { rx.value() }, 0b1, 0b1, [=](assembler& a, const auto& r) { a.sub(low_reg(r[0]), imm8); });
+    }
+
+    basic_virtual_register_assembler& sub(const vreg_operand rd, const vreg_operand rn, const immediate& imm3)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value() }, 0b10, 0b01, [=](assembler& a, const auto& r) { a.sub(low_reg(r[0]), low_reg(r[1]), imm3); });
+    }
+
+    basic_virtual_register_assembler& sub(const vreg_operand rd, const vreg_operand rn, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rd.value(), rn.value(), rm.value() }, 0b110, 0b001, [=](assembler& a, const auto& r) { a.sub(low_reg(r[0]), low_reg(r[1]), low_reg(r[2])); });
+    }
+
+private:
+    enum class instruction_kind
+    {
+        ordinary,
+        move,
+        label,
+        branch,
+        conditional_branch,
+        call,
+        exit
+    };
+
+    using emitter = std::function<void(assembler&, const std::vector<register_number_t>&)>;
+
+    class instruction final
+    {
+    public:
+        instruction_kind kind;
+
+        // Values are physical register numbers below physical_register_count, else virtual register numbers.
+        std::vector<size_t> operands;
+
+        // Bit k is set if operand k is read or written.
+        unsigned uses;
+        unsigned defs;
+
+        emitter emit;
+        std::optional<symbol<TSymbolName>> target;
+    };
+
+    basic_virtual_register_assembler& add_instruction(instruction_kind kind, std::vector<size_t> operands, unsigned uses, unsigned defs, emitter emit, std::optional<symbol<TSymbolName>> target = std::nullopt)
+    {
+        instructions.push_back(instruction{ kind, std::move(operands), uses, defs, std::move(emit), std::move(target) });
+        return *this;
+    }
+
+    basic_virtual_register_assembler& add_alu_operation(assembler& (assembler::*operation)(const low_reg, const low_reg), const vreg_operand rx, const vreg_operand rm, bool reads_rx)
+    {
+        return add_instruction(instruction_kind::ordinary, { rx.value(), rm.value() }, reads_rx ? 0b11 : 0b10, 0b01, [=](assembler& a, const auto& r) { (a.*operation)(low_reg(r[0]), low_reg(r[1])); });
+    }
+
+    basic_virtual_register_assembler& add_compare(assembler& (assembler::*operation)(const low_reg, const low_reg), const vreg_operand rx, const vreg_operand rm)
+    {
+        return add_instruction(instruction_kind::ordinary, { rx.value(), rm.value() }, 0b11, 0, [=](assembler& a, const auto& r) { (a.*operation)(low_reg(r[0]), low_reg(r[1])); });
+    }
+
+    basic_virtual_register_assembler& add_conditional_branch(assembler& (assembler::*branch)(const immediate&), const symbol<TSymbolName>& target)
+    {
+        return add_instruction(instruction_kind::conditional_branch, {}, 0, 0, [=](assembler& a, const auto&) { (a.*branch)(target); }, target);
+    }
+
+    basic_virtual_register_assembler& add_call(const immediate& target, std::vector<size_t> arguments)
+    {
+        // The callee may destroy r0 to r3, which are listed after the arguments.
+        auto uses = get_mask(arguments.size());
+        auto defs = get_mask(4) << arguments.size();
+        for (size_t n = 0; n < 4; ++n)
+        {
+            arguments.push_back(n);
+        }
+        return add_instruction(instruction_kind::call, std::move(arguments), uses, defs, [=](assembler& a, const auto&) { a.bl(target); });
+    }
+
+    detail::allocation_instruction get_allocation_instruction(size_t index) const
+    {
+        const auto& i = instructions[index];
+        detail::allocation_instruction result;
+        for (size_t k = 0; k < i.operands.size(); ++k)
+        {
+            if (i.uses & (1u << k))
+            {
+                result.uses.push_back(i.operands[k]);
+            }
+            if (i.defs & (1u << k))
+            {
+                result.defs.push_back(i.operands[k]);
+            }
+        }
+
+        if ((i.kind != instruction_kind::branch) && (i.kind != instruction_kind::exit) && (index + 1 < instructions.size()))
+        {
+            result.successors.push_back(index + 1);
+        }
+        if (i.target && (i.kind != instruction_kind::label))
+        {
+            auto label = labels.find(*i.target);
+            if (label == labels.end())
+            {
+                detail::report_error("Branch target is not a label of the routine");
+            }
+            result.successors.push_back(label->second);
+        }
+
+        result.is_move = i.kind == instruction_kind::move;
+        if (result.is_move)
+        {
+            // The allocator expects the source first.
+            result.uses = { i.operands[1] };
+            result.defs = { i.operands[0] };
+        }
+
+        return result;
+    }
+
+    static std::vector<size_t> get_operands(const low_reg_list list)
+    {
+        std::vector<size_t> operands;
+        for (size_t n = 0; n < detail::physical_register_count; ++n)
+        {
+            if (list.n() & (1 << n))
+            {
+                operands.push_back(n);
+            }
+        }
+        return operands;
+    }
+
+    static constexpr unsigned get_mask(size_t operand_count)
+    {
+        return (1u << operand_count) - 1;
+    }
+
+    unsigned allocatable;
+    size_t vreg_count = 0;
+    std::vector<instruction> instructions;
+    std::map<symbol<TSymbolName>, size_t> labels;
+};
+
+using virtual_register_assembler = basic_virtual_register_assembler<std::string>;
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include "lzasm/arm/arm32/detail/compression_estimator.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using ::lzasm::arm::arm32::detail::estimate_compressed_bits;
+
+BOOST_AUTO_TEST_SUITE(compression_estimator_test)
+
+    BOOST_AUTO_TEST_CASE(nothing_costs_nothing)
+    {
+        auto bytes = B(1, 2, 3);
+        BOOST_CHECK_EQUAL(0, estimate_compressed_bits(bytes, 3, 3));
+    }
+
+    BOOST_AUTO_TEST_CASE(repetitions_are_cheaper_than_new_bytes)
+    {
+        auto repeated = B(0x12, 0x34, 0x56, 0x78, 0x12, 0x34, 0x56, 0x78);
+        auto distinct = B(0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0);
+        BOOST_TEST(estimate_compressed_bits(repeated, 4, 8) < estimate_compressed_bits(distinct, 4, 8));
+    }
+
+    BOOST_AUTO_TEST_CASE(near_matches_are_cheaper_than_far_matches)
+    {
+        auto near = B(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x12, 0x34, 0x56, 0x12, 0x34, 0x56);
+        auto far = B(0x12, 0x34, 0x56, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x12, 0x34, 0x56);
+        BOOST_TEST(estimate_compressed_bits(near, 15, 18) < estimate_compressed_bits(far, 15, 18));
+    }
+
+    BOOST_AUTO_TEST_CASE(literals_are_cheaper_if_they_are_frequent)
+    {
+        auto frequent = B(1, 7, 1, 7, 1, 7, 1, 7, 8, 1);
+        auto rare = B(1, 7, 1, 7, 1, 7, 1, 7, 8, 2);
+        BOOST_TEST(estimate_compressed_bits(frequent, 9, 10) < estimate_compressed_bits(rare, 9, 10));
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include "lzasm/arm/arm32/detail/constant_synthesis.hpp"
+
+namespace lzasm_unittest
+{
+
+using ::lzasm::arm::arm32::detail::synthesize_constant;
+
+BOOST_AUTO_TEST_SUITE(constant_synthesis_test)
+
+    BOOST_AUTO_TEST_CASE(single_instruction)
+    {
+        auto synthesis = synthesize_constant(42);
+        BOOST_REQUIRE(synthesis.has_value());
+        BOOST_TEST(1u == synthesis->count);
+        BOOST_TEST(2u == synthesis->size());
+        BOOST_TEST(0x202a == synthesis->steps[0].opcode(0));
+    }
+
+    BOOST_AUTO_TEST_CASE(maximum_number_of_instructions_is_respected)
+    {
+        BOOST_TEST(synthesize_constant(0x03000000, 2).has_value());
+        BOOST_TEST(!synthesize_constant(0x03000000, 1).has_value());
+        BOOST_TEST(synthesize_constant(0x1234, 3).has_value());
+        BOOST_TEST(!synthesize_constant(0x1234, 2).has_value());
+    }
+
+    BOOST_AUTO_TEST_CASE(unsupported_value)
+    {
+        BOOST_TEST(!synthesize_constant(0x12345678).has_value());
+    }
+
+    BOOST_AUTO_TEST_CASE(sequences_build_the_requested_value)
+    {
+        const uint32_t values[] =
+        {
+            0, 1, 0xff, 0x100, 0x1fe, 0x1ff, 0x2fd, 0x2fe, 0x1234, 0xff00, 0x10000, 0x12200,
+            0x80000000, 0xff000000, 0x7fffffff, 0xfffff000, 0xfffffe02, 0xfffffe01, 0xffffff00, 0xffffffff
+        };
+
+        for (auto value : values)
+        {
+            auto synthesis = synthesize_constant(value);
+            BOOST_REQUIRE(synthesis.has_value());
+            BOOST_TEST(value == synthesis->value());
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(every_sequence_found_is_correct)
+    {
+        for (uint32_t i = 0; i < 0x20000; ++i)
+        {
+            for (auto value : { i, ~i, i << 15 })
+            {
+                if (auto synthesis = synthesize_constant(value))
+                {
+                    BOOST_REQUIRE(value == synthesis->value());
+                }
+            }
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
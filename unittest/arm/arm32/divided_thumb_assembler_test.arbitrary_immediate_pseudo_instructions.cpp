@@ -0,0 +1,375 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(arbitrary_immediate_pseudo_instructions)
+
+        BOOST_AUTO_TEST_SUITE(add_imm)
+
+            BOOST_AUTO_TEST_CASE(zero_generates_no_code)
+            {
+                CHECK(add_imm(r0, 0), H());
+            }
+
+            BOOST_AUTO_TEST_CASE(encodable_immediate)
+            {
+                CHECK(add_imm(r0, 42), H(0x302a));
+                CHECK(add_imm(r0, -42), H(0x382a));
+            }
+
+            BOOST_AUTO_TEST_CASE(split_immediate)
+            {
+                CHECK(add_imm(r0, 300), H(0x30ff, 0x302d));
+                CHECK(add_imm(r0, 600, r1), H(0x30ff, 0x30ff, 0x305a));
+            }
+
+            BOOST_AUTO_TEST_CASE(constant_built_in_scratch_register)
+            {
+                // mov r1, #1; lsl r1, r1, #16; add r0, r0, r1
+                CHECK(add_imm(r0, 0x10000, r1), H(0x2101, 0x0409, 0x1840));
+
+                // mov r1, #1; lsl r1, r1, #16; sub r0, r0, r1
+                CHECK(add_imm(r0, -0x10000, r1), H(0x2101, 0x0409, 0x1a40));
+            }
+
+            BOOST_AUTO_TEST_CASE(constant_loaded_into_scratch_register)
+            {
+                CHECK(add_imm(r0, 0x12345678, r1), H(0x4900, 0x1840, 0x5678, 0x1234));
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_required)
+            {
+                CHECK_THROWS(add_imm(r0, 0x10000), is_scratch_register_required, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_must_differ_from_operand)
+            {
+                CHECK_THROWS(add_imm(r0, 0x10000, r0), is_scratch_register_conflict, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(sp_split_immediate)
+            {
+                CHECK(add_imm(sp, 1024), H(0xb07f, 0xb07f, 0xb002));
+                CHECK(add_imm(sp, -8), H(0xb082));
+            }
+
+            BOOST_AUTO_TEST_CASE(sp_with_scratch_register)
+            {
+                // mov r0, #1; lsl r0, r0, #12; add sp, r0
+                CHECK(add_imm(sp, 4096, r0), H(0x2001, 0x0300, 0x4485));
+            }
+
+            BOOST_AUTO_TEST_CASE(sp_misaligned)
+            {
+                CHECK_THROWS(add_imm(sp, 2), is_misaligned_immediate_value, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_sp)
+            {
+                CHECK(add_imm(r2, sp, 1020), H(0xaaff));
+                CHECK(add_imm(r2, sp, 1024), H(0xaaff, 0x3204));
+                CHECK(add_imm(r2, sp, 2), H(0xaa00, 0x3202));
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_sp_with_constant_built_in_rd)
+            {
+                // mov r2, #1; lsl r2, r2, #16; add r2, sp
+                CHECK(add_imm(r2, sp, 0x10000), H(0x2201, 0x0412, 0x446a));
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(mul_const)
+
+            BOOST_AUTO_TEST_CASE(trivial_constants)
+            {
+                CHECK(mul_const(r0, r1, 0), H(0x2000));
+                CHECK(mul_const(r0, r1, 1), H(0x1c08));
+                CHECK(mul_const(r0, r0, 1), H());
+                CHECK(mul_const(r0, r0, -1), H(0x4240));
+                CHECK(mul_const(r0, r1, 8), H(0x00c8));
+            }
+
+            BOOST_AUTO_TEST_CASE(shift_and_add)
+            {
+                // lsl r0, r1, #2; add r0, r0, r1
+                CHECK(mul_const(r0, r1, 5), H(0x0088, 0x1840));
+            }
+
+            BOOST_AUTO_TEST_CASE(mul_is_used_if_cheaper)
+            {
+                // mov r0, #10; mul r0, r1
+                CHECK(mul_const(r0, r1, 10), H(0x200a, 0x4348));
+
+                // ldr r0, =0x12345678; mul r0, r1
+                CHECK(mul_const(r0, r1, 0x12345678), H(0x4800, 0x4348, 0x5678, 0x1234));
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_equals_rs)
+            {
+                // mov r2, #45; mul r0, r2
+                CHECK(mul_const(r0, r0, 45, r2), H(0x222d, 0x4350));
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_equals_rs_optimized_for_speed)
+            {
+                // mul with an unknown multiplier may take up to five cycles, so a four instruction chain is faster.
+                // lsl r2, r0, #4; sub r0, r2, r0; lsl r2, r0, #1; add r0, r2, r0
+                divided_thumb_assembler a;
+                a.optimize_for(optimization_goal::speed);
+                a.mul_const(r0, r0, 45, r2);
+                CHECK_PROGRAM(a, 0, H(0x0102, 0x1a10, 0x0042, 0x1810));
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_equals_rs_with_copy_of_multiplicand)
+            {
+                // mov r2, r0; lsl r0, r2, #2; add r0, r0, r2; lsl r0, r0, #1; add r0, r0, r2
+                divided_thumb_assembler a;
+                a.optimize_for(optimization_goal::speed);
+                a.mul_const(r0, r0, 11, r2);
+                CHECK_PROGRAM(a, 0, H(0x1c02, 0x0090, 0x1880, 0x0040, 0x1880));
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_required)
+            {
+                CHECK_THROWS(mul_const(r0, r0, 7), is_scratch_register_required, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_must_differ_from_operands)
+            {
+                CHECK_THROWS(mul_const(r0, r1, 7, r1), is_scratch_register_conflict, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(sdiv_const)
+
+            BOOST_AUTO_TEST_CASE(trivial_divisors)
+            {
+                CHECK(sdiv_const(r0, r1, 1), H(0x1c08));
+                CHECK(sdiv_const(r0, r1, -1), H(0x4248));
+            }
+
+            BOOST_AUTO_TEST_CASE(power_of_two)
+            {
+                // asr r0, r1, #31; lsr r0, r0, #30; add r0, r0, r1; asr r0, r0, #2
+                CHECK(sdiv_const(r0, r1, 4), H(0x17c8, 0x0f80, 0x1840, 0x1080));
+
+                // lsr r0, r1, #31; add r0, r0, r1; asr r0, r0, #1; neg r0, r0
+                CHECK(sdiv_const(r0, r1, -2), H(0x0fc8, 0x1840, 0x1040, 0x4240));
+            }
+
+            BOOST_AUTO_TEST_CASE(power_of_two_rd_equals_rn)
+            {
+                // lsr r2, r0, #31; add r2, r2, r0; asr r0, r2, #1
+                CHECK(sdiv_const(r0, r0, 2, r2), H(0x0fc2, 0x1812, 0x1050));
+                CHECK_THROWS(sdiv_const(r0, r0, 2), is_scratch_register_required, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(reciprocal_multiplication)
+            {
+                divided_thumb_assembler a;
+                a.sdiv_const(r0, r1, 7, r2);
+                CHECK_PROGRAM(a, 0, H(
+                    0x4a07,                 // ldr r2, =0x92492493
+                    0x0000,                 // alignment padding
+                    0x4778,                 // bx pc
+                    0x46c0,                 // nop
+                    0x2291, 0xe0c0,         // smull r2, r0, r1, r2
+                    0x0001, 0xe080,         // add r0, r0, r1
+                    0x0140, 0xe1a0,         // mov r0, r0, asr #2
+                    0x0fa0, 0xe080,         // add r0, r0, r0, lsr #31
+                    0x2001, 0xe28f,         // add r2, pc, #1
+                    0xff12, 0xe12f,         // bx r2
+                    0x2493, 0x9249));
+            }
+
+            BOOST_AUTO_TEST_CASE(division_by_zero)
+            {
+                CHECK_THROWS(sdiv_const(r0, r1, 0), is_division_by_zero, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(smod_const)
+
+            BOOST_AUTO_TEST_CASE(power_of_two)
+            {
+                // asr r2, r0, #31; lsr r2, r2, #29; add r2, r2, r0; lsr r2, r2, #3; lsl r2, r2, #3; sub r0, r0, r2
+                CHECK(smod_const(r0, r0, 8, r2), H(0x17c2, 0x0f52, 0x1812, 0x08d2, 0x00d2, 0x1a80));
+                CHECK(smod_const(r0, r1, -1), H(0x2000));
+            }
+
+            BOOST_AUTO_TEST_CASE(reciprocal_multiplication_is_followed_by_multiply_and_subtract)
+            {
+                divided_thumb_assembler a;
+                a.smod_const(r0, r1, 3, r2);
+                CHECK_PROGRAM(a, 0, H(
+                    0x4a07,                 // ldr r2, =0x55555556
+                    0x0000,                 // alignment padding
+                    0x4778,                 // bx pc
+                    0x46c0,                 // nop
+                    0x2291, 0xe0c0,         // smull r2, r0, r1, r2
+                    0x0fa0, 0xe080,         // add r0, r0, r0, lsr #31
+                    0x2001, 0xe28f,         // add r2, pc, #1
+                    0xff12, 0xe12f,         // bx r2
+                    0x0042,                 // lsl r2, r0, #1
+                    0x1810,                 // add r0, r2, r0
+                    0x1a08,                 // sub r0, r1, r0
+                    0x0000,                 // literal pool alignment
+                    0x5556, 0x5555));
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(sub_imm)
+
+            BOOST_AUTO_TEST_CASE(split_immediate)
+            {
+                CHECK(sub_imm(r1, 300), H(0x39ff, 0x392d));
+            }
+
+            BOOST_AUTO_TEST_CASE(sp_with_scratch_register)
+            {
+                // mov r0, #255; mvn r0, r0; lsl r0, r0, #4; add sp, r0
+                CHECK(sub_imm(sp, 4096, r0), H(0x20ff, 0x43c0, 0x0100, 0x4485));
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_sp)
+            {
+                CHECK(sub_imm(r2, sp, 8), H(0xaa00, 0x3a08));
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(udiv_const)
+
+            BOOST_AUTO_TEST_CASE(power_of_two)
+            {
+                CHECK(udiv_const(r0, r1, 1), H(0x0008));
+                CHECK(udiv_const(r0, r1, 8), H(0x08c8));
+                CHECK(udiv_const(r0, r0, 0x80000000), H(0x0fc0));
+            }
+
+            BOOST_AUTO_TEST_CASE(reciprocal_multiplication)
+            {
+                divided_thumb_assembler a;
+                a.udiv_const(r0, r1, 10, r2);
+                CHECK_PROGRAM(a, 0, H(
+                    0x4a05,                 // ldr r2, =0xcccccccd
+                    0x0000,                 // alignment padding
+                    0x4778,                 // bx pc
+                    0x46c0,                 // nop
+                    0x2291, 0xe080,         // umull r2, r0, r1, r2
+                    0x01a0, 0xe1a0,         // mov r0, r0, lsr #3
+                    0x2001, 0xe28f,         // add r2, pc, #1
+                    0xff12, 0xe12f,         // bx r2
+                    0xcccd, 0xcccc));
+            }
+
+            BOOST_AUTO_TEST_CASE(reciprocal_multiplication_with_33_bit_multiplier)
+            {
+                divided_thumb_assembler a;
+                a.nop().udiv_const(r0, r1, 7, r2);
+                CHECK_PROGRAM(a, 0, H(
+                    0x46c0,                 // nop
+                    0x4a07,                 // ldr r2, =0x24924925
+                    0x4778,                 // bx pc
+                    0x46c0,                 // nop
+                    0x2291, 0xe080,         // umull r2, r0, r1, r2
+                    0x2000, 0xe041,         // sub r2, r1, r0
+                    0x00a2, 0xe080,         // add r0, r0, r2, lsr #1
+                    0x0120, 0xe1a0,         // mov r0, r0, lsr #2
+                    0x2001, 0xe28f,         // add r2, pc, #1
+                    0xff12, 0xe12f,         // bx r2
+                    0x4925, 0x2492));
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_required)
+            {
+                CHECK_THROWS(udiv_const(r0, r1, 10), is_scratch_register_required, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(rd_must_differ_from_rn)
+            {
+                CHECK_THROWS(udiv_const(r0, r0, 10, r2), is_unpredictable_behavior, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(division_by_zero)
+            {
+                CHECK_THROWS(udiv_const(r0, r1, 0), is_division_by_zero, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(umod_const)
+
+            BOOST_AUTO_TEST_CASE(power_of_two)
+            {
+                CHECK(umod_const(r0, r1, 1), H(0x2000));
+
+                // lsl r0, r1, #28; lsr r0, r0, #28
+                CHECK(umod_const(r0, r1, 16), H(0x0708, 0x0f00));
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_must_differ_from_operands)
+            {
+                CHECK_THROWS(umod_const(r0, r1, 10, r1), is_scratch_register_conflict, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(cmp_imm)
+
+            BOOST_AUTO_TEST_CASE(encodable_immediate)
+            {
+                CHECK(cmp_imm(r0, 42), H(0x282a));
+            }
+
+            BOOST_AUTO_TEST_CASE(negative_immediate_uses_cmn)
+            {
+                // mov r1, #1; cmn r0, r1
+                CHECK(cmp_imm(r0, -1, r1), H(0x2101, 0x42c8));
+            }
+
+            BOOST_AUTO_TEST_CASE(most_negative_immediate_does_not_use_cmn)
+            {
+                // mov r1, #1; lsl r1, r1, #31; cmp r0, r1
+                CHECK(cmp_imm(r0, 0x80000000, r1), H(0x2101, 0x07c9, 0x4288));
+            }
+
+            BOOST_AUTO_TEST_CASE(scratch_register_required)
+            {
+                CHECK_THROWS(cmp_imm(r0, 1000), is_scratch_register_required, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_CASE(optimization_goal_can_be_selected)
+        {
+            divided_thumb_assembler a;
+
+            a.optimize_for(optimization_goal::speed).add_imm(r0, 300);
+
+            CHECK_PROGRAM(a, 0, H(0x30ff, 0x302d));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
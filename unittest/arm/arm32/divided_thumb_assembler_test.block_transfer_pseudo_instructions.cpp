@@ -0,0 +1,150 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(block_transfer_pseudo_instructions)
+
+        BOOST_AUTO_TEST_SUITE(copy_block)
+
+            BOOST_AUTO_TEST_CASE(single_burst)
+            {
+                // ldmia r1!, {r2-r5}; stmia r0!, {r2-r5}
+                CHECK(copy_block(r0, r1, 16, r2 - r5), H(0xc93c, 0xc03c));
+            }
+
+            BOOST_AUTO_TEST_CASE(head_and_tail)
+            {
+                // ldrb r2, [r1, #0]; strb r2, [r0, #0]; add r0, #1; add r1, #1
+                // ldmia r1!, {r2}; stmia r0!, {r2}
+                // ldrh r2, [r1, #0]; strh r2, [r0, #0]
+                CHECK(
+                    copy_block(r0, r1, 7, r2 - r3, { .dst_offset = 3, .src_offset = 3 }),
+                    H(0x780a, 0x7002, 0x3001, 0x3101, 0xc904, 0xc004, 0x880a, 0x8002));
+            }
+
+            BOOST_AUTO_TEST_CASE(differently_aligned_source_and_destination)
+            {
+                // ldrh r2, [r1, #0]; ldrh r3, [r1, #2]; strh r2, [r0, #0]; strh r3, [r0, #2]; add r1, #4; add r0, #4
+                // ldrb r2, [r1, #0]; strb r2, [r0, #0]
+                CHECK(
+                    copy_block(r0, r1, 5, r2 - r3, { .src_offset = 2 }),
+                    H(0x880a, 0x884b, 0x8002, 0x8043, 0x3104, 0x3004, 0x780a, 0x7002));
+            }
+
+            BOOST_AUTO_TEST_CASE(fixed_unroll_factor)
+            {
+                // mov r3, #4
+                // loop: ldmia r1!, {r2}; stmia r0!, {r2}; ldmia r1!, {r2}; stmia r0!, {r2}; sub r3, #1; bne loop
+                CHECK(
+                    copy_block(r0, r1, 32, r2 - r3, { .unroll = 2 }),
+                    H(0x2304, 0xc904, 0xc004, 0xc904, 0xc004, 0x3b01, 0xd1f9));
+            }
+
+            BOOST_AUTO_TEST_CASE(temporaries_must_differ_from_operands)
+            {
+                CHECK_THROWS(copy_block(r0, r1, 4, r1 - r2), is_scratch_register_conflict, H());
+            }
+
+            BOOST_AUTO_TEST_CASE(offset_out_of_range)
+            {
+                CHECK_THROWS(copy_block(r0, r1, 4, r2 - r3, { .dst_offset = 4 }), is_immediate_out_of_range, H());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(fill_block)
+
+            BOOST_AUTO_TEST_CASE(loop_when_optimizing_for_size)
+            {
+                // mov r2, r1; mov r3, r1; mov r4, #21
+                // loop: stmia r0!, {r1-r3}; sub r4, #1; bne loop
+                // stmia r0!, {r1}
+                CHECK(fill_block(r0, r1, 256, r2 - r4), H(0x1c0a, 0x1c0b, 0x2415, 0xc00e, 0x3c01, 0xd1fc, 0xc002));
+            }
+
+            BOOST_AUTO_TEST_CASE(straight_line_when_optimizing_for_speed)
+            {
+                divided_thumb_assembler a;
+                a.optimize_for(optimization_goal::speed);
+                a.fill_block(r0, r1, 64, r2 - r4);
+
+                // mov r2, r1; mov r3, r1; mov r4, r1; 4 x stmia r0!, {r1-r4}
+                CHECK_PROGRAM(a, 0, H(0x1c0a, 0x1c0b, 0x1c0c, 0xc01e, 0xc01e, 0xc01e, 0xc01e));
+            }
+
+            BOOST_AUTO_TEST_CASE(without_temporaries)
+            {
+                // stmia r0!, {r1}; stmia r0!, {r1}; strb r1, [r0, #0]
+                CHECK(fill_block(r0, r1, 9), H(0xc002, 0xc002, 0x7001));
+            }
+
+            BOOST_AUTO_TEST_CASE(function)
+            {
+                // stmia r0!, {r1}; bx lr
+                CHECK(fill_block(r0, r1, 4, { .function = true }), H(0xc002, 0x4770));
+            }
+
+            BOOST_AUTO_TEST_CASE(loop_target_survives_relaxation)
+            {
+                divided_thumb_assembler a;
+                a.ldr(r5, 1);
+                a.fill_block(r0, r1, 256, r2 - r4);
+
+                // mov r5, #1; mov r2, r1; mov r3, r1; mov r4, #21
+                // loop: stmia r0!, {r1-r3}; sub r4, #1; bne loop
+                // stmia r0!, {r1}
+                auto program = a.link(0, { .relax_literals = literal_relaxation::all });
+                auto expected_bytes = to_bytevector(H(0x2501, 0x1c0a, 0x1c0b, 0x2415, 0xc00e, 0x3c01, 0xd1fc, 0xc002));
+                BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_SUITE(zero_block)
+
+            BOOST_AUTO_TEST_CASE(burst)
+            {
+                // mov r1, #0; mov r2, r1; stmia r0!, {r1-r2}
+                CHECK(zero_block(r0, 8, r1 - r2), H(0x2100, 0x1c0a, 0xc006));
+            }
+
+        BOOST_AUTO_TEST_SUITE_END()
+
+        BOOST_AUTO_TEST_CASE(estimates)
+        {
+            divided_thumb_assembler a;
+
+            auto size = a.estimate_fill_block(256, r2 - r4);
+            BOOST_TEST(14u == size.size);
+            BOOST_TEST(171u == size.cycles);
+
+            a.optimize_for(optimization_goal::speed);
+            auto speed = a.estimate_fill_block(256, r2 - r4);
+            BOOST_TEST(38u == speed.size);
+            BOOST_TEST(83u == speed.cycles);
+
+            // ldmia: 4S + 1N + 1I, stmia: 3S + 2N
+            auto copy = a.estimate_copy_block(16, r2 - r5);
+            BOOST_TEST(4u == copy.size);
+            BOOST_TEST(11u == copy.cycles);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,161 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_LINKED_PROGRAM(assembler, origin, options, ...)                                       \
+{                                                                                                   \
+    auto program = assembler.link(origin, options);                                                 \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(code_alignment)
+
+        BOOST_AUTO_TEST_CASE(pads_with_nops)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, 1);
+            a.align_code(2);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x2001, 0x46c0, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(aligned_location_counter_is_not_padded)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, 1);
+            a.mov(r1, 2);
+            a.align_code(2);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x2001, 0x2102, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(alignment_must_be_in_range)
+        {
+            CHECK_THROWS(align_code(32), is_alignment_out_of_range);
+        }
+
+        BOOST_AUTO_TEST_CASE(padding_is_moved_behind_unconditional_branch)
+        {
+            divided_thumb_assembler a;
+
+            a.b("entry"s);
+            a.label("entry"s);
+            a.mov(r0, 8);
+            a.align_code(3);
+            a.label("loop"s);
+            a.sub(r0, 1);
+            a.bne("loop"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0xe001, 0x46c0, 0x46c0, 0x2008, 0x3801, 0xd1fd, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(padding_is_not_moved_beyond_previous_alignment)
+        {
+            divided_thumb_assembler a;
+
+            a.bx(lr);
+            a.align(2);
+            a.word(0);
+            a.mov(r0, 8);
+            a.align_code(3);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x4770, 0x0000, 0x0000, 0x0000, 0x2008, 0x46c0, 0x46c0, 0x46c0, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(moved_padding_is_recomputed_when_code_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.bx(lr);
+            a.mov(r9, r9);
+            a.mov(r0, 8);
+            a.align_code(3);
+            a.label("loop"s);
+            a.sub(r0, 1);
+            a.bne("loop"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x4770, 0x46c0, 0x46c9, 0x2008, 0x3801, 0xd1fd, 0x4770));
+            CHECK_LINKED_PROGRAM(a, 0, link_options{ .peephole = true }, H(0x4770, 0x46c0, 0x46c0, 0x2008, 0x3801, 0xd1fd, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(hot_loops_are_not_aligned_by_default)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, 8);
+            a.hot_loop("loop"s);
+            a.sub(r0, 1);
+            a.bne("loop"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x2008, 0x3801, 0xd1fd, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(hot_loop_is_aligned)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, 8);
+            a.hot_loop("loop"s);
+            a.sub(r0, 1);
+            a.bne("loop"s);
+            a.bx(lr);
+
+            CHECK_LINKED_PROGRAM(a, 0, link_options{ .hot_loop_alignment = 2 }, H(0x2008, 0x46c0, 0x3801, 0xd1fd, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(hot_label_without_backward_branch_is_not_aligned)
+        {
+            divided_thumb_assembler a;
+
+            a.b("skip"s);
+            a.mov(r0, 8);
+            a.hot_loop("skip"s);
+            a.bx(lr);
+
+            CHECK_LINKED_PROGRAM(a, 0, link_options{ .hot_loop_alignment = 3 }, H(0xe000, 0x2008, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(hot_loop_padding_is_moved_behind_unconditional_branch)
+        {
+            divided_thumb_assembler a;
+
+            a.b("entry"s);
+            a.label("entry"s);
+            a.ldr(r0, 0x12345678);
+            a.hot_loop("loop"s);
+            a.sub(r0, 1);
+            a.bne("loop"s);
+            a.bx(lr);
+
+            CHECK_LINKED_PROGRAM(a, 0, link_options{ .hot_loop_alignment = 3 },
+                H(0xe001, 0x46c0, 0x46c0, 0x4802, 0x3801, 0xd1fd, 0x4770, 0x0000, 0x5678, 0x1234));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
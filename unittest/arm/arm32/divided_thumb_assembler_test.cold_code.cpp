@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(cold_code)
+
+        BOOST_AUTO_TEST_CASE(cold_code_branches_back)
+        {
+            divided_thumb_assembler a;
+
+            a.cmp(r0, 0);
+            a.beq("zero"s);
+            a.cold("zero"s, [&] { a.mov(r0, 1); });
+            a.add(r0, 1);
+            a.bx(lr);
+            a.flush_cold();
+
+            CHECK_PROGRAM(a, 0, H(0x2800, 0xd001, 0x3001, 0x4770, 0x2001, 0xe7fb));
+        }
+
+        BOOST_AUTO_TEST_CASE(cold_code_with_condition_emits_the_branch)
+        {
+            divided_thumb_assembler a;
+
+            a.cmp(r0, 0);
+            a.cold(condition_code::eq, "zero"s, [&] { a.mov(r0, 1); });
+            a.add(r0, 1);
+            a.bx(lr);
+            a.flush_cold();
+
+            CHECK_PROGRAM(a, 0, H(0x2800, 0xd001, 0x3001, 0x4770, 0x2001, 0xe7fb));
+        }
+
+        BOOST_AUTO_TEST_CASE(far_cold_code_gets_a_long_branch)
+        {
+            divided_thumb_assembler a;
+
+            a.cmp(r0, 0);
+            a.cold(condition_code::eq, "zero"s, [&] { a.mov(r0, 1); });
+            for (int i = 0; i < 200; ++i)
+            {
+                a.nop();
+            }
+            a.bx(lr);
+            a.flush_cold();
+
+            // beq would need to reach 404 bytes, so it becomes bne over b.
+            auto program = a.link(0);
+            BOOST_TEST(program.size() == 412u);
+            program.erase(program.begin() + 6, program.end() - 6);
+            BOOST_TEST(
+                program == to_bytevector(H(0x2800, 0xd100, 0xe0c8, 0x4770, 0x2001, 0xe734)),
+                boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(cold_code_ending_with_unconditional_branch_does_not_branch_back)
+        {
+            divided_thumb_assembler a;
+
+            a.cmp(r0, 0);
+            a.beq("zero"s);
+            a.cold("zero"s, [&] { a.mov(r0, 1); a.bx(lr); });
+            a.add(r0, 1);
+            a.bx(lr);
+            a.flush_cold();
+
+            CHECK_PROGRAM(a, 0, H(0x2800, 0xd001, 0x3001, 0x4770, 0x2001, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(hot_code_branches_around_cold_code)
+        {
+            divided_thumb_assembler a;
+
+            a.beq("zero"s);
+            a.cold("zero"s, [&] { a.mov(r0, 1); });
+            a.add(r0, 1);
+            a.flush_cold();
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0xd001, 0x3001, 0xe001, 0x2001, 0xe7fb, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(cold_code_can_defer_cold_code)
+        {
+            divided_thumb_assembler a;
+
+            a.bne("outer"s);
+            a.cold("outer"s, [&]
+            {
+                a.bne("inner"s);
+                a.cold("inner"s, [&] { a.mov(r1, 2); });
+                a.mov(r0, 1);
+            });
+            a.bx(lr);
+            a.flush_cold();
+
+            CHECK_PROGRAM(a, 0, H(0xd100, 0x4770, 0xd101, 0x2001, 0xe7fb, 0x2102, 0xe7fb));
+        }
+
+        BOOST_AUTO_TEST_CASE(end_function_places_cold_code_inside_the_function)
+        {
+            divided_thumb_assembler a;
+
+            a.begin_function();
+            a.cmp(r0, 0);
+            a.beq("zero"s);
+            a.cold("zero"s, [&] { a.mov(r4, 1); });
+            a.ret();
+            a.end_function();
+
+            // r4 is only written by the cold code, but is still saved.
+            CHECK_PROGRAM(a, 0, H(0xb510, 0x2800, 0xd000, 0xbd10, 0x2401, 0xe7fc));
+        }
+
+        BOOST_AUTO_TEST_CASE(link_places_remaining_cold_code_at_the_end)
+        {
+            divided_thumb_assembler a;
+
+            a.beq("zero"s);
+            a.cold("zero"s, [&] { a.mov(r0, 1); });
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0xd000, 0x4770, 0x2001, 0xe7fc));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(compressed_size)
+
+        BOOST_AUTO_TEST_CASE(expansions_reuse_literals)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::compressed_size);
+
+            a.add_imm(r0, 0xffffff, r1);
+            a.cmp_imm(r2, 0xffffff, r1);
+            a.bx(lr);
+
+            // Building the constant twice would take 14 bytes, instead of 4 bytes of loads and a shared pool entry.
+            CHECK_PROGRAM(a, 0, H(0x4902, 0x1840, 0x4901, 0x428a, 0x4770, 0x0000, 0xffff, 0x00ff));
+        }
+
+        BOOST_AUTO_TEST_CASE(literal_pool_is_sorted)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::compressed_size);
+
+            a.ldr(r0, 0x04000000);
+            a.ldr(r1, 0x12345678);
+            a.ldr(r2, 0x04000008);
+            a.ldr(r3, 0x12345600);
+            a.bx(lr);
+
+            CHECK_PROGRAM(
+                a, 0,
+                H(0x4802, 0x4905, 0x4a02, 0x4b03, 0x4770, 0x0000,
+                  0x0000, 0x0400, 0x0008, 0x0400, 0x5600, 0x1234, 0x5678, 0x1234));
+        }
+
+        BOOST_AUTO_TEST_CASE(alignment_padding_repeats_nops)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::compressed_size);
+
+            for (int i = 0; i < 9; ++i)
+            {
+                a.nop();
+            }
+            a.align(2);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x46c0, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(alignment_padding_is_zero_in_data)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::compressed_size);
+
+            a.word(0, 0);
+            a.hword(0);
+            a.align(2);
+            a.word(0);
+
+            CHECK_PROGRAM(a, 0, W(0, 0, 0, 0));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
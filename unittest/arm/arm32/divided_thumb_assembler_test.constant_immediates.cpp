@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+namespace
+{
+
+template <immediate_t value>
+constexpr bool can_shift_right_by = requires (divided_thumb_assembler& a) { a.lsr(r0, r1, imm<value>); };
+
+template <immediate_t value>
+constexpr bool can_load_word_at = requires (divided_thumb_assembler& a) { a.ldr(r0, r1, imm<value>); };
+
+template <immediate_t value>
+constexpr bool can_add_to_sp = requires (divided_thumb_assembler& a) { a.add(sp, imm<value>); };
+
+template <immediate_t value>
+constexpr bool can_emit_byte = requires (divided_thumb_assembler& a) { a.byte(imm<value>); };
+
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(constant_immediates)
+
+        BOOST_AUTO_TEST_CASE(out_of_range_or_misaligned_values_do_not_compile)
+        {
+            static_assert(can_shift_right_by<0>);
+            static_assert(can_shift_right_by<32>);
+            static_assert(!can_shift_right_by<33>);
+            static_assert(!can_shift_right_by<-1>);
+
+            static_assert(can_load_word_at<124>);
+            static_assert(!can_load_word_at<128>);
+            static_assert(!can_load_word_at<2>);
+
+            static_assert(can_add_to_sp<-508>);
+            static_assert(!can_add_to_sp<512>);
+            static_assert(!can_add_to_sp<6>);
+
+            static_assert(can_emit_byte<-128>);
+            static_assert(can_emit_byte<255>);
+            static_assert(!can_emit_byte<256>);
+        }
+
+        BOOST_AUTO_TEST_CASE(encode_like_runtime_values)
+        {
+            divided_thumb_assembler a;
+            a.add(r0, r1, imm<3>);
+            a.add(r2, imm<200>);
+            a.sub(sp, imm<0x40>);
+            a.mov(r3, imm<0x7f>);
+            a.cmp(r4, imm<12>);
+            a.lsl(r5, r6, imm<7>);
+            a.asr(r5, r6, imm<32>);
+            a.lsr(r5, r6, imm<0>);
+            a.ldr(r0, sp, imm<0x3fc>);
+            a.strh(r0, r1, imm<0x10>);
+            a.ldrb(r0, r1, imm<0x1f>);
+            a.swi(imm<0xab>);
+
+            divided_thumb_assembler b;
+            b.add(r0, r1, 3);
+            b.add(r2, 200);
+            b.sub(sp, 0x40);
+            b.mov(r3, 0x7f);
+            b.cmp(r4, 12);
+            b.lsl(r5, r6, 7);
+            b.asr(r5, r6, 32);
+            b.lsr(r5, r6, 0);
+            b.ldr(r0, sp, 0x3fc);
+            b.strh(r0, r1, 0x10);
+            b.ldrb(r0, r1, 0x1f);
+            b.swi(0xab);
+
+            auto expected = b.link(0);
+            CHECK_PROGRAM(a, 0, expected);
+        }
+
+        BOOST_AUTO_TEST_CASE(negative_value_turns_add_into_sub)
+        {
+            divided_thumb_assembler a;
+            a.add(r0, imm<-4>);
+            CHECK_PROGRAM(a, 0, H(0x3804));
+        }
+
+        BOOST_AUTO_TEST_CASE(data_definition_directives)
+        {
+            divided_thumb_assembler a;
+            a.byte(imm<-1>, imm<2>);
+            a.hword(imm<0x1234>);
+            a.word(imm<0x12345678>);
+            CHECK_PROGRAM(a, 0, B(0xff, 0x02, 0x34, 0x12, 0x78, 0x56, 0x34, 0x12));
+        }
+
+        BOOST_AUTO_TEST_CASE(operands_without_compile_time_check)
+        {
+            // Operands that are not checked by the instruction convert to an immediate.
+            divided_thumb_assembler a;
+            a.equ("four"s, imm<4>);
+            a.mov(r0, "four"s);
+            a.b(imm<0>);
+            CHECK_PROGRAM(a, 0, H(0x2004, 0xe7fd));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <span>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+namespace
+{
+
+// 12 bit offset, the upper four bits of the second byte are left alone.
+custom_reference_type offset12()
+{
+    custom_reference_type type;
+    type.max = 0xfff;
+    type.size = 2;
+    type.patch = [](std::span<unsigned char> bytes, immediate_t value)
+    {
+        bytes[0] = value & 255;
+        bytes[1] |= (value >> 8) & 15;
+    };
+    return type;
+}
+
+// Halfword offset of the target from the pointer, in halfwords.
+custom_reference_type compressed_pointer()
+{
+    custom_reference_type type;
+    type.min = -0x10000;
+    type.max = 0xfffe;
+    type.alignment = 1;
+    type.size = 2;
+    type.is_pc_relative = true;
+    type.patch = [](std::span<unsigned char> bytes, immediate_t value)
+    {
+        bytes[0] = (value >> 1) & 255;
+        bytes[1] = (value >> 9) & 255;
+    };
+    return type;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(custom_reference_types)
+
+        BOOST_AUTO_TEST_CASE(absolute)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(offset12());
+
+            a.label("table"s);
+            a.fixup(type, symbol("second"s) - symbol("table"s));
+            a.fixup(type, symbol("first"s) - symbol("table"s));
+            a.label("first"s);
+            space(a, 0x230);
+            a.label("second"s);
+
+            auto expected = to_bytevector(B(0x34, 0x02, 0x04, 0x00));
+            auto program = a.link(0x1000);
+            BOOST_TEST(bytevector(program.begin(), program.begin() + 4) == expected, boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(pc_relative)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(compressed_pointer());
+
+            a.label("data"s);
+            a.hword(0x1234);
+            a.fixup(type, "data"s);
+            a.fixup(type, "end"s);
+            a.label("end"s);
+
+            CHECK_PROGRAM(a, 0x1000, H(0x1234, 0xffff, 0x0001));
+        }
+
+        BOOST_AUTO_TEST_CASE(fixup_moves_with_the_code)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(compressed_pointer());
+            link_options options;
+            options.relax_literals = literal_relaxation::all;
+
+            a.ldr(r0, 1);
+            a.bx(lr);
+            a.fixup(type, "data"s);
+            a.label("data"s);
+            a.hword(0x1234);
+
+            auto program = a.link(0, options);
+            BOOST_TEST(program == to_bytevector(H(0x2001, 0x4770, 0x0001, 0x1234)), boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(value_is_range_checked)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(offset12());
+
+            a.fixup(type, 0x1000);
+
+            CHECK_LINK_THROWS(a, 0, is_immediate_out_of_range);
+        }
+
+        BOOST_AUTO_TEST_CASE(value_is_alignment_checked)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(compressed_pointer());
+
+            a.label("start"s);
+            a.byte(0);
+            a.fixup(type, "start"s);
+
+            CHECK_LINK_THROWS(a, 0, is_misaligned_immediate_value);
+        }
+
+        BOOST_AUTO_TEST_CASE(dry_run_reports_errors)
+        {
+            divided_thumb_assembler a;
+            auto type = a.register_reference_type(offset12());
+
+            a.fixup(type, 0x1000);
+            a.fixup(type, -1);
+
+            auto summary = a.dry_run_link(0x100);
+            BOOST_REQUIRE_EQUAL(2u, summary.errors.size());
+            BOOST_CHECK_EQUAL(0x100u, summary.errors[0].address);
+            BOOST_CHECK_EQUAL(0x102u, summary.errors[1].address);
+        }
+
+        BOOST_AUTO_TEST_CASE(invalid_custom_reference_type)
+        {
+            divided_thumb_assembler a;
+            auto without_patch = offset12();
+            without_patch.patch = nullptr;
+            auto without_size = offset12();
+            without_size.size = 0;
+
+            BOOST_CHECK_EXCEPTION(a.register_reference_type(without_patch), std::runtime_error, is_invalid_custom_reference_type);
+            BOOST_CHECK_EXCEPTION(a.register_reference_type(without_size), std::runtime_error, is_invalid_custom_reference_type);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_STRIPPED_PROGRAM(assembler, origin, ...)                                              \
+{                                                                                                   \
+    auto program = assembler.link(origin, { .strip_unreachable = true });                           \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+#define CHECK_REPORT(assembler, symbols, bytes)                                                     \
+{                                                                                                   \
+    const auto& report = assembler.last_stripping_report();                                         \
+    BOOST_TEST(report.removed_symbols == symbols##u);                                               \
+    BOOST_TEST(report.saved_bytes == bytes##u);                                                     \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(dead_code_stripping)
+
+        BOOST_AUTO_TEST_CASE(is_off_by_default)
+        {
+            divided_thumb_assembler a;
+
+            a.entry_point("main"s);
+            a.label("main"s);
+            a.bx(lr);
+            a.label("unused"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x4770, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(uncalled_routine_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.entry_point("main"s);
+            a.label("main"s);
+            a.bl("f"s);
+            a.bx(lr);
+            a.label("unused"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+            a.label("f"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            CHECK_STRIPPED_PROGRAM(a, 0, H(0xf000, 0xf801, 0x4770, 0x2001, 0x4770));
+            CHECK_REPORT(a, 1, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(data_and_literal_pool_are_kept_if_referenced)
+        {
+            divided_thumb_assembler a;
+
+            a.entry_point("main"s);
+            a.label("main"s);
+            a.ldr(r0, "table"s);
+            a.bx(lr);
+            a.label("unused"s);
+            a.bx(lr);
+            a.label("table"s);
+            a.word(1);
+            a.label("junk"s);
+            a.word(2);
+
+            CHECK_STRIPPED_PROGRAM(a, 0x100, H(0x4801, 0x4770, 0x0001, 0x0000, 0x0104, 0x0000));
+            CHECK_REPORT(a, 2, 8);
+        }
+
+        BOOST_AUTO_TEST_CASE(code_falling_through_keeps_the_next_routine)
+        {
+            divided_thumb_assembler a;
+
+            a.entry_point("main"s);
+            a.label("main"s);
+            a.mov(r0, 1);
+            a.label("next"s);
+            a.bx(lr);
+            a.label("unused"s);
+            a.bx(lr);
+
+            CHECK_STRIPPED_PROGRAM(a, 0, H(0x2001, 0x4770));
+            CHECK_REPORT(a, 1, 2);
+        }
+
+        BOOST_AUTO_TEST_CASE(padding_is_removed_with_the_routine)
+        {
+            divided_thumb_assembler a;
+
+            a.entry_point("main"s);
+            a.label("main"s);
+            a.bl("f"s);
+            a.bx(lr);
+            a.align(2);
+            a.label("unused"s);
+            a.bx(lr);
+            a.align(2);
+            a.label("f"s);
+            a.bx(lr);
+
+            CHECK_STRIPPED_PROGRAM(a, 0, H(0xf000, 0xf802, 0x4770, 0x0000, 0x4770));
+            CHECK_REPORT(a, 1, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(entry_point_is_required)
+        {
+            divided_thumb_assembler a;
+
+            a.label("main"s);
+            a.bx(lr);
+
+            BOOST_CHECK_EXCEPTION(a.link(0, { .strip_unreachable = true }), std::runtime_error, is_no_entry_point);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(dry_run_link)
+
+        BOOST_AUTO_TEST_CASE(size_and_symbol_addresses)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.ldr(r0, 0x12345678);
+            a.b("end"s);
+            a.label("end"s);
+            a.bx(lr);
+
+            auto summary = a.dry_run_link(0x1000);
+
+            BOOST_CHECK_EQUAL(12u, summary.size);
+            BOOST_CHECK_EQUAL(2u, summary.symbols.size());
+            BOOST_CHECK_EQUAL(0x1000u, summary.symbols.at("start"s));
+            BOOST_CHECK_EQUAL(0x1004u, summary.symbols.at("end"s));
+            BOOST_CHECK(summary.errors.empty());
+        }
+
+        BOOST_AUTO_TEST_CASE(layout_matches_link)
+        {
+            // Exercises the literal pool, mergeable data, the lengthening of branches and the shrinking of switch tables.
+            auto assemble = [](divided_thumb_assembler& a)
+            {
+                a.label("start"s);
+                a.ldr(r0, "text"s);
+                a.ldr(r1, 0x12345678);
+                a.switch_table(r2, "near"s, "compare"s);
+                a.label("near"s);
+                a.mov(r0, 0);
+                a.label("compare"s);
+                a.cmp(r0, 0);
+                a.cold(condition_code::eq, "zero"s, [&] { a.mov(r0, 1); });
+                space(a, 300);
+                a.bx(lr);
+                a.mergeable_data("text"s, 2, [&] { a.word(1); });
+                a.label("end"s);
+            };
+
+            divided_thumb_assembler linked;
+            assemble(linked);
+            divided_thumb_assembler dry_run;
+            assemble(dry_run);
+
+            auto program = linked.link(0x2000);
+            auto summary = dry_run.dry_run_link(0x2000);
+
+            BOOST_CHECK(summary.errors.empty());
+            BOOST_CHECK_EQUAL(program.size(), summary.size);
+            BOOST_CHECK_EQUAL(0x2000u, summary.symbols.at("start"s));
+            BOOST_CHECK_EQUAL(0x2012u, summary.symbols.at("near"s));
+            BOOST_CHECK_EQUAL(0x2154u, summary.symbols.at("text"s));
+            BOOST_CHECK_EQUAL(1u, program.at(summary.symbols.at("text"s) - 0x2000));
+        }
+
+        BOOST_AUTO_TEST_CASE(program_is_left_unchanged)
+        {
+            auto assemble = [](divided_thumb_assembler& a)
+            {
+                a.label("start"s);
+                a.ldr(r0, "data"s);
+                a.ldr(r1, 0x20);
+                a.beq("start"s);
+                a.bx(lr);
+                a.label("data"s);
+                a.word(1);
+            };
+
+            divided_thumb_assembler linked;
+            assemble(linked);
+            divided_thumb_assembler dry_run;
+            assemble(dry_run);
+
+            auto first = dry_run.dry_run_link(0x2000);
+            auto other = dry_run.dry_run_link(0x3000);
+            auto repeated = dry_run.dry_run_link(0x2000);
+
+            BOOST_CHECK_EQUAL(20u, first.size);
+            BOOST_CHECK_EQUAL(0x3008u, other.symbols.at("data"s));
+            BOOST_CHECK_EQUAL(first.size, repeated.size);
+            BOOST_CHECK(first.symbols == repeated.symbols);
+            BOOST_TEST(dry_run.link(0x2000) == linked.link(0x2000), boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(all_errors_are_reported)
+        {
+            divided_thumb_assembler a;
+
+            a.beq("far"s);
+            a.mov(r0, symbol("far"s) - symbol("near"s));
+            a.label("near"s);
+            a.ldr(r1, r2, symbol("near"s) - 0x1002);
+            a.word("undefined"s);
+            space(a, 256);
+            a.label("far"s);
+
+            auto summary = a.dry_run_link(0x1000);
+
+            BOOST_REQUIRE_EQUAL(4u, summary.errors.size());
+            BOOST_CHECK_EQUAL(0x1000u, summary.errors[0].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", summary.errors[0].message);
+            BOOST_CHECK_EQUAL(0x1002u, summary.errors[1].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", summary.errors[1].message);
+            BOOST_CHECK_EQUAL(0x1004u, summary.errors[2].address);
+            BOOST_CHECK_EQUAL("Misaligned immediate value", summary.errors[2].message);
+            BOOST_CHECK_EQUAL(0x1006u, summary.errors[3].address);
+            BOOST_CHECK_EQUAL("Undefined symbol", summary.errors[3].message);
+        }
+
+        BOOST_AUTO_TEST_CASE(errors_of_the_passes_are_reported)
+        {
+            divided_thumb_assembler a;
+
+            a.begin_function();
+            a.bx(lr);
+
+            BOOST_CHECK_NO_THROW(
+                auto summary = a.dry_run_link(0x1000);
+                BOOST_REQUIRE_EQUAL(1u, summary.errors.size());
+                BOOST_CHECK_EQUAL(0x1000u, summary.errors[0].address);
+                BOOST_CHECK_EQUAL("Function is not ended", summary.errors[0].message));
+        }
+
+        BOOST_AUTO_TEST_CASE(external_symbols)
+        {
+            divided_thumb_assembler a;
+
+            a.bl("rom_function"s);
+
+            auto summary = a.dry_run_link(0x08000000, [](const symbol<std::string>&) { return std::optional<address_t>(0x09000000); });
+
+            BOOST_REQUIRE_EQUAL(1u, summary.errors.size());
+            BOOST_CHECK_EQUAL(0x08000000u, summary.errors[0].address);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,230 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+using error_code_assembler = basic_divided_thumb_assembler<std::string, error_code_policy>;
+using collecting_assembler = basic_divided_thumb_assembler<std::string, collecting_error_policy>;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(error_policies)
+
+        BOOST_AUTO_TEST_CASE(error_code_policy_keeps_first_error)
+        {
+            error_code_assembler a;
+
+            a.nop();
+            BOOST_CHECK(!a.errors().has_error());
+
+            a.mov(r0, 256);
+            a.ldr(r0, r1, 2);
+
+            BOOST_REQUIRE(a.errors().has_error());
+            BOOST_CHECK_EQUAL(2u, a.errors().error().address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", a.errors().error().message);
+        }
+
+        BOOST_AUTO_TEST_CASE(error_code_policy_clear)
+        {
+            error_code_assembler a;
+
+            a.add(r0, r1, 8);
+            a.errors().clear();
+            BOOST_CHECK(!a.errors().has_error());
+
+            a.lsr(r0, r1, 33);
+            BOOST_REQUIRE(a.errors().has_error());
+            BOOST_CHECK_EQUAL(2u, a.errors().error().address);
+        }
+
+        BOOST_AUTO_TEST_CASE(erroneous_operands_are_encoded_as_zero)
+        {
+            error_code_assembler a;
+
+            a.mov(r0, 256);
+            a.ldr(r0, r1, 2);
+
+            CHECK_PROGRAM(a, 0, H(0x2000, 0x6808));
+        }
+
+        BOOST_AUTO_TEST_CASE(collecting_error_policy_keeps_all_errors)
+        {
+            collecting_assembler a;
+
+            a.lsl(r0, r1, 32);
+            a.strh(r0, r1, 1);
+            a.stmia(!r1, r0, r1);
+
+            const auto& diagnostics = a.errors().diagnostics();
+            BOOST_REQUIRE_EQUAL(3u, diagnostics.size());
+            BOOST_CHECK_EQUAL(0u, diagnostics[0].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", diagnostics[0].message);
+            BOOST_CHECK_EQUAL(2u, diagnostics[1].address);
+            BOOST_CHECK_EQUAL("Misaligned immediate value", diagnostics[1].message);
+            BOOST_CHECK_EQUAL(4u, diagnostics[2].address);
+            BOOST_CHECK_EQUAL("Unpredictable behavior", diagnostics[2].message);
+
+            a.errors().clear();
+            BOOST_CHECK(!a.errors().has_error());
+        }
+
+        BOOST_AUTO_TEST_CASE(link_reports_all_fixup_errors)
+        {
+            collecting_assembler a;
+
+            a.beq("far"s);
+            a.ldr(r1, r2, "far"s);
+            a.word("undefined"s);
+            std::vector<unsigned char> zeros(256);
+            a.incbin(zeros.begin(), zeros.end());
+            a.label("far"s);
+
+            BOOST_CHECK(a.link(0x1000).empty());
+
+            const auto& diagnostics = a.errors().diagnostics();
+            BOOST_REQUIRE_EQUAL(3u, diagnostics.size());
+            BOOST_CHECK_EQUAL(0x1000u, diagnostics[0].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", diagnostics[0].message);
+            BOOST_CHECK_EQUAL(0x1002u, diagnostics[1].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", diagnostics[1].message);
+            BOOST_CHECK_EQUAL(0x1004u, diagnostics[2].address);
+            BOOST_CHECK_EQUAL("Undefined symbol", diagnostics[2].message);
+        }
+
+        BOOST_AUTO_TEST_CASE(link_reports_errors_of_the_passes_at_origin)
+        {
+            error_code_assembler a;
+
+            a.begin_function();
+            a.ret();
+
+            BOOST_CHECK(a.link(0x1000).empty());
+            BOOST_REQUIRE(a.errors().has_error());
+            BOOST_CHECK_EQUAL(0x1000u, a.errors().error().address);
+            BOOST_CHECK(is_function_not_ended(std::runtime_error(a.errors().error().message)));
+        }
+
+        BOOST_AUTO_TEST_CASE(pseudo_instruction_with_invalid_operands_emits_nothing)
+        {
+            collecting_assembler a;
+
+            BOOST_CHECK_NO_THROW(a.cmp_imm(r0, 0x1234));
+            BOOST_CHECK_NO_THROW(a.sdiv_const(r0, r1, 0));
+            BOOST_CHECK_NO_THROW(a.smod_const(r0, r1, 10, r1));
+            BOOST_CHECK_NO_THROW(a.switch_table(r0, std::vector<collecting_assembler::immediate>()));
+            a.nop();
+
+            const auto& diagnostics = a.errors().diagnostics();
+            BOOST_REQUIRE_EQUAL(4u, diagnostics.size());
+            BOOST_CHECK_EQUAL("Immediate value requires a scratch register", diagnostics[0].message);
+            BOOST_CHECK_EQUAL("Division by zero", diagnostics[1].message);
+            BOOST_CHECK_EQUAL("Scratch register must differ from the other operands", diagnostics[2].message);
+            BOOST_CHECK_EQUAL("Invalid number of switch table entries", diagnostics[3].message);
+            CHECK_PROGRAM(a, 0, H(0x46c0));
+        }
+
+        BOOST_AUTO_TEST_CASE(symbol_that_is_already_defined_keeps_first_definition)
+        {
+            error_code_assembler a;
+
+            a.label("label"s);
+            a.nop();
+            BOOST_CHECK_NO_THROW(a.label("label"s));
+
+            BOOST_REQUIRE(a.errors().has_error());
+            BOOST_CHECK_EQUAL(2u, a.errors().error().address);
+            BOOST_CHECK_EQUAL("Symbol is already defined", a.errors().error().message);
+            a.b("label"s);
+            CHECK_PROGRAM(a, 0, H(0x46c0, 0xe7fd));
+        }
+
+        BOOST_AUTO_TEST_CASE(link_of_an_invalid_program_does_not_throw)
+        {
+            error_code_assembler a;
+
+            a.entry_point("undefined_entry"s);
+            a.hot_loop("loop"s);
+            a.beq("far"s);
+            a.ldr(r0, "undefined"s);
+            a.word(symbol("loop"s) / (symbol("loop"s) - symbol("loop"s)));
+            a.b("loop"s);
+            std::vector<unsigned char> zeros(256);
+            a.incbin(zeros.begin(), zeros.end());
+            a.label("far"s);
+            a.bx(lr);
+
+            link_options options;
+            options.relax_literals = literal_relaxation::all;
+            options.strip_unreachable = true;
+            options.fold_identical_code = true;
+            options.peephole = true;
+            options.schedule_loads = true;
+            options.hot_loop_alignment = 99;
+
+            bytevector program;
+            BOOST_CHECK_NO_THROW(program = a.link(0x1000, options));
+            BOOST_CHECK(program.empty());
+            BOOST_REQUIRE(a.errors().has_error());
+            BOOST_CHECK_EQUAL(0x1000u, a.errors().error().address);
+            BOOST_CHECK_EQUAL("Undefined symbol", a.errors().error().message);
+        }
+
+        BOOST_AUTO_TEST_CASE(link_reports_errors_of_the_passes_and_of_the_fixups)
+        {
+            collecting_assembler a;
+
+            a.hot_loop("loop"s);
+            a.beq("far"s);
+            a.ldr(r0, "undefined"s);
+            a.word(symbol("loop"s) / (symbol("loop"s) - symbol("loop"s)));
+            std::vector<unsigned char> zeros(256);
+            a.incbin(zeros.begin(), zeros.end());
+            a.label("far"s);
+            a.b("loop"s);
+
+            link_options options;
+            options.hot_loop_alignment = 99;
+
+            BOOST_CHECK(a.link(0x1000, options).empty());
+
+            const auto& diagnostics = a.errors().diagnostics();
+            BOOST_REQUIRE_EQUAL(4u, diagnostics.size());
+            BOOST_CHECK_EQUAL(0x1000u, diagnostics[0].address);
+            BOOST_CHECK_EQUAL("Alignment out of range", diagnostics[0].message);
+            BOOST_CHECK_EQUAL(0x1000u, diagnostics[1].address);
+            BOOST_CHECK_EQUAL("Immediate value is out of range", diagnostics[1].message);
+            BOOST_CHECK_EQUAL(0x1004u, diagnostics[2].address);
+            BOOST_CHECK_EQUAL("Division by zero", diagnostics[2].message);
+            BOOST_CHECK_EQUAL(0x110cu, diagnostics[3].address);
+            BOOST_CHECK_EQUAL("Undefined symbol", diagnostics[3].message);
+        }
+
+        BOOST_AUTO_TEST_CASE(link_without_errors)
+        {
+            error_code_assembler a;
+
+            a.label("loop"s);
+            a.b("loop"s);
+
+            CHECK_PROGRAM(a, 0, H(0xe7fe));
+            BOOST_CHECK(!a.errors().has_error());
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
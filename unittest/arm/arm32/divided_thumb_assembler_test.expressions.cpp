@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(expressions)
+
+        BOOST_AUTO_TEST_CASE(symbol_difference)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.word(symbol("end"s) - symbol("start"s));
+            a.hword(0);
+            a.label("end"s);
+
+            CHECK_PROGRAM(a, 0x1000, B(6, 0, 0, 0, 0, 0));
+        }
+
+        BOOST_AUTO_TEST_CASE(symbol_plus_offset)
+        {
+            divided_thumb_assembler a;
+
+            a.b(symbol("target"s) + 2);
+            a.label("target"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0xe000, 0x2001, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(loop_count)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r1, (symbol("table_end"s) - symbol("table"s)) / 4);
+            a.bx(lr);
+            a.align(2);
+            a.label("table"s);
+            a.word(1, 2, 3);
+            a.label("table_end"s);
+
+            CHECK_PROGRAM(a, 0, H(0x2103, 0x4770, 1, 0, 2, 0, 3, 0));
+        }
+
+        BOOST_AUTO_TEST_CASE(bytes_of_an_address)
+        {
+            divided_thumb_assembler a;
+
+            a.byte(symbol("data"s) >> 8, symbol("data"s) & 255);
+            a.label("data"s);
+
+            CHECK_PROGRAM(a, 0x1200, B(0x12, 0x02));
+        }
+
+        BOOST_AUTO_TEST_CASE(result_is_range_checked)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, symbol("end"s) - symbol("start"s));
+            a.label("start"s);
+            space(a, 256);
+            a.label("end"s);
+
+            CHECK_LINK_THROWS(a, 0, is_immediate_out_of_range);
+        }
+
+        BOOST_AUTO_TEST_CASE(negative_result_of_add_is_rejected)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.add(r0, symbol("start"s) - symbol("end"s));
+            a.label("end"s);
+
+            CHECK_LINK_THROWS(a, 0, is_immediate_out_of_range);
+        }
+
+        BOOST_AUTO_TEST_CASE(result_is_alignment_checked)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.ldr(r0, r1, symbol("end"s) - symbol("start"s));
+            a.label("end"s);
+
+            CHECK_LINK_THROWS(a, 0, is_misaligned_immediate_value);
+        }
+
+        BOOST_AUTO_TEST_CASE(undefined_symbol_in_expression)
+        {
+            divided_thumb_assembler a;
+
+            a.word(symbol("undefined"s) + 4);
+
+            CHECK_LINK_THROWS(a, 0, is_undefined_symbol);
+        }
+
+        BOOST_AUTO_TEST_CASE(division_by_zero)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.label("end"s);
+            a.word(symbol("start"s) / (symbol("end"s) - symbol("start"s)));
+
+            CHECK_LINK_THROWS(a, 0x100, is_division_by_zero);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,118 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <optional>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+namespace
+{
+
+// Resolves the symbols of an address map and counts the lookups.
+class address_map final
+{
+public:
+    std::optional<address_t> operator()(const symbol<std::string>& s)
+    {
+        ++lookups;
+        auto entry = addresses.find(s.name);
+        return entry != addresses.end() ? std::optional<address_t>(entry->second) : std::nullopt;
+    }
+
+    std::map<std::string, address_t> addresses;
+    int lookups = 0;
+};
+
+}
+
+#define CHECK_EXTERNAL_PROGRAM(assembler, origin, resolver, ...)                \
+{                                                                               \
+    auto program = assembler.link(origin, std::ref(resolver));                  \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                           \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());    \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(external_symbols)
+
+        BOOST_AUTO_TEST_CASE(address_is_absolute)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "bios_entry", 0x80001234 } } };
+
+            a.word("bios_entry"s);
+
+            CHECK_EXTERNAL_PROGRAM(a, 0x1000, resolver, H(0x1234, 0x8000));
+        }
+
+        BOOST_AUTO_TEST_CASE(branch)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "rom_function", 0x08000100 } } };
+
+            a.bl("rom_function"s);
+
+            CHECK_EXTERNAL_PROGRAM(a, 0x08000000, resolver, H(0xf000, 0xf87e));
+        }
+
+        BOOST_AUTO_TEST_CASE(literal_and_expression)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "io_base", 0x04000000 } } };
+
+            a.ldr(r0, symbol("io_base"s) + 0x208);
+
+            CHECK_EXTERNAL_PROGRAM(a, 0, resolver, H(0x4800, 0, 0x0208, 0x0400));
+        }
+
+        BOOST_AUTO_TEST_CASE(each_symbol_is_looked_up_once)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "a", 0x100 }, { "b", 0x200 }, { "unused", 0x300 } } };
+
+            a.word("a"s, "a"s, "b"s, symbol("a"s) + 4);
+
+            CHECK_EXTERNAL_PROGRAM(a, 0, resolver, H(0x100, 0, 0x100, 0, 0x200, 0, 0x104, 0));
+            BOOST_CHECK_EQUAL(2, resolver.lookups);
+        }
+
+        BOOST_AUTO_TEST_CASE(local_symbols_and_constants_are_not_looked_up)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "local", 0x100 }, { "constant", 0x200 } } };
+
+            a.label("local"s);
+            a.word("local"s, "constant"s);
+            a.equ("constant"s, 4);
+
+            CHECK_EXTERNAL_PROGRAM(a, 0x1000, resolver, H(0x1000, 0, 4, 0));
+            BOOST_CHECK_EQUAL(0, resolver.lookups);
+        }
+
+        BOOST_AUTO_TEST_CASE(unknown_symbol)
+        {
+            divided_thumb_assembler a;
+            address_map resolver{ { { "known", 0x100 } } };
+
+            a.word("unknown"s);
+
+            BOOST_CHECK_EXCEPTION(a.link(0, std::ref(resolver)), std::runtime_error, is_undefined_symbol);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,145 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(function_frame)
+
+        BOOST_AUTO_TEST_CASE(leaf_function_without_frame)
+        {
+            divided_thumb_assembler a;
+
+            a.b("function"s);
+            a.label("function"s);
+            a.begin_function();
+            a.mov(r0, 1);
+            a.ret();
+            a.end_function();
+
+            CHECK_PROGRAM(a, 0, H(0xe7ff, 0x2001, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(leaf_function_optimized_for_size_returns_with_pop_pc)
+        {
+            divided_thumb_assembler a;
+
+            a.begin_function();
+            a.mov(r4, 1);
+            a.mov(r0, r4);
+            a.ret();
+            a.end_function();
+
+            CHECK_PROGRAM(a, 0, H(0xb510, 0x2401, 0x1c20, 0xbd10));
+        }
+
+        BOOST_AUTO_TEST_CASE(leaf_function_optimized_for_speed_does_not_save_lr)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::speed);
+
+            a.begin_function();
+            a.mov(r4, 1);
+            a.mov(r0, r4);
+            a.ret();
+            a.end_function();
+
+            CHECK_PROGRAM(a, 0, H(0xb410, 0x2401, 0x1c20, 0xbc10, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(calls_save_lr)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::speed);
+
+            a.begin_function();
+            a.bl("callee"s);
+            a.ret();
+            a.end_function();
+            a.label("callee"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0xb500, 0xf000, 0xf801, 0xbd00, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(registers_written_in_arm_state_are_saved)
+        {
+            divided_thumb_assembler a;
+
+            a.begin_function();
+            a.udiv_const(r4, r0, 7, r1);
+            a.mov(r0, r4);
+            a.ret();
+            a.end_function();
+
+            CHECK_PROGRAM(a, 0, H(
+                0xb510,                 // push {r4, lr}
+                0x4908,                 // ldr r1, =0x24924925
+                0x4778,                 // bx pc
+                0x46c0,                 // nop
+                0x1190, 0xe084,         // umull r1, r4, r0, r1
+                0x1004, 0xe040,         // sub r1, r0, r4
+                0x40a1, 0xe084,         // add r4, r4, r1, lsr #1
+                0x4124, 0xe1a0,         // mov r4, r4, lsr #2
+                0x1001, 0xe28f,         // add r1, pc, #1
+                0xff11, 0xe12f,         // bx r1
+                0x1c20,                 // mov r0, r4
+                0xbd10,                 // pop {r4, pc}
+                0x4925, 0x2492));
+        }
+
+        BOOST_AUTO_TEST_CASE(every_return_gets_an_epilogue)
+        {
+            divided_thumb_assembler a;
+            a.optimize_for(optimization_goal::speed);
+
+            a.begin_function();
+            a.cmp(r0, 0);
+            a.beq("zero"s);
+            a.mov(r4, 1);
+            a.ret();
+            a.label("zero"s);
+            a.mov(r5, 0);
+            a.ret();
+            a.end_function();
+
+            CHECK_PROGRAM(a, 0, H(0xb430, 0x2800, 0xd002, 0x2401, 0xbc30, 0x4770, 0x2500, 0xbc30, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(return_outside_of_function)
+        {
+            CHECK_THROWS(ret(), is_no_function_open);
+        }
+
+        BOOST_AUTO_TEST_CASE(functions_cannot_be_nested)
+        {
+            divided_thumb_assembler a;
+            a.begin_function();
+            BOOST_CHECK_EXCEPTION(a.begin_function(), std::runtime_error, is_function_already_open);
+        }
+
+        BOOST_AUTO_TEST_CASE(function_must_be_ended_before_link)
+        {
+            divided_thumb_assembler a;
+            a.begin_function();
+            a.ret();
+            CHECK_LINK_THROWS(a, 0, is_function_not_ended);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
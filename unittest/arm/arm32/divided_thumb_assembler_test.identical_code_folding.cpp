@@ -0,0 +1,221 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_FOLDED_PROGRAM(assembler, origin, ...)                                                \
+{                                                                                                   \
+    auto program = assembler.link(origin, { .fold_identical_code = true });                         \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+#define CHECK_REPORT(assembler, routines, bytes)                                                    \
+{                                                                                                   \
+    const auto& report = assembler.last_folding_report();                                           \
+    BOOST_TEST(report.folded_routines == routines##u);                                              \
+    BOOST_TEST(report.saved_bytes == bytes##u);                                                     \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(identical_code_folding)
+
+        BOOST_AUTO_TEST_CASE(is_off_by_default)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("f2"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x2001, 0x4770, 0x2001, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(identical_routines_are_folded)
+        {
+            divided_thumb_assembler a;
+
+            a.label("main"s);
+            a.bl("f1"s);
+            a.bl("f2"s);
+            a.bx(lr);
+            a.label("f1"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("f2"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            // Both calls go to f1.
+            CHECK_FOLDED_PROGRAM(a, 0, H(0xf000, 0xf803, 0xf000, 0xf801, 0x4770, 0x2001, 0x4770));
+            CHECK_REPORT(a, 1, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(routines_with_different_targets_are_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.b("x"s);
+            a.label("f2"s);
+            a.b("y"s);
+            a.label("x"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("y"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0xe000, 0xe001, 0x2001, 0x4770, 0x2002, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(routines_become_identical_when_their_targets_are_folded)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.b("x"s);
+            a.label("f2"s);
+            a.b("y"s);
+            a.label("x"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("y"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0xe7ff, 0x2001, 0x4770));
+            CHECK_REPORT(a, 2, 6);
+        }
+
+        BOOST_AUTO_TEST_CASE(references_to_the_routine_itself_are_compared_by_offset)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.sub(r0, 1);
+            a.bne("f1"s);
+            a.bx(lr);
+            a.label("f2"s);
+            a.sub(r0, 1);
+            a.bne("f2"s);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x3801, 0xd1fd, 0x4770));
+            CHECK_REPORT(a, 1, 6);
+        }
+
+        BOOST_AUTO_TEST_CASE(literal_loads_are_compared_by_value)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.ldr(r0, 0x12345678);
+            a.bx(lr);
+            a.label("f2"s);
+            a.ldr(r0, 0x12345678);
+            a.bx(lr);
+            a.label("f3"s);
+            a.ldr(r0, 0x12345679);
+            a.bx(lr);
+
+            // f3 loads another value, so it is kept. The literal pool moves closer.
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x4801, 0x4770, 0x4801, 0x4770, 0x5678, 0x1234, 0x5679, 0x1234));
+            CHECK_REPORT(a, 1, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(routine_falling_through_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.mov(r0, 1);
+            a.label("f2"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("f3"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x2001, 0x2001, 0x4770));
+            CHECK_REPORT(a, 1, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(routine_fallen_into_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+            a.label("f0"s);
+            a.mov(r1, 1);
+            a.label("f2"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+            a.label("g"s);
+            a.mov(r3, 3);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x2002, 0x4770, 0x2101, 0x2002, 0x4770, 0x2303, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(routine_fallen_into_after_padding_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+            a.label("f0"s);
+            a.mov(r1, 1);
+            a.align(2);
+            a.label("f2"s);
+            a.mov(r0, 2);
+            a.bx(lr);
+
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x2002, 0x4770, 0x2101, 0x0000, 0x2002, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(routine_entered_in_the_middle_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("f1"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("f2"s);
+            a.mov(r0, 1);
+            a.bx(lr);
+            a.label("f3"s);
+            a.b(2 + 4);
+
+            // f3 branches to the bx lr of f2.
+            CHECK_FOLDED_PROGRAM(a, 0, H(0x2001, 0x4770, 0x2001, 0x4770, 0xe7fd));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
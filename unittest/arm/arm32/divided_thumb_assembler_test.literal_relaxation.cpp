@@ -0,0 +1,269 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_RELAXED_PROGRAM(assembler, origin, relaxation, ...)                                   \
+{                                                                                                   \
+    auto program = assembler.link(origin, { .relax_literals = relaxation });                       \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(relax_literals)
+
+        BOOST_AUTO_TEST_CASE(small_constant_is_replaced_by_mov)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 42);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x202a, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(flag_preserving_relaxation_does_not_use_mov)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 42);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::flag_preserving, H(0x4800, 0x0000, 0x002a, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(shifted_constant_is_replaced_by_mov_and_lsl)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r1, 0x03000000);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2103, 0x0609, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(inverted_constant_is_replaced_by_mov_and_mvn)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r2, 0xffffff00);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x22ff, 0x43d2, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(forward_symbol_is_replaced_by_adr)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, "data"s);
+            a.bx(lr);
+            a.align(2);
+            a.label("data"s);
+            a.word(0x12345678);
+
+            CHECK_RELAXED_PROGRAM(a, 0x100, literal_relaxation::flag_preserving, H(0xa000, 0x4770, 0x5678, 0x1234));
+        }
+
+        BOOST_AUTO_TEST_CASE(symbol_with_small_value_is_replaced_by_mov)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.ldr(r0, "start"s);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2000, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(load_before_a_flag_reading_instruction_is_not_replaced_by_mov)
+        {
+            divided_thumb_assembler a;
+
+            a.cmp(r1, 0);
+            a.ldr(r0, 42);
+            a.beq("done"s);
+            a.mov(r0, 0);
+            a.label("done"s);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2900, 0x4802, 0xd000, 0x2000, 0x4770, 0x0000, 0x002a, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(calls_clobber_the_flags)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 42);
+            a.bl("callee"s);
+            a.bx(lr);
+            a.label("callee"s);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x202a, 0xf000, 0xf801, 0x4770, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(backward_symbol_is_not_replaced_by_adr)
+        {
+            divided_thumb_assembler a;
+
+            a.label("start"s);
+            a.ldr(r0, "start"s);
+
+            CHECK_RELAXED_PROGRAM(a, 0x1000, literal_relaxation::flag_preserving, H(0x4800, 0x0000, 0x1000, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(pool_entry_is_kept_if_any_load_cannot_be_replaced)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, "data"s);
+            a.b("skip"s);
+            a.label("data"s);
+            a.word(0x11111111);
+            a.label("skip"s);
+            a.ldr(r1, "data"s);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::flag_preserving, H(0xa000, 0xe001, 0x1111, 0x1111, 0x4900, 0x0000, 0x0004, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(constant_used_by_several_loads_is_not_replaced_by_longer_sequences)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 0x03000000);
+            a.ldr(r1, 0x03000000);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x4800, 0x4900, 0x0000, 0x0300));
+        }
+
+        BOOST_AUTO_TEST_CASE(removing_pool_moves_code_and_symbols)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 1);
+            a.bx(lr);
+            a.pool();
+            a.label("loop"s);
+            a.b("loop"s);
+            a.align(2);
+            a.label("data"s);
+            a.word("data"s);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2001, 0x4770, 0xe7fe, 0x0000, 0x0008, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(alignment_is_recomputed)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 1);
+            a.bx(lr);
+            a.pool();
+            a.nop();
+            a.label("before_align"s);
+            a.align(2);
+            a.label("after_align"s);
+            a.word("before_align"s, "after_align"s);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2001, 0x4770, 0x46c0, 0x0000, 0x0006, 0x0000, 0x0008, 0x0000));
+        }
+
+        BOOST_AUTO_TEST_CASE(constant_pc_relative_offsets_follow_their_targets)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r1, pc, 8);
+            a.ldr(r0, 5);
+            a.bx(lr);
+            a.pool();
+            a.align(2);
+            a.word(0xcafebabe);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x4901, 0x2005, 0x4770, 0x0000, 0xbabe, 0xcafe));
+        }
+
+        BOOST_AUTO_TEST_CASE(constant_branch_targets_follow_the_code)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 5);
+            a.b(8);
+            a.pool();
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2005, 0xe7ff, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(remaining_loads_are_fixed_after_relaxation)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, 1);
+            a.ldr(r1, 0x12345678);
+            a.bx(lr);
+
+            CHECK_RELAXED_PROGRAM(a, 0, literal_relaxation::all, H(0x2001, 0x4901, 0x4770, 0x0000, 0x5678, 0x1234));
+        }
+
+        BOOST_AUTO_TEST_CASE(replacement_pushing_other_loads_out_of_range_is_not_made)
+        {
+            divided_thumb_assembler a;
+
+            a.nop();
+            a.ldr(r1, 0x12345678);
+            a.ldr(r0, 0x10000);
+            for (int i = 0; i < 509; ++i)
+            {
+                a.nop();
+            }
+            a.pool();
+
+            // Replacing the second load by mov and lsl would move the pool 1024 bytes away from the first load.
+            auto program = a.link(0, { .relax_literals = literal_relaxation::all });
+            BOOST_TEST(program.size() == 1032u);
+            program.erase(program.begin() + 6, program.end() - 8);
+            BOOST_TEST(
+                program == to_bytevector(H(0x46c0, 0x49ff, 0x48ff, 0x5678, 0x1234, 0x0000, 0x0001)),
+                boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(replacement_pushing_branches_out_of_range_is_not_made)
+        {
+            divided_thumb_assembler a;
+
+            a.beq("target"s);
+            a.ldr(r0, 0x10000);
+            for (int i = 0; i < 127; ++i)
+            {
+                a.nop();
+            }
+            a.label("target"s);
+            a.bx(lr);
+
+            // Replacing the load by mov and lsl would move the target 256 bytes away from the branch.
+            auto program = a.link(0, { .relax_literals = literal_relaxation::all });
+            BOOST_TEST(program.size() == 264u);
+            program.erase(program.begin() + 4, program.end() - 6);
+            BOOST_TEST(
+                program == to_bytevector(H(0xd07f, 0x4840, 0x4770, 0x0000, 0x0001)),
+                boost::test_tools::per_element());
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_SCHEDULED_PROGRAM(assembler, origin, ...)                                             \
+{                                                                                                   \
+    auto program = assembler.link(origin, { .schedule_loads = true });                              \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+#define CHECK_REPORT(assembler, instructions, cycles)                                               \
+{                                                                                                   \
+    const auto& report = assembler.last_scheduling_report();                                        \
+    BOOST_TEST(report.moved_instructions == instructions##u);                                       \
+    BOOST_TEST(report.saved_cycles == cycles##u);                                                   \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(load_scheduling)
+
+        BOOST_AUTO_TEST_CASE(is_off_by_default)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, r1, 0);
+            a.add(r0, 1);
+            a.mov(r8, r2);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x6808, 0x3001, 0x4690, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(later_instruction_fills_load_delay)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, r1, 0);
+            a.add(r0, 1);
+            a.mov(r8, r2);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x6808, 0x4690, 0x3001, 0x4770));
+            CHECK_REPORT(a, 2, 1);
+        }
+
+        BOOST_AUTO_TEST_CASE(load_is_moved_up)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r8, r2);
+            a.ldrh(r0, r1, 0);
+            a.add(r0, 1);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x8808, 0x4690, 0x3001, 0x4770));
+            CHECK_REPORT(a, 2, 1);
+        }
+
+        BOOST_AUTO_TEST_CASE(dependent_instruction_is_not_moved)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, r1, 0);
+            a.add(r0, 1);
+            a.mov(r8, r0);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x6808, 0x3001, 0x4680, 0x4770));
+            CHECK_REPORT(a, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(live_flags_are_preserved)
+        {
+            divided_thumb_assembler a;
+
+            // mov sets N and Z, which are returned to the caller.
+            a.ldrb(r0, r1, 0);
+            a.add(r0, 1);
+            a.mov(r2, 5);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x7808, 0x3001, 0x2205, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(dead_flags_do_not_prevent_reordering)
+        {
+            divided_thumb_assembler a;
+
+            a.ldrb(r0, r1, 0);
+            a.add(r0, 1);
+            a.mov(r2, 5);
+            a.cmp(r3, r4);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x7808, 0x2205, 0x3001, 0x42a3, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(load_is_not_moved_above_store)
+        {
+            divided_thumb_assembler a;
+
+            a.str(r2, r3, 0);
+            a.ldr(r0, r1, 0);
+            a.add(r0, 1);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x601a, 0x6808, 0x3001, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(instructions_are_not_moved_across_labels)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, r1, 0);
+            a.add(r0, 1);
+            a.label("entry"s);
+            a.mov(r8, r2);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x6808, 0x3001, 0x4690, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(literal_load_stays_in_place)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r8, r2);
+            a.ldr(r0, 0x12345678);
+            a.add(r0, 1);
+            a.bx(lr);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x4690, 0x4801, 0x3001, 0x4770, 0x5678, 0x1234));
+        }
+
+        BOOST_AUTO_TEST_CASE(use_after_region_counts)
+        {
+            divided_thumb_assembler a;
+
+            a.ldr(r0, r1, 0);
+            a.mov(r8, r2);
+            a.ldr(r3, r1, 4);
+            a.bx(r3);
+
+            CHECK_SCHEDULED_PROGRAM(a, 0, H(0x6808, 0x684b, 0x4690, 0x4718));
+            CHECK_REPORT(a, 2, 1);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(mergeable_data)
+
+        BOOST_AUTO_TEST_CASE(mergeable_data_is_placed_after_the_code)
+        {
+            divided_thumb_assembler a;
+
+            a.word("s"s);
+            a.mergeable_data("s"s, [&] { a.asciz("abc"); });
+            a.word(1);
+
+            CHECK_PROGRAM(a, 0x100, B(0x08, 0x01, 0, 0, 0x01, 0, 0, 0, 'a', 'b', 'c', 0));
+        }
+
+        BOOST_AUTO_TEST_CASE(identical_blocks_are_merged)
+        {
+            divided_thumb_assembler a;
+
+            a.word("s1"s, "s2"s);
+            a.mergeable_data("s1"s, [&] { a.asciz("abc"); });
+            a.mergeable_data("s2"s, [&] { a.asciz("abc"); });
+
+            CHECK_PROGRAM(a, 0, B(0x08, 0, 0, 0, 0x08, 0, 0, 0, 'a', 'b', 'c', 0));
+        }
+
+        BOOST_AUTO_TEST_CASE(block_at_the_end_of_another_block_is_merged)
+        {
+            divided_thumb_assembler a;
+
+            a.word("short"s, "long"s);
+            a.mergeable_data("short"s, [&] { a.asciz("lo"); });
+            a.mergeable_data("long"s, [&] { a.asciz("hello"); });
+
+            CHECK_PROGRAM(a, 0, B(0x0b, 0, 0, 0, 0x08, 0, 0, 0, 'h', 'e', 'l', 'l', 'o', 0));
+        }
+
+        BOOST_AUTO_TEST_CASE(alignment_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.word("h1"s, "h2"s, "b"s);
+            a.mergeable_data("b"s, [&] { a.byte(1, 2, 3, 4, 5); });
+            a.mergeable_data("h1"s, 1, [&] { a.hword(0x0504); });
+            a.mergeable_data("h2"s, 1, [&] { a.hword(0x0302, 0x0504); });
+
+            // h1 is the end of h2. It is also the end of b, but b is not aligned.
+            CHECK_PROGRAM(
+                a, 0,
+                B(0x14, 0, 0, 0, 0x12, 0, 0, 0, 0x0c, 0, 0, 0,
+                  1, 2, 3, 4, 5, 0, 2, 3, 4, 5));
+        }
+
+        BOOST_AUTO_TEST_CASE(references_must_match)
+        {
+            divided_thumb_assembler a;
+
+            a.label("x"s);
+            a.word("p1"s, "p2"s, "p3"s);
+            a.label("y"s);
+            a.mergeable_data("p1"s, [&] { a.word("x"s); });
+            a.mergeable_data("p2"s, [&] { a.word("y"s); });
+            a.mergeable_data("p3"s, [&] { a.word("x"s); });
+
+            CHECK_PROGRAM(a, 0, W(0x0c, 0x10, 0x0c, 0x00, 0x0c));
+        }
+
+        BOOST_AUTO_TEST_CASE(instructions_are_rejected)
+        {
+            divided_thumb_assembler a;
+
+            BOOST_CHECK_EXCEPTION(a.mergeable_data("s"s, [&] { a.bx(lr); }), std::runtime_error, is_mergeable_data_contains_non_data);
+        }
+
+        BOOST_AUTO_TEST_CASE(labels_are_rejected)
+        {
+            divided_thumb_assembler a;
+
+            BOOST_CHECK_EXCEPTION(a.mergeable_data("s"s, [&] { a.label("t"s); a.byte(0); }), std::runtime_error, is_mergeable_data_contains_non_data);
+        }
+
+        BOOST_AUTO_TEST_CASE(label_must_be_unique)
+        {
+            divided_thumb_assembler a;
+
+            a.label("s"s);
+
+            BOOST_CHECK_EXCEPTION(a.mergeable_data("s"s, [&] { a.byte(0); }), std::runtime_error, is_symbol_already_defined);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
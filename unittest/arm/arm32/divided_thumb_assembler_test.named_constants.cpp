@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(named_constants)
+
+        BOOST_AUTO_TEST_CASE(equ)
+        {
+            divided_thumb_assembler a;
+
+            a.equ("ctx_table_offset"s, 16);
+            a.ldr(r0, r1, "ctx_table_offset"s);
+            a.mov(r1, symbol("ctx_table_offset"s) + 1);
+
+            CHECK_PROGRAM(a, 0, H(0x6908, 0x2111));
+        }
+
+        BOOST_AUTO_TEST_CASE(constant_defined_by_constants)
+        {
+            divided_thumb_assembler a;
+
+            a.equ("entry_size"s, 4);
+            a.equ("table_size"s, symbol("entry_size"s) * 8);
+            a.mov(r0, "table_size"s);
+
+            CHECK_PROGRAM(a, 0, H(0x2020));
+        }
+
+        BOOST_AUTO_TEST_CASE(negative_constant_turns_add_into_sub)
+        {
+            divided_thumb_assembler a;
+
+            a.equ("delta"s, -4);
+            a.add(r0, "delta"s);
+
+            CHECK_PROGRAM(a, 0, H(0x3804));
+        }
+
+        BOOST_AUTO_TEST_CASE(asr_by_zero_constant)
+        {
+            divided_thumb_assembler a;
+
+            a.equ("shift"s, 0);
+            a.asr(r0, r1, "shift"s);
+
+            CHECK_PROGRAM(a, 0, H(0x0008));
+        }
+
+        BOOST_AUTO_TEST_CASE(literal)
+        {
+            divided_thumb_assembler a;
+
+            a.equ("magic"s, 0x12345678);
+            a.ldr(r0, "magic"s);
+
+            CHECK_PROGRAM(a, 0, H(0x4800, 0, 0x5678, 0x1234));
+        }
+
+        BOOST_AUTO_TEST_CASE(range_is_checked_when_emitting)
+        {
+            CHECK_THROWS(equ("big"s, 256).mov(r0, "big"s), is_immediate_out_of_range);
+            CHECK_THROWS(equ("odd"s, 6).ldr(r0, r1, "odd"s), is_misaligned_immediate_value);
+        }
+
+        BOOST_AUTO_TEST_CASE(forward_reference_is_resolved_by_link)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r0, "later"s);
+            a.equ("later"s, 3);
+
+            CHECK_PROGRAM(a, 0, H(0x2003));
+        }
+
+        BOOST_AUTO_TEST_CASE(set)
+        {
+            divided_thumb_assembler a;
+
+            a.set("n"s, 1);
+            a.mov(r0, "n"s);
+            a.set("n"s, symbol("n"s) + 1);
+            a.mov(r0, "n"s);
+
+            CHECK_PROGRAM(a, 0, H(0x2001, 0x2002));
+        }
+
+        BOOST_AUTO_TEST_CASE(symbol_already_defined)
+        {
+            CHECK_THROWS(equ("x"s, 1).equ("x"s, 2), is_symbol_already_defined);
+            CHECK_THROWS(equ("x"s, 1).set("x"s, 2), is_symbol_already_defined);
+            CHECK_THROWS(set("x"s, 1).equ("x"s, 2), is_symbol_already_defined);
+            CHECK_THROWS(label("x"s).equ("x"s, 1), is_symbol_already_defined);
+            CHECK_THROWS(equ("x"s, 1).label("x"s), is_symbol_already_defined);
+        }
+
+        BOOST_AUTO_TEST_CASE(value_of_constant_not_known)
+        {
+            CHECK_THROWS(equ("x"s, symbol("label"s)), is_value_of_constant_not_known);
+            CHECK_THROWS(equ("x"s, symbol("undefined"s) + 1), is_value_of_constant_not_known);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,269 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+#define CHECK_OPTIMIZED_PROGRAM(assembler, origin, ...)                                             \
+{                                                                                                   \
+    auto program = assembler.link(origin, { .peephole = true });                                    \
+    auto expected_bytes = to_bytevector(__VA_ARGS__);                                               \
+    BOOST_TEST(program == expected_bytes, boost::test_tools::per_element());                        \
+}
+
+#define CHECK_REPORT(assembler, instructions, bytes, cycles)                                        \
+{                                                                                                   \
+    const auto& report = assembler.last_peephole_report();                                          \
+    BOOST_TEST(report.removed_instructions == instructions##u);                                     \
+    BOOST_TEST(report.saved_bytes == bytes##u);                                                     \
+    BOOST_TEST(report.saved_cycles == cycles##u);                                                   \
+}
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(peephole)
+
+        BOOST_AUTO_TEST_CASE(is_off_by_default)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r9, r9);
+
+            CHECK_PROGRAM(a, 0, H(0x46c9));
+            CHECK_REPORT(a, 0, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(high_register_move_to_itself_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r9, r9);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x4770));
+            CHECK_REPORT(a, 1, 2, 1);
+        }
+
+        BOOST_AUTO_TEST_CASE(nop_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.nop();
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x46c0, 0x4770));
+            CHECK_REPORT(a, 0, 0, 0);
+        }
+
+        BOOST_AUTO_TEST_CASE(add_zero_with_dead_flags_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.add(r0, 0);
+            a.add(r1, r1, 0);
+            a.add(sp, 0);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x4291, 0x4770));
+            CHECK_REPORT(a, 3, 6, 3);
+        }
+
+        BOOST_AUTO_TEST_CASE(add_zero_with_live_flags_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            // The flags are returned to the caller.
+            a.add(r0, 0);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3000, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(flags_are_followed_through_branches)
+        {
+            divided_thumb_assembler a;
+
+            a.add(r0, 0);
+            a.b("target"s);
+            a.bx(lr);
+            a.label("target"s);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0xe000, 0x4770, 0x4291, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(flags_read_at_branch_target_are_live)
+        {
+            divided_thumb_assembler a;
+
+            a.add(r0, 0);
+            a.b("target"s);
+            a.bx(lr);
+            a.label("target"s);
+            a.adc(r0, r1);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3000, 0xe000, 0x4770, 0x4148, 0x4291, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(instruction_with_fixup_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.label("zero"s);
+            a.add(r0, "zero"s);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3000, 0x4291, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(push_followed_by_pop_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.push(r4, r5);
+            a.pop(r4, r5);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x4770));
+            CHECK_REPORT(a, 2, 4, 7);
+        }
+
+        BOOST_AUTO_TEST_CASE(push_followed_by_labelled_pop_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.push(r4);
+            a.label("restore"s);
+            a.pop(r4);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0xb410, 0xbc10, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(push_followed_by_different_pop_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.push(r4);
+            a.pop(r5);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0xb410, 0xbc20, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(branches_to_next_instruction_are_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.b("next"s);
+            a.label("next"s);
+            a.bne("last"s);
+            a.label("last"s);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0x100, H(0x4770));
+            CHECK_REPORT(a, 2, 4, 4);
+        }
+
+        BOOST_AUTO_TEST_CASE(numeric_branch_to_next_instruction_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.b(0x102);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0x100, H(0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(cmp_zero_after_flag_setting_instruction_is_removed)
+        {
+            divided_thumb_assembler a;
+
+            a.label("loop"s);
+            a.sub(r0, 1);
+            a.cmp(r0, 0);
+            a.bne("loop"s);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3801, 0xd1fd, 0x4291, 0x4770));
+            CHECK_REPORT(a, 1, 2, 1);
+        }
+
+        BOOST_AUTO_TEST_CASE(cmp_zero_is_kept_if_c_is_live)
+        {
+            divided_thumb_assembler a;
+
+            // sub sets C differently from cmp #0.
+            a.sub(r0, 1);
+            a.cmp(r0, 0);
+            a.bhi("done"s);
+            a.mov(r0, 0);
+            a.label("done"s);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3801, 0x2800, 0xd800, 0x2000, 0x4291, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(cmp_zero_of_other_register_is_kept)
+        {
+            divided_thumb_assembler a;
+
+            a.sub(r0, 1);
+            a.cmp(r1, 0);
+            a.beq("done"s);
+            a.label("done"s);
+            a.cmp(r1, r2);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x3801, 0x2900, 0x4291, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(removals_expose_new_opportunities)
+        {
+            divided_thumb_assembler a;
+
+            a.push(r4);
+            a.mov(r9, r9);
+            a.pop(r4);
+            a.bx(lr);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x4770));
+            CHECK_REPORT(a, 3, 6, 6);
+        }
+
+        BOOST_AUTO_TEST_CASE(symbols_and_literals_move_along)
+        {
+            divided_thumb_assembler a;
+
+            a.mov(r9, r9);
+            a.ldr(r0, "data"s);
+            a.bx(lr);
+            a.align(2);
+            a.label("data"s);
+            a.word(0x12345678);
+
+            CHECK_OPTIMIZED_PROGRAM(a, 0, H(0x4801, 0x4770, 0x5678, 0x1234, 0x0004, 0x0000));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
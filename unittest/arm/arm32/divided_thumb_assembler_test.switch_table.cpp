@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include <vector>
+#include "lzasm/arm/arm32/divided_thumb_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(divided_thumb_assembler_test)
+
+    BOOST_AUTO_TEST_SUITE(switch_table)
+
+        BOOST_AUTO_TEST_CASE(near_labels_get_a_byte_table)
+        {
+            divided_thumb_assembler a;
+
+            a.switch_table(r0, "a"s, "b"s, "c"s);
+            a.bx(lr);
+            a.label("a"s);
+            a.mov(r0, 1);
+            a.label("b"s);
+            a.mov(r0, 2);
+            a.label("c"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(
+                a, 0,
+                H(0x2802, 0xd805,                       // cmp r0, #2; bhi default
+                  0x4478, 0x7900, 0x0040, 0x4487,       // add r0, pc; ldrb r0, [r0, #4]; lsl r0, r0, #1; add pc, r0
+                  0x0302, 0x0004,                       // Offsets / 2, padding byte
+                  0x4770,                               // default
+                  0x2001, 0x2002, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(far_labels_get_a_halfword_table)
+        {
+            divided_thumb_assembler a;
+
+            a.switch_table(r2, "a"s, "b"s);
+            a.label("a"s);
+            a.bx(lr);
+            for (int i = 0; i < 300; ++i)
+            {
+                a.nop();
+            }
+            a.label("b"s);
+            a.bx(lr);
+
+            auto program = a.link(0);
+            program.resize(18);
+            BOOST_TEST(
+                program == to_bytevector(H(0x2a01, 0xd805, 0x0052, 0x447a, 0x8852, 0x4497, 0x0002, 0x025c, 0x4770)),
+                boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(single_entry_is_not_shrunk)
+        {
+            divided_thumb_assembler a;
+
+            a.switch_table(r1, "a"s);
+            a.label("a"s);
+            a.bx(lr);
+
+            CHECK_PROGRAM(a, 0, H(0x2900, 0xd804, 0x0049, 0x4479, 0x8849, 0x448f, 0x0000, 0x4770));
+        }
+
+        BOOST_AUTO_TEST_CASE(bounds_check_of_large_tables_uses_unconditional_branch)
+        {
+            divided_thumb_assembler a;
+            std::vector<divided_thumb_assembler::immediate> labels(200, "a"s);
+
+            a.switch_table(r0, labels);
+            a.label("a"s);
+            a.bx(lr);
+
+            // cmp r0, #199; bls dispatch; b default, then 100 bytes of table
+            auto program = a.link(0);
+            BOOST_TEST(program.size() == 14u + 200u + 2u);
+            program.resize(6);
+            BOOST_TEST(program == to_bytevector(H(0x28c7, 0xd900, 0xe067)), boost::test_tools::per_element());
+        }
+
+        BOOST_AUTO_TEST_CASE(labels_must_follow_table)
+        {
+            divided_thumb_assembler a;
+
+            a.label("a"s);
+            a.switch_table(r0, "a"s);
+
+            CHECK_LINK_THROWS(a, 0, is_immediate_out_of_range);
+        }
+
+        BOOST_AUTO_TEST_CASE(number_of_entries_must_be_in_range)
+        {
+            divided_thumb_assembler a;
+            std::vector<divided_thumb_assembler::immediate> labels(257, "a"s);
+
+            BOOST_CHECK_EXCEPTION(a.switch_table(r0, std::vector<divided_thumb_assembler::immediate>()), std::runtime_error, is_invalid_number_of_switch_table_entries);
+            BOOST_CHECK_EXCEPTION(a.switch_table(r0, labels), std::runtime_error, is_invalid_number_of_switch_table_entries);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <bit>
+#include <cstdint>
+#include <vector>
+#include "lzasm/arm/arm32/detail/division_magic.hpp"
+
+namespace lzasm_unittest
+{
+
+using ::lzasm::arm::arm32::detail::get_signed_division_magic;
+using ::lzasm::arm::arm32::detail::get_unsigned_division_magic;
+
+namespace
+{
+
+// Emulates the instruction sequence generated for udiv_const.
+uint32_t unsigned_divide(uint32_t x, uint32_t d)
+{
+    auto magic = get_unsigned_division_magic(d);
+    auto t = static_cast<uint32_t>((uint64_t(x) * magic.multiplier) >> 32);
+    auto q = magic.add ? (((x - t) >> 1) + t) : t;
+    return q >> magic.shift;
+}
+
+// Emulates the instruction sequence generated for sdiv_const.
+int32_t signed_divide(int32_t x, int32_t d)
+{
+    auto magic = get_signed_division_magic(d);
+    auto t = static_cast<uint32_t>((int64_t(x) * magic.multiplier) >> 32);
+    if (magic.add_dividend)
+    {
+        t += static_cast<uint32_t>(x);
+    }
+    if (magic.subtract_dividend)
+    {
+        t -= static_cast<uint32_t>(x);
+    }
+    auto q = static_cast<int32_t>(t) >> magic.shift;
+    return static_cast<int32_t>(static_cast<uint32_t>(q) + (static_cast<uint32_t>(q) >> 31));
+}
+
+std::vector<uint32_t> get_divisors()
+{
+    std::vector<uint32_t> divisors;
+    for (uint32_t d = 3; d < 1000; ++d)
+    {
+        divisors.push_back(d);
+    }
+    for (uint32_t d : { 641u, 6700417u, 0x7fffffffu, 0x80000001u, 0xfffffffeu, 0xffffffffu, 1000000007u })
+    {
+        divisors.push_back(d);
+    }
+    return divisors;
+}
+
+std::vector<uint32_t> get_dividends(uint32_t d)
+{
+    return { 0, 1, d - 1, d, d + 1, 12345678, 0x7ffffffe, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffffe, 0xffffffff, 0u - d, 0u - d + 1 };
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(division_magic_test)
+
+    BOOST_AUTO_TEST_CASE(known_unsigned_magic_numbers)
+    {
+        auto magic = get_unsigned_division_magic(10);
+        BOOST_TEST(0xcccccccdu == magic.multiplier);
+        BOOST_TEST(3u == magic.shift);
+        BOOST_TEST(!magic.add);
+
+        magic = get_unsigned_division_magic(7);
+        BOOST_TEST(0x24924925u == magic.multiplier);
+        BOOST_TEST(2u == magic.shift);
+        BOOST_TEST(magic.add);
+    }
+
+    BOOST_AUTO_TEST_CASE(known_signed_magic_numbers)
+    {
+        auto magic = get_signed_division_magic(7);
+        BOOST_TEST(static_cast<int32_t>(0x92492493) == magic.multiplier);
+        BOOST_TEST(2u == magic.shift);
+        BOOST_TEST(magic.add_dividend);
+        BOOST_TEST(!magic.subtract_dividend);
+
+        magic = get_signed_division_magic(-5);
+        BOOST_TEST(static_cast<int32_t>(0x99999999) == magic.multiplier);
+        BOOST_TEST(1u == magic.shift);
+        BOOST_TEST(!magic.add_dividend);
+        BOOST_TEST(!magic.subtract_dividend);
+    }
+
+    BOOST_AUTO_TEST_CASE(unsigned_quotients_are_correct)
+    {
+        for (auto d : get_divisors())
+        {
+            if (std::has_single_bit(d))
+            {
+                continue;
+            }
+
+            for (auto x : get_dividends(d))
+            {
+                BOOST_TEST_REQUIRE(x / d == unsigned_divide(x, d), x << " / " << d);
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(signed_quotients_are_correct)
+    {
+        for (auto divisor : get_divisors())
+        {
+            for (auto d : { static_cast<int32_t>(divisor), -static_cast<int32_t>(divisor) })
+            {
+                auto magnitude = d < 0 ? 0u - static_cast<uint32_t>(d) : static_cast<uint32_t>(d);
+                if ((magnitude < 2) || std::has_single_bit(magnitude))
+                {
+                    continue;
+                }
+
+                for (auto dividend : get_dividends(magnitude))
+                {
+                    auto x = static_cast<int32_t>(dividend);
+                    if ((x == INT32_MIN) && (d == -1))
+                    {
+                        continue;
+                    }
+                    BOOST_TEST_REQUIRE(x / d == signed_divide(x, d), x << " / " << d);
+                }
+            }
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -70,6 +70,31 @@ BOOST_AUTO_TEST_SUITE(immediate_test)
             BOOST_TEST((immediate<std::string>("1") == immediate<std::string>("b")) == false);
         }
 
+        BOOST_AUTO_TEST_CASE(expression)
+        {
+            immediate<std::string> e = symbol(std::string("end")) - symbol(std::string("start"));
+            BOOST_TEST(true == e.is_expression());
+            BOOST_TEST(false == e.is_constant());
+            BOOST_TEST(false == e.is_symbol_reference());
+            BOOST_TEST(6 == e.evaluate([](const auto& s) { return s.name == "end" ? 10 : 4; }));
+        }
+
+        BOOST_AUTO_TEST_CASE(expression_of_constants_is_folded)
+        {
+            immediate<std::string> e = (immediate<std::string>(20) - 8) / 4;
+            BOOST_TEST(true == e.is_constant());
+            BOOST_TEST(3 == e.value());
+        }
+
+        BOOST_AUTO_TEST_CASE(expression_operator_equal_to)
+        {
+            auto a = symbol(std::string("a"));
+            BOOST_TEST(((a + 1) == (a + 1)) == true);
+            BOOST_TEST(((a + 1) == (a + 2)) == false);
+            BOOST_TEST(((a + 1) == (a - 1)) == false);
+            BOOST_TEST(((a + 1) == immediate<std::string>(a)) == false);
+        }
+
     BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE_END()
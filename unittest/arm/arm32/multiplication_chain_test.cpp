@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include "lzasm/arm/arm32/detail/multiplication_chain.hpp"
+
+namespace lzasm_unittest
+{
+
+using ::lzasm::arm::arm32::detail::chain_operation;
+using ::lzasm::arm::arm32::detail::multiplication_chain;
+using ::lzasm::arm::arm32::detail::multiplication_chain_search;
+
+namespace
+{
+
+uint32_t execute(const multiplication_chain& chain, uint32_t x, bool rd_holds_x)
+{
+    // Registers in the order of chain_operand: rd, x, t
+    uint32_t r[3] = { rd_holds_x ? x : 0xdeadbeef, x, 0xdeadbeef };
+
+    for (const auto& step : chain)
+    {
+        auto a = r[static_cast<int>(step.a)];
+        auto b = r[static_cast<int>(step.b)];
+        auto& dst = r[static_cast<int>(step.dst)];
+        switch (step.operation)
+        {
+            case chain_operation::mov: dst = a; break;
+            case chain_operation::mov_zero: dst = 0; break;
+            case chain_operation::lsl: dst = a << step.shift; break;
+            case chain_operation::add: dst = a + b; break;
+            case chain_operation::sub: dst = a - b; break;
+            case chain_operation::neg: dst = 0 - a; break;
+        }
+    }
+
+    return r[0];
+}
+
+void check_chain(bool x_available, bool t_available, bool rd_holds_x, uint32_t k)
+{
+    multiplication_chain_search search(x_available, t_available, rd_holds_x);
+    auto chain = search.find(k);
+    if (chain)
+    {
+        for (uint32_t x : { 1u, 3u, 0x12345678u, 0xfedcba98u })
+        {
+            BOOST_REQUIRE(x * k == execute(*chain, x, rd_holds_x));
+        }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(multiplication_chain_test)
+
+    BOOST_AUTO_TEST_CASE(chain_lengths)
+    {
+        multiplication_chain_search search(true, true, false);
+        BOOST_TEST(1u == search.find(0)->size());
+        BOOST_TEST(1u == search.find(1)->size());
+        BOOST_TEST(1u == search.find(0xffffffff)->size());
+        BOOST_TEST(1u == search.find(0x80000000)->size());
+        BOOST_TEST(2u == search.find(7)->size());
+        BOOST_TEST(4u == search.find(45)->size());
+    }
+
+    BOOST_AUTO_TEST_CASE(odd_constants_need_multiplicand_or_scratch_register)
+    {
+        BOOST_TEST(!multiplication_chain_search(false, false, true).find(7).has_value());
+        BOOST_TEST(multiplication_chain_search(false, false, true).find(8).has_value());
+        BOOST_TEST(multiplication_chain_search(false, true, true).find(7).has_value());
+    }
+
+    BOOST_AUTO_TEST_CASE(every_chain_found_is_correct)
+    {
+        for (uint32_t k = 0; k < 100; ++k)
+        {
+            for (auto value : { k, 0 - k, k << 20 })
+            {
+                check_chain(true, true, false, value);
+                check_chain(true, false, true, value);
+                check_chain(false, true, true, value);
+            }
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
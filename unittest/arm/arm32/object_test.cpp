@@ -119,6 +119,21 @@ BOOST_FIXTURE_TEST_SUITE(object_test, object_test_fixture)
 
     BOOST_AUTO_TEST_SUITE_END()
 
+    BOOST_AUTO_TEST_SUITE(local_labels)
+
+        BOOST_AUTO_TEST_CASE(forward_and_backward_references_are_resolved)
+        {
+            auto label = obj.create_local_label();
+            obj.add_local_reference(reference_type::unconditional_branch, label);
+            obj.emit16(0);
+            obj.define_local_label(label);
+            obj.add_local_reference(reference_type::unconditional_branch, label);
+            obj.emit16(0);
+            CHECK_LINK(H(0xe7ff, 0xe7fe));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
     BOOST_AUTO_TEST_SUITE(add_symbol)
 
         BOOST_AUTO_TEST_CASE(add_symbol)
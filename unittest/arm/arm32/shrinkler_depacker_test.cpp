@@ -391,10 +391,8 @@ static const unsigned char expected_binary[] =
     0xa2, 0xb1, 0x6b, 0x41, 0x00, 0x00, 0xf4, 0x1a
 };
 
-BOOST_AUTO_TEST_CASE(shrinkler_depacker_test)
+static void assemble_shrinkler_depacker(divided_thumb_assembler& a)
 {
-    divided_thumb_assembler a;
-
     ////////////////////////////////////////////////////////////////////////////
     // Cartridge header
     ////////////////////////////////////////////////////////////////////////////
@@ -650,9 +648,39 @@ BOOST_AUTO_TEST_CASE(shrinkler_depacker_test)
     a.align(2);
     a.label("packed_intro"s);
     a.incbin(compressed_intro, compressed_intro + std::size(compressed_intro));
+}
+
+BOOST_AUTO_TEST_CASE(shrinkler_depacker_test)
+{
+    divided_thumb_assembler a;
+    assemble_shrinkler_depacker(a);
 
     // Compare assembled and linked program with expected binary.
     CHECK_PROGRAM(a, 0x08000000, bytevector(expected_binary, expected_binary + std::size(expected_binary)));
 }
 
+BOOST_AUTO_TEST_CASE(shrinkler_depacker_peephole_test)
+{
+    divided_thumb_assembler a;
+    assemble_shrinkler_depacker(a);
+
+    // The depacker is hand optimized, so the peephole pass must not find anything to remove.
+    // In particular it must keep add(tmp1, 0), which clears C for the following code.
+    auto program = a.link(0x08000000, { .peephole = true });
+    BOOST_TEST(program == bytevector(expected_binary, expected_binary + std::size(expected_binary)), boost::test_tools::per_element());
+    BOOST_TEST(a.last_peephole_report().removed_instructions == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(shrinkler_depacker_load_scheduling_test)
+{
+    divided_thumb_assembler a;
+    assemble_shrinkler_depacker(a);
+
+    // The loads in getbit are immediately followed by their uses, but every instruction that could
+    // fill the delay either depends on the load or sets flags that are still needed.
+    auto program = a.link(0x08000000, { .schedule_loads = true });
+    BOOST_TEST(program == bytevector(expected_binary, expected_binary + std::size(expected_binary)), boost::test_tools::per_element());
+    BOOST_TEST(a.last_scheduling_report().saved_cycles == 0u);
+}
+
 }
@@ -48,24 +48,84 @@ bool is_alignment_out_of_range(const std::exception& e)
     return true;
 }
 
+bool is_division_by_zero(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Division by zero", e.what());
+    return true;
+}
+
+bool is_function_already_open(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Function is already open", e.what());
+    return true;
+}
+
+bool is_function_not_ended(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Function is not ended", e.what());
+    return true;
+}
+
 bool is_immediate_out_of_range(const std::exception& e)
 {
     BOOST_CHECK_EQUAL("Immediate value is out of range", e.what());
     return true;
 }
 
+bool is_invalid_custom_reference_type(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Invalid custom reference type", e.what());
+    return true;
+}
+
+bool is_invalid_number_of_switch_table_entries(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Invalid number of switch table entries", e.what());
+    return true;
+}
+
+bool is_mergeable_data_contains_non_data(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Mergeable data must only contain data", e.what());
+    return true;
+}
+
 bool is_misaligned_immediate_value(const std::exception& e)
 {
     BOOST_CHECK_EQUAL("Misaligned immediate value", e.what());
     return true;
 }
 
+bool is_no_entry_point(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("No entry point for dead code stripping", e.what());
+    return true;
+}
+
+bool is_no_function_open(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("No function is open", e.what());
+    return true;
+}
+
 bool is_origin_too_large(const std::exception& e)
 {
     BOOST_CHECK_EQUAL("Origin too large", e.what());
     return true;
 }
 
+bool is_scratch_register_conflict(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Scratch register must differ from the other operands", e.what());
+    return true;
+}
+
+bool is_scratch_register_required(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Immediate value requires a scratch register", e.what());
+    return true;
+}
+
 bool is_symbol_already_defined(const std::exception& e)
 {
     BOOST_CHECK_EQUAL("Symbol is already defined", e.what());
@@ -84,4 +144,16 @@ bool is_unpredictable_behavior(const std::exception& e)
     return true;
 }
 
+bool is_used_before_defined(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Virtual register is used before it is defined", e.what());
+    return true;
+}
+
+bool is_value_of_constant_not_known(const std::exception& e)
+{
+    BOOST_CHECK_EQUAL("Value of constant is not known", e.what());
+    return true;
+}
+
 }
@@ -25,12 +25,24 @@ bytevector to_bytevector(const wordvector& words);
 #define W(...) wordvector { __VA_ARGS__ }
 
 bool is_alignment_out_of_range(const std::exception& e);
+bool is_division_by_zero(const std::exception& e);
+bool is_function_already_open(const std::exception& e);
+bool is_function_not_ended(const std::exception& e);
 bool is_immediate_out_of_range(const std::exception& e);
+bool is_invalid_custom_reference_type(const std::exception& e);
+bool is_invalid_number_of_switch_table_entries(const std::exception& e);
+bool is_mergeable_data_contains_non_data(const std::exception& e);
 bool is_misaligned_immediate_value(const std::exception& e);
+bool is_no_entry_point(const std::exception& e);
+bool is_no_function_open(const std::exception& e);
 bool is_origin_too_large(const std::exception& e);
+bool is_scratch_register_conflict(const std::exception& e);
+bool is_scratch_register_required(const std::exception& e);
 bool is_symbol_already_defined(const std::exception& e);
 bool is_undefined_symbol(const std::exception& e);
 bool is_unpredictable_behavior(const std::exception& e);
+bool is_used_before_defined(const std::exception& e);
+bool is_value_of_constant_not_known(const std::exception& e);
 
 }
 
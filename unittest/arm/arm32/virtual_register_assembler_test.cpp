@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2021 Thomas Mathys
+// SPDX-License-Identifier: MIT
+// lzasm: a runtime assembler
+
+#include <boost/test/unit_test.hpp>
+#include <string>
+#include "lzasm/arm/arm32/virtual_register_assembler.hpp"
+#include "assembler_test_utilities.hpp"
+#include "test_utilities.hpp"
+
+namespace lzasm_unittest
+{
+
+using namespace std::string_literals;
+using namespace ::lzasm::arm::arm32;
+
+BOOST_AUTO_TEST_SUITE(virtual_register_assembler_test)
+
+    BOOST_AUTO_TEST_CASE(virtual_registers_get_free_registers)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v;
+        auto x = v.create_vreg();
+        auto y = v.create_vreg();
+
+        v.mov(x, 1);
+        v.mov(y, 2);
+        v.add(x, x, y);
+        v.mov(r0, x);
+        v.ret(low_reg_list(r0));
+        v.emit(a);
+
+        // x is given r0, so the final move disappears.
+        CHECK_PROGRAM(a, 0, H(0x2001, 0x2102, 0x1840, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(liveness_is_followed_through_branches)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v;
+        auto count = v.create_vreg();
+        auto sum = v.create_vreg();
+
+        v.mov(count, r0);
+        v.mov(sum, 0);
+        v.label("loop"s);
+        v.add(sum, sum, count);
+        v.sub(count, 1);
+        v.bne("loop"s);
+        v.mov(r0, sum);
+        v.ret(low_reg_list(r0));
+        v.emit(a);
+
+        // count stays in r0. sum cannot, since count is still live at the loop label.
+        CHECK_PROGRAM(a, 0, H(0x2100, 0x1809, 0x3801, 0xd1fc, 0x1c08, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(explicitly_used_registers_are_avoided)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v;
+        auto x = v.create_vreg();
+
+        v.mov(x, 5);
+        v.mov(r0, 7);
+        v.add(x, x, r0);
+        v.mov(r0, x);
+        v.ret(low_reg_list(r0));
+        v.emit(a);
+
+        CHECK_PROGRAM(a, 0, H(0x2105, 0x2007, 0x1809, 0x1c08, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(calls_destroy_r0_to_r3)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v;
+        auto x = v.create_vreg();
+
+        v.mov(x, 1);
+        v.bl("callee"s);
+        v.mov(r0, x);
+        v.ret(low_reg_list(r0));
+        v.emit(a);
+        a.label("callee"s);
+        a.bx(lr);
+
+        CHECK_PROGRAM(a, 0, H(0xb500, 0x2401, 0xf000, 0xf802, 0x1c20, 0xbd00, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(call_arguments_are_kept)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v(r0 - r1);
+        auto x = v.create_vreg();
+
+        v.mov(r0, 1);
+        v.mov(x, 2);
+        v.bl("callee"s, low_reg_list(r0));
+        v.ret();
+        v.emit(a);
+        a.label("callee"s);
+        a.bx(lr);
+
+        // r0 holds the argument, so x is given r1.
+        CHECK_PROGRAM(a, 0, H(0xb500, 0x2001, 0x2102, 0xf000, 0xf801, 0xbd00, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(registers_are_spilled_if_they_run_out)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v(r0 - r1);
+        auto x = v.create_vreg();
+        auto y = v.create_vreg();
+        auto z = v.create_vreg();
+
+        v.mov(x, 1);
+        v.mov(y, 2);
+        v.mov(z, 3);
+        v.add(y, y, z);
+        v.add(x, x, y);
+        v.mov(r0, x);
+        v.ret(low_reg_list(r0));
+        v.emit(a);
+
+        // x lives the longest and is spilled to [sp, #0].
+        CHECK_PROGRAM(
+            a, 0,
+            H(0xb081,
+              0x2001, 0x9000,
+              0x2002,
+              0x2103,
+              0x1840,
+              0x9900, 0x1809, 0x9100,
+              0x9800,
+              0xb001, 0x4770));
+    }
+
+    BOOST_AUTO_TEST_CASE(use_before_definition_is_rejected)
+    {
+        divided_thumb_assembler a;
+        virtual_register_assembler v;
+        auto x = v.create_vreg();
+
+        v.add(x, 1);
+        v.ret();
+
+        BOOST_CHECK_EXCEPTION(v.emit(a), std::runtime_error, is_used_before_defined);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}